@@ -561,8 +561,10 @@ HDLC_irq(struct bchannel *bch, u32 stat)
 				    HDLC_STAT_CRCVFR) {
 					recv_Bchannel(bch, 0, false);
 				} else {
-					pr_warn("%s: got invalid frame\n",
-						fc->name);
+					if (debug & DEBUG_HW_BFIFO)
+						pr_debug("%s: got invalid "
+							 "frame\n", fc->name);
+					bch_stats_inc(bch, crc_err);
 					skb_trim(bch->rx_skb, 0);
 				}
 			}
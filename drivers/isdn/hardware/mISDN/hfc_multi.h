@@ -53,12 +53,17 @@ struct hfc_chan {
 	int		slot_rx;
 	int		bank_rx;
 	int		conf;	/* conference setting of TX slot */
+	int		conf_att; /* attenuation of TX slot in conference */
 	int		txpending;	/* if there is currently data in */
 					/* the FIFO 0=no, 1=yes, 2=splloop */
 	int		Zfill;	/* rx-fifo level on last hfcmulti_tx */
 	int		rx_off; /* set to turn fifo receive off */
 	int		coeff_count; /* curren coeff block */
 	s32		*coeff; /* memory pointer to 8 coeff blocks */
+	int		dtmf; /* hardware DTMF requested by the DSP */
+	s32		dtmf_treshold; /* above this is dtmf (square of) */
+	u8		dtmf_lastwhat, dtmf_lastdigit;
+	int		dtmf_count;
 };
 
 
@@ -147,6 +152,8 @@ struct hfc_multi {
 	u_int		irqcnt;
 	struct pci_dev	*pci_dev;
 	int		io_mode; /* selects mode */
+	u_int		poll;	/* samples per fifo process */
+	int		poll_timer; /* R_TI_WD setting for poll */
 #ifdef HFC_REGISTER_DEBUG
 	void		(*HFC_outb)(struct hfc_multi *hc, u_char reg,
 				    u_char val, const char *function, int line);
@@ -76,6 +76,13 @@
  *	reduce cpu load. If unsure, don't mess with it!
  *	Valid is 8, 16, 32, 64, 128, 256.
  *
+ * poll_card:
+ *	NOTE: one poll_card value may be given for every card.
+ *	Overrides poll for this card, 0 = use poll. The poll timer is
+ *	common to all ports of a chip, so ports on one card share the value.
+ *	Use it to run cards with voice ports at low delay while cards
+ *	carrying data keep larger fifo chunks.
+ *
  * pcm:
  *	NOTE: only one pcm value must be given for every card.
  *	The PCM bus id tells the mISDNdsp module about the connected PCM bus.
@@ -141,6 +148,12 @@
  * hwid:
  *	NOTE: only one hwid value must be given once
  *	Enable special embedded devices with XHFC controllers.
+ *
+ * dtmfdecode:
+ *	NOTE: only one dtmfdecode value must be given once
+ *	Set to 1 (default) to finish hardware DTMF detection in the driver
+ *	and only send decoded digits to the DSP. Set to 0 to send the raw
+ *	coefficients, so the DSP decodes them.
  */
 
 /*
@@ -155,6 +168,8 @@
 #include <linux/slab.h>
 #include <linux/pci.h>
 #include <linux/delay.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
 #include <linux/mISDNhw.h>
 #include <linux/mISDNdsp.h>
 
@@ -175,6 +190,7 @@
 
 static LIST_HEAD(HFClist);
 static spinlock_t HFClock; /* global hfc list lock */
+static DEFINE_MUTEX(hfc_probe_mutex); /* serializes parts of card init */
 
 static void ph_state_change(struct dchannel *);
 
@@ -191,9 +207,29 @@ EXPORT_SYMBOL(hfcmulti_plxmem);
 #define	TYP_4S		4
 #define TYP_8S		8
 
-static int poll_timer = 6;	/* default = 128 samples = 16ms */
 /* number of POLL_TIMER interrupts for G2 timeout (ca 1s) */
 static int nt_t1_count[] = { 3840, 1920, 960, 480, 240, 120, 60, 30  };
+
+/* R_TI_WD timer setting for a poll value, default 128 samples = 16ms */
+static int
+poll_to_timer(uint p)
+{
+	switch (p) {
+	case 8:
+		return 2;
+	case 16:
+		return 3;
+	case 32:
+		return 4;
+	case 64:
+		return 5;
+	case 128:
+		return 6;
+	case 256:
+		return 7;
+	}
+	return -EINVAL;
+}
 #define	CLKDEL_TE	0x0f	/* CLKDEL in TE mode */
 #define	CLKDEL_NT	0x6c	/* CLKDEL in NT mode
 				   (0x60 MUST be included!) */
@@ -214,6 +250,7 @@ static uint	iomode[MAX_CARDS];
 static uint	port[MAX_PORTS];
 static uint	debug;
 static uint	poll;
+static uint	poll_card[MAX_CARDS];
 static int	clock;
 static uint	timer;
 static uint	clockdelay_te = CLKDEL_TE;
@@ -223,6 +260,7 @@ static uint	clockdelay_nt = CLKDEL_NT;
 #define HWID_MINIP8	2
 #define HWID_MINIP16	3
 static uint	hwid = HWID_NONE;
+static uint	dtmfdecode = 1;
 
 static int	HFC_cnt, E1_cnt, bmask_cnt, Port_cnt, PCM_cnt = 99;
 
@@ -231,6 +269,7 @@ MODULE_LICENSE("GPL");
 MODULE_VERSION(HFC_MULTI_VERSION);
 module_param(debug, uint, S_IRUGO | S_IWUSR);
 module_param(poll, uint, S_IRUGO | S_IWUSR);
+module_param_array(poll_card, uint, NULL, S_IRUGO | S_IWUSR);
 module_param(clock, int, S_IRUGO | S_IWUSR);
 module_param(timer, uint, S_IRUGO | S_IWUSR);
 module_param(clockdelay_te, uint, S_IRUGO | S_IWUSR);
@@ -242,6 +281,7 @@ module_param_array(bmask, uint, NULL, S_IRUGO | S_IWUSR);
 module_param_array(iomode, uint, NULL, S_IRUGO | S_IWUSR);
 module_param_array(port, uint, NULL, S_IRUGO | S_IWUSR);
 module_param(hwid, uint, S_IRUGO | S_IWUSR); /* The hardware ID */
+module_param(dtmfdecode, uint, S_IRUGO | S_IWUSR);
 
 #ifdef HFC_REGISTER_DEBUG
 #define HFC_outb(hc, reg, val)					\
@@ -734,8 +774,9 @@ vpm_out(struct hfc_multi *c, int which, unsigned short addr,
 }
 
 
+/* called with the card lock held, it is dropped while waiting */
 static void
-vpm_init(struct hfc_multi *wc)
+vpm_init(struct hfc_multi *wc, u_long *flags)
 {
 	unsigned char reg;
 	unsigned int mask;
@@ -788,19 +829,10 @@ vpm_init(struct hfc_multi *wc)
 				vpm_out(wc, x, i, 0x00);
 		}
 
-		/*
-		 * ARM arch at least disallows a udelay of
-		 * more than 2ms... it gives a fake "__bad_udelay"
-		 * reference at link-time.
-		 * long delays in kernel code are pretty sucky anyway
-		 * for now work around it using 5 x 2ms instead of 1 x 10ms
-		 */
-
-		udelay(2000);
-		udelay(2000);
-		udelay(2000);
-		udelay(2000);
-		udelay(2000);
+		/* let the echo cans settle */
+		spin_unlock_irqrestore(&wc->lock, *flags);
+		msleep(10);
+		spin_lock_irqsave(&wc->lock, *flags);
 
 		/* Put in bypass mode */
 		for (i = 0; i < MAX_TDM_CHAN; i++) {
@@ -1189,7 +1221,7 @@ init_chip(struct hfc_multi *hc)
 		hc->Zlen = 64;
 		hc->DTMFbase = 0x0;
 	}
-	hc->max_trans = poll << 1;
+	hc->max_trans = hc->poll << 1;
 	if (hc->max_trans > hc->Zlen)
 		hc->max_trans = hc->Zlen;
 
@@ -1287,10 +1319,14 @@ init_chip(struct hfc_multi *hc)
 		hc->hw.r_cirm = V_SRES | V_HFCRES | V_PCMRES | V_STRES
 			| V_RLD_EPR;
 	HFC_outb(hc, R_CIRM, hc->hw.r_cirm);
-	udelay(100);
+	spin_unlock_irqrestore(&hc->lock, flags);
+	usleep_range(100, 200);
+	spin_lock_irqsave(&hc->lock, flags);
 	hc->hw.r_cirm = 0;
 	HFC_outb(hc, R_CIRM, hc->hw.r_cirm);
-	udelay(100);
+	spin_unlock_irqrestore(&hc->lock, flags);
+	usleep_range(100, 200);
+	spin_lock_irqsave(&hc->lock, flags);
 	if (hc->ctype != HFC_TYPE_XHFC)
 		HFC_outb(hc, R_RAM_SZ, hc->hw.r_ram_sz);
 
@@ -1357,9 +1393,11 @@ init_chip(struct hfc_multi *hc)
 		printk(KERN_NOTICE "Setting GPIOs\n");
 		HFC_outb(hc, R_GPIO_SEL, 0x30);
 		HFC_outb(hc, R_GPIO_EN1, 0x3);
-		udelay(1000);
+		spin_unlock_irqrestore(&hc->lock, flags);
+		usleep_range(1000, 2000);
+		spin_lock_irqsave(&hc->lock, flags);
 		printk(KERN_NOTICE "calling vpm_init\n");
-		vpm_init(hc);
+		vpm_init(hc, &flags);
 	}
 
 	/* check if R_F0_CNT counts (8 kHz frame count) */
@@ -1476,7 +1514,7 @@ init_chip(struct hfc_multi *hc)
 	}
 
 	/* set up timer */
-	HFC_outb(hc, R_TI_WD, poll_timer);
+	HFC_outb(hc, R_TI_WD, hc->poll_timer);
 	hc->hw.r_irqmsk_misc |= V_TI_IRQMSK;
 
 	/* set E1 state machine IRQ */
@@ -1638,9 +1676,9 @@ hfcmulti_leds(struct hfc_multi *hc)
 				led[2] = 1;
 				led[3] = 1;
 				if (!hc->flash[2] && hc->activity_tx)
-					hc->flash[2] = poll;
+					hc->flash[2] = hc->poll;
 				if (!hc->flash[3] && hc->activity_rx)
-					hc->flash[3] = poll;
+					hc->flash[3] = hc->poll;
 				if (hc->flash[2] && hc->flash[2] < 1024)
 					led[2] = 0;
 				if (hc->flash[3] && hc->flash[3] < 1024)
@@ -1650,9 +1688,9 @@ hfcmulti_leds(struct hfc_multi *hc)
 				if (hc->flash[3] >= 2048)
 					hc->flash[3] = 0;
 				if (hc->flash[2])
-					hc->flash[2] += poll;
+					hc->flash[2] += hc->poll;
 				if (hc->flash[3])
-					hc->flash[3] += poll;
+					hc->flash[3] += hc->poll;
 			}
 		}
 		leds = (led[0] | (led[1]<<2) | (led[2]<<1) | (led[3]<<3))^0xF;
@@ -1685,13 +1723,13 @@ hfcmulti_leds(struct hfc_multi *hc)
 					hc->activity_tx |= hc->activity_rx;
 					if (!hc->flash[i] &&
 						(hc->activity_tx & (1 << i)))
-							hc->flash[i] = poll;
+							hc->flash[i] = hc->poll;
 					if (hc->flash[i] && hc->flash[i] < 1024)
 						led[i] = 0; /* led off */
 					if (hc->flash[i] >= 2048)
 						hc->flash[i] = 0;
 					if (hc->flash[i])
-						hc->flash[i] += poll;
+						hc->flash[i] += hc->poll;
 				} else {
 					led[i] = 2; /* led red */
 					hc->flash[i] = 0;
@@ -1749,13 +1787,13 @@ hfcmulti_leds(struct hfc_multi *hc)
 					hc->activity_tx |= hc->activity_rx;
 					if (!hc->flash[i] &&
 						(hc->activity_tx & (1 << i)))
-							hc->flash[i] = poll;
+							hc->flash[i] = hc->poll;
 					if (hc->flash[i] < 1024)
 						led[i] = 0; /* led off */
 					if (hc->flash[i] >= 2048)
 						hc->flash[i] = 0;
 					if (hc->flash[i])
-						hc->flash[i] += poll;
+						hc->flash[i] += hc->poll;
 				} else {
 					led[i] = 2; /* led red */
 					hc->flash[i] = 0;
@@ -1796,13 +1834,13 @@ hfcmulti_leds(struct hfc_multi *hc)
 					hc->activity_tx |= hc->activity_rx;
 					if (!hc->flash[i] &&
 						(hc->activity_tx & (1 << i)))
-							hc->flash[i] = poll;
+							hc->flash[i] = hc->poll;
 					if (hc->flash[i] < 1024)
 						lled |= 1 << i; /* led off */
 					if (hc->flash[i] >= 2048)
 						hc->flash[i] = 0;
 					if (hc->flash[i])
-						hc->flash[i] += poll;
+						hc->flash[i] += hc->poll;
 				} else
 					hc->flash[i] = 0;
 			}
@@ -1827,85 +1865,197 @@ hfcmulti_leds(struct hfc_multi *hc)
  * read dtmf coefficients
  */
 
+/* 2 * cos(2 * PI * k / N) << 15 of the DTMF frequencies (see chip doc) */
+static const s64 dtmf_cos2pik[8] = {
+	55960, 53912, 51402, 48438, 38146, 32650, 26170, 18630
+};
+
+static const char dtmf_matrix[4][4] = {
+	{'1', '2', '3', 'A'},
+	{'4', '5', '6', 'B'},
+	{'7', '8', '9', 'C'},
+	{'*', '0', '#', 'D'}
+};
+
+static inline int
+hfcmulti_dtmf_chan(struct hfc_multi *hc, int ch)
+{
+	struct bchannel	*bch = hc->chan[ch].bch;
+
+	return bch && hc->chan[ch].dtmf && hc->created[hc->chan[ch].port] &&
+		test_bit(FLG_TRANSPARENT, &bch->Flags);
+}
+
+static inline s32
+hfcmulti_dtmf_float(u16 w_float)
+{
+	u_int	mantissa;
+	u8	exponent;
+
+	/* decode float (see chip doc) */
+	mantissa = w_float & 0x0fff;
+	if (w_float & 0x8000)
+		mantissa |= 0xfffff000;
+	exponent = (w_float >> 12) & 0x7;
+	if (exponent) {
+		mantissa ^= 0x1000;
+		mantissa <<= (exponent - 1);
+	}
+	return mantissa;
+}
+
+/*
+ * finish the goertzel decode of one block of coefficients, the same way
+ * dsp_dtmf_goertzel_decode() does, and return the digit once it has been
+ * stable for three blocks
+ */
+static u8
+hfcmulti_dtmf_decode(struct hfc_chan *chan, s32 *coeff)
+{
+	s32	result[8], sk, sk2, tresh, treshl;
+	int	i, lowgroup = -1, highgroup = -1;
+	u8	what = 0, digit = 0;
+
+	tresh = 0;
+	for (i = 0; i < 8; i++) {
+		sk2 = coeff[i << 1] >> 4;
+		sk = coeff[(i << 1) | 1] >> 4;
+		/* compute |X(k)|**2 */
+		result[i] = (sk * sk) - (((dtmf_cos2pik[i] * sk) >> 15) * sk2)
+			+ (sk2 * sk2);
+		if (result[i] < 0)
+			result[i] = 0;
+		if (result[i] > chan->dtmf_treshold && result[i] > tresh)
+			tresh = result[i];
+	}
+	if (!tresh)
+		goto storedigit;
+
+	treshl = tresh >> 3;  /* tones which are not on, must be below 9 dB */
+	tresh = tresh >> 2;  /* touchtones must match within 6 dB */
+	for (i = 0; i < 8; i++) {
+		if (result[i] < treshl)
+			continue;
+		if (result[i] < tresh) {
+			lowgroup = -1;
+			highgroup = -1;
+			break;  /* noise in between */
+		}
+		/* good level found. This is allowed only one time per group */
+		if (i < 4) {
+			if (lowgroup >= 0) {
+				lowgroup = -1;
+				break;
+			}
+			lowgroup = i;
+		} else {
+			if (highgroup >= 0) {
+				highgroup = -1;
+				break;
+			}
+			highgroup = i - 4;
+		}
+	}
+	if (lowgroup >= 0 && highgroup >= 0)
+		what = dtmf_matrix[lowgroup][highgroup];
+
+storedigit:
+	if (chan->dtmf_lastwhat != what)
+		chan->dtmf_count = 0;
+	/* the tone (or no tone) must remain 3 times without change */
+	if (chan->dtmf_count == 2) {
+		if (chan->dtmf_lastdigit != what) {
+			chan->dtmf_lastdigit = what;
+			digit = what;
+		}
+	} else
+		chan->dtmf_count++;
+	chan->dtmf_lastwhat = what;
+	return digit;
+}
+
 static void
 hfcmulti_dtmf(struct hfc_multi *hc)
 {
 	s32		*coeff;
-	u_int		mantissa;
-	int		co, ch;
+	int		co, ch, first = -1, last = -1;
 	struct bchannel	*bch = NULL;
-	u8		exponent;
-	int		dtmf = 0;
-	int		addr;
+	u32		mask = 0;
+	int		addr, k;
 	u16		w_float;
+	u8		digit;
 	struct sk_buff	*skb;
 	struct mISDNhead *hh;
 
 	if (debug & DEBUG_HFCMULTI_DTMF)
 		printk(KERN_DEBUG "%s: dtmf detection irq\n", __func__);
+	/* only process B-channels with hardware DTMF enabled */
 	for (ch = 0; ch <= 31; ch++) {
-		/* only process enabled B-channels */
-		bch = hc->chan[ch].bch;
-		if (!bch)
-			continue;
-		if (!hc->created[hc->chan[ch].port])
+		if (!hfcmulti_dtmf_chan(hc, ch))
 			continue;
-		if (!test_bit(FLG_TRANSPARENT, &bch->Flags))
-			continue;
-		if (debug & DEBUG_HFCMULTI_DTMF)
-			printk(KERN_DEBUG "%s: dtmf channel %d:",
-			       __func__, ch);
-		coeff = &(hc->chan[ch].coeff[hc->chan[ch].coeff_count * 16]);
-		dtmf = 1;
-		for (co = 0; co < 8; co++) {
-			/* read W(n-1) coefficient */
-			addr = hc->DTMFbase + ((co << 7) | (ch << 2));
-			HFC_outb_nodebug(hc, R_RAM_ADDR0, addr);
-			HFC_outb_nodebug(hc, R_RAM_ADDR1, addr >> 8);
-			HFC_outb_nodebug(hc, R_RAM_ADDR2, (addr >> 16)
-					 | V_ADDR_INC);
-			w_float = HFC_inb_nodebug(hc, R_RAM_DATA);
-			w_float |= (HFC_inb_nodebug(hc, R_RAM_DATA) << 8);
-			if (debug & DEBUG_HFCMULTI_DTMF)
-				printk(" %04x", w_float);
-
-			/* decode float (see chip doc) */
-			mantissa = w_float & 0x0fff;
-			if (w_float & 0x8000)
-				mantissa |= 0xfffff000;
-			exponent = (w_float >> 12) & 0x7;
-			if (exponent) {
-				mantissa ^= 0x1000;
-				mantissa <<= (exponent - 1);
-			}
-
-			/* store coefficient */
-			coeff[co << 1] = mantissa;
+		mask |= BIT(ch);
+		if (first < 0)
+			first = ch;
+		last = ch;
+	}
 
-			/* read W(n) coefficient */
-			w_float = HFC_inb_nodebug(hc, R_RAM_DATA);
-			w_float |= (HFC_inb_nodebug(hc, R_RAM_DATA) << 8);
-			if (debug & DEBUG_HFCMULTI_DTMF)
-				printk(" %04x", w_float);
-
-			/* decode float (see chip doc) */
-			mantissa = w_float & 0x0fff;
-			if (w_float & 0x8000)
-				mantissa |= 0xfffff000;
-			exponent = (w_float >> 12) & 0x7;
-			if (exponent) {
-				mantissa ^= 0x1000;
-				mantissa <<= (exponent - 1);
+	/*
+	 * The W(n-1) and W(n) words of all channels are stored back to back
+	 * for each frequency, so read each frequency in one auto-increment
+	 * burst from the first to the last enabled channel.
+	 */
+	for (co = 0; mask && co < 8; co++) {
+		addr = hc->DTMFbase + ((co << 7) | (first << 2));
+		HFC_outb_nodebug(hc, R_RAM_ADDR0, addr);
+		HFC_outb_nodebug(hc, R_RAM_ADDR1, addr >> 8);
+		HFC_outb_nodebug(hc, R_RAM_ADDR2, (addr >> 16) | V_ADDR_INC);
+		for (ch = first; ch <= last; ch++) {
+			coeff = NULL;
+			if (mask & BIT(ch))
+				coeff = &(hc->chan[ch].coeff[
+					hc->chan[ch].coeff_count * 16]);
+			/* read W(n-1) and W(n) coefficient */
+			for (k = 0; k < 2; k++) {
+				w_float = HFC_inb_nodebug(hc, R_RAM_DATA);
+				w_float |= (HFC_inb_nodebug(hc, R_RAM_DATA)
+					    << 8);
+				if (coeff)
+					coeff[(co << 1) | k] =
+						hfcmulti_dtmf_float(w_float);
 			}
-
-			/* store coefficient */
-			coeff[(co << 1) | 1] = mantissa;
 		}
+	}
+
+	for (ch = first; mask && ch <= last; ch++) {
+		if (!(mask & BIT(ch)))
+			continue;
+		bch = hc->chan[ch].bch;
+		coeff = &(hc->chan[ch].coeff[hc->chan[ch].coeff_count * 16]);
 		if (debug & DEBUG_HFCMULTI_DTMF)
-			printk(" DTMF ready %08x %08x %08x %08x "
-			       "%08x %08x %08x %08x\n",
+			printk(KERN_DEBUG "%s: dtmf channel %d: DTMF ready "
+			       "%08x %08x %08x %08x %08x %08x %08x %08x\n",
+			       __func__, ch,
 			       coeff[0], coeff[1], coeff[2], coeff[3],
 			       coeff[4], coeff[5], coeff[6], coeff[7]);
+		if (dtmfdecode) {
+			/* finish here, only send digits to the DSP */
+			digit = hfcmulti_dtmf_decode(&hc->chan[ch], coeff);
+			if (!digit)
+				continue;
+			if (debug & DEBUG_HFCMULTI_DTMF)
+				printk(KERN_DEBUG "%s: dtmf channel %d: "
+				       "digit %c\n", __func__, ch, digit);
+			k = digit | DTMF_TONE_VAL;
+			skb = _alloc_mISDN_skb(PH_CONTROL_IND, DTMF_TONE_VAL,
+					       sizeof(int), &k, GFP_ATOMIC);
+			if (!skb) {
+				printk(KERN_DEBUG "%s: No memory for skb\n",
+				       __func__);
+				continue;
+			}
+			recv_Bchannel_skb(bch, skb);
+			continue;
+		}
 		hc->chan[ch].coeff_count++;
 		if (hc->chan[ch].coeff_count == 8) {
 			hc->chan[ch].coeff_count = 0;
@@ -1924,8 +2074,8 @@ hfcmulti_dtmf(struct hfc_multi *hc)
 	}
 
 	/* restart DTMF processing */
-	hc->dtmf = dtmf;
-	if (dtmf)
+	hc->dtmf = !!mask;
+	if (mask)
 		HFC_outb_nodebug(hc, R_DTMF, hc->hw.r_dtmf | V_RST_DTMF);
 }
 
@@ -2086,9 +2236,12 @@ next_frame:
 		if (debug & DEBUG_HFCMULTI_FILL)
 			printk(KERN_DEBUG "%s: buffer empty, so we have "
 			       "underrun\n", __func__);
+		/* only an underrun if the previous data ran dry */
+		if (*txpending)
+			bch_stats_inc(bch, tx_underrun);
 		/* fill buffer, to prevent future underrun */
-		hc->write_fifo(hc, hc->silence_data, poll >> 1);
-		Zspace -= (poll >> 1);
+		hc->write_fifo(hc, hc->silence_data, hc->poll >> 1);
+		Zspace -= (hc->poll >> 1);
 	}
 
 	/* if audio data and connected slot */
@@ -2218,7 +2371,7 @@ next_frame:
 	/* ignore if rx is off BUT change fifo (above) to start pending TX */
 	if (hc->chan[ch].rx_off) {
 		if (bch)
-			bch->dropcnt += poll; /* not exact but fair enough */
+			bch->dropcnt += hc->poll; /* not exact but fair enough */
 		return;
 	}
 
@@ -2290,6 +2443,8 @@ next_frame:
 				printk(KERN_DEBUG
 				       "%s(card %d): hdlc-frame too large.\n",
 				       __func__, hc->id + 1);
+			if (bch)
+				bch_stats_inc(bch, rx_overrun);
 			skb_trim(*sp, 0);
 			HFC_outb_nodebug(hc, R_INC_RES_FIFO, V_RES_F);
 			HFC_wait_nodebug(hc);
@@ -2308,6 +2463,8 @@ next_frame:
 					printk(KERN_DEBUG
 					       "%s(card %d): Frame below minimum "
 					       "size\n", __func__, hc->id + 1);
+				if (bch)
+					bch_stats_inc(bch, frame_err);
 				skb_trim(*sp, 0);
 				goto next_frame;
 			}
@@ -2316,6 +2473,8 @@ next_frame:
 				if (debug & DEBUG_HFCMULTI_CRC)
 					printk(KERN_DEBUG
 					       "%s: CRC-error\n", __func__);
+				if (bch)
+					bch_stats_inc(bch, crc_err);
 				skb_trim(*sp, 0);
 				goto next_frame;
 			}
@@ -2353,7 +2512,8 @@ next_frame:
 		}
 		/* there is an incomplete frame */
 	} else {
-		/* transparent */
+		/* transparent, the fifo moves once per F0 frame */
+		mISDN_stamp_rx(*sp, Zsize);
 		hc->read_fifo(hc, skb_put(*sp, Zsize), Zsize);
 		if (debug & DEBUG_HFCMULTI_FIFO)
 			printk(KERN_DEBUG
@@ -2803,7 +2963,7 @@ hfcmulti_interrupt(int intno, void *dev_id)
 		}
 		if (r_irq_misc & V_TI_IRQ) {
 			if (hc->iclock_on)
-				mISDN_clock_update(hc->iclock, poll, NULL);
+				mISDN_clock_update(hc->iclock, hc->poll, NULL);
 			handle_timer_irq(hc);
 		}
 
@@ -2945,8 +3105,8 @@ mode_hfcmulti(struct hfc_multi *hc, int ch, int protocol, int slot_tx,
 		HFC_outb(hc, R_SLOT, slot_tx << 1);
 		HFC_outb(hc, A_SL_CFG, (ch << 1) | routing);
 		if (hc->ctype != HFC_TYPE_XHFC)
-			HFC_outb(hc, A_CONF,
-				 (conf < 0) ? 0 : (conf | V_CONF_SL));
+			HFC_outb(hc, A_CONF, (conf < 0) ? 0 : (conf |
+				 V_CONF_SL | hc->chan[ch].conf_att * V_ATT_LEV));
 		hc->slot_owner[slot_tx << 1] = ch;
 		hc->chan[ch].slot_tx = slot_tx;
 		hc->chan[ch].bank_tx = bank_tx;
@@ -3450,6 +3610,9 @@ deactivate_bchannel(struct bchannel *bch)
 	spin_lock_irqsave(&hc->lock, flags);
 	mISDN_clear_bchannel(bch);
 	hc->chan[bch->slot].coeff_count = 0;
+	hc->chan[bch->slot].dtmf_lastwhat = 0;
+	hc->chan[bch->slot].dtmf_lastdigit = 0;
+	hc->chan[bch->slot].dtmf_count = 0;
 	hc->chan[bch->slot].rx_off = 0;
 	hc->chan[bch->slot].conf = -1;
 	mode_hfcmulti(hc, bch->slot, ISDN_P_NONE, -1, 0, -1, 0);
@@ -3496,6 +3659,7 @@ handle_bmsg(struct mISDNchannel *ch, struct sk_buff *skb)
 					    hc->chan[bch->slot].bank_rx);
 			if (!ret) {
 				if (ch->protocol == ISDN_P_B_RAW && !hc->dtmf
+				    && hc->chan[bch->slot].dtmf
 				    && test_bit(HFC_CHIP_DTMF, &hc->chip)) {
 					/* start decoder */
 					hc->dtmf = 1;
@@ -3570,6 +3734,25 @@ channel_bctrl(struct bchannel *bch, struct mISDN_ctrl_req *cq)
 	case MISDN_CTRL_GETOP:
 		ret = mISDN_ctrl_bchannel(bch, cq);
 		cq->op |= MISDN_CTRL_HFC_OP | MISDN_CTRL_HW_FEATURES_OP;
+		if (hc->ctype != HFC_TYPE_XHFC)
+			cq->op |= MISDN_CTRL_GAIN;
+		break;
+	case MISDN_CTRL_GAIN:
+		/*
+		 * the conference unit attenuates its inputs by 0..9 dB, so
+		 * only RX gain 0 or -1 (-6 dB) is possible
+		 */
+		if (hc->ctype == HFC_TYPE_XHFC || cq->p1 ||
+		    cq->p2 < -1 || cq->p2 > 0) {
+			ret = -EINVAL;
+			break;
+		}
+		if (debug & DEBUG_HFCMULTI_MSG)
+			printk(KERN_DEBUG "%s: GAIN request (nr=%d rx=%d)\n",
+			       __func__, bch->nr, cq->p2);
+		hc->chan[bch->slot].conf_att = cq->p2 ? 2 : 0;
+		if (hc->chan[bch->slot].conf >= 0)
+			hfcmulti_conf(hc, bch->slot, hc->chan[bch->slot].conf);
 		break;
 	case MISDN_CTRL_RX_OFF: /* turn off / on rx stream */
 		ret = mISDN_ctrl_bchannel(bch, cq);
@@ -3676,6 +3859,34 @@ channel_bctrl(struct bchannel *bch, struct mISDN_ctrl_req *cq)
 		else
 			ret = -EINVAL;
 		break;
+	case MISDN_CTRL_HFC_DTMF_ON: /* p1 = threshold */
+		if (debug & DEBUG_HFCMULTI_MSG)
+			printk(KERN_DEBUG "%s: HFC_DTMF_ON (threshold %d)\n",
+			       __func__, cq->p1);
+		if (!test_bit(HFC_CHIP_DTMF, &hc->chip)) {
+			ret = -EINVAL;
+			break;
+		}
+		if (!hc->chan[bch->slot].dtmf) {
+			hc->chan[bch->slot].coeff_count = 0;
+			hc->chan[bch->slot].dtmf_lastwhat = 0;
+			hc->chan[bch->slot].dtmf_lastdigit = 0;
+			hc->chan[bch->slot].dtmf_count = 0;
+		}
+		hc->chan[bch->slot].dtmf_treshold = cq->p1;
+		hc->chan[bch->slot].dtmf = 1;
+		if (!hc->dtmf && test_bit(FLG_ACTIVE, &bch->Flags)) {
+			/* start decoder */
+			hc->dtmf = 1;
+			HFC_outb_nodebug(hc, R_DTMF, hc->hw.r_dtmf |
+					 V_RST_DTMF);
+		}
+		break;
+	case MISDN_CTRL_HFC_DTMF_OFF:
+		if (debug & DEBUG_HFCMULTI_MSG)
+			printk(KERN_DEBUG "%s: HFC_DTMF_OFF\n", __func__);
+		hc->chan[bch->slot].dtmf = 0;
+		break;
 	default:
 		ret = mISDN_ctrl_bchannel(bch, cq);
 		break;
@@ -3697,6 +3908,8 @@ hfcm_bctrl(struct mISDNchannel *ch, u_int cmd, void *arg)
 	switch (cmd) {
 	case CLOSE_CHANNEL:
 		test_and_clear_bit(FLG_OPEN, &bch->Flags);
+		hc->chan[bch->slot].dtmf = 0;
+		hc->chan[bch->slot].conf_att = 0;
 		deactivate_bchannel(bch); /* locked there */
 		ch->protocol = ISDN_P_NONE;
 		ch->peer = NULL;
@@ -3815,7 +4028,7 @@ ph_state_change(struct dchannel *dch)
 				} else {
 					/* one extra count for the next event */
 					hc->chan[ch].nt_timer =
-						nt_t1_count[poll_timer] + 1;
+						nt_t1_count[hc->poll_timer] + 1;
 					HFC_outb(hc, R_ST_SEL,
 						 hc->chan[ch].port);
 					/* undocumented: delay after R_ST_SEL */
@@ -4137,7 +4350,7 @@ channel_dctrl(struct dchannel *dch, struct mISDN_ctrl_req *cq)
 			       ", counter 0x%x\n", __func__,
 			       wd_mode ? "AUTO" : "MANUAL", wd_cnt);
 		/* set the watchdog timer */
-		HFC_outb(hc, R_TI_WD, poll_timer | (wd_cnt << 4));
+		HFC_outb(hc, R_TI_WD, hc->poll_timer | (wd_cnt << 4));
 		hc->hw.r_bert_wd_md = (wd_mode ? V_AUTO_WD_RES : 0);
 		if (hc->ctype == HFC_TYPE_XHFC)
 			hc->hw.r_bert_wd_md |= 0x40 /* V_WD_EN */;
@@ -4282,7 +4495,10 @@ init_card(struct hfc_multi *hc)
 	if (debug & DEBUG_HFCMULTI_INIT)
 		printk(KERN_DEBUG "%s: IRQ %d count %d\n",
 		       __func__, hc->irq, hc->irqcnt);
+	/* PCM bus master is detected card by card */
+	mutex_lock(&hfc_probe_mutex);
 	err = init_chip(hc);
+	mutex_unlock(&hfc_probe_mutex);
 	if (err)
 		goto error;
 	/*
@@ -4843,7 +5059,7 @@ init_e1_port(struct hfc_multi *hc, struct hm_map *m, int pt)
 		bch->nr = ch;
 		bch->slot = ch;
 		bch->debug = debug;
-		mISDN_initbchannel(bch, MAX_DATA_MEM, poll >> 1);
+		mISDN_initbchannel(bch, MAX_DATA_MEM, hc->poll >> 1);
 		bch->hw = hc;
 		bch->ch.send = handle_bmsg;
 		bch->ch.ctrl = hfcm_bctrl;
@@ -4916,7 +5132,7 @@ init_multi_port(struct hfc_multi *hc, int pt)
 		bch->nr = ch + 1;
 		bch->slot = i + ch;
 		bch->debug = debug;
-		mISDN_initbchannel(bch, MAX_DATA_MEM, poll >> 1);
+		mISDN_initbchannel(bch, MAX_DATA_MEM, hc->poll >> 1);
 		bch->hw = hc;
 		bch->ch.send = handle_bmsg;
 		bch->ch.ctrl = hfcm_bctrl;
@@ -5000,11 +5216,15 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 	u_char		dips = 0, pmj = 0; /* dip settings, port mode Jumpers */
 	int		i, ch;
 	u_int		maskcheck;
+	ktime_t		start = ktime_get();
 
+	/* card numbers, parameter indexes and port counters */
+	mutex_lock(&hfc_probe_mutex);
 	if (HFC_cnt >= MAX_CARDS) {
 		printk(KERN_ERR "too many cards (max=%d).\n",
 		       MAX_CARDS);
-		return -EINVAL;
+		ret_err = -EINVAL;
+		goto out_unlock;
 	}
 	if ((type[HFC_cnt] & 0xff) && (type[HFC_cnt] & 0xff) != m->type) {
 		printk(KERN_WARNING "HFC-MULTI: Card '%s:%s' type %d found but "
@@ -5013,7 +5233,8 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 		       type[HFC_cnt] & 0xff);
 		printk(KERN_WARNING "HFC-MULTI: Load module without parameters "
 		       "first, to see cards and their types.");
-		return -EINVAL;
+		ret_err = -EINVAL;
+		goto out_unlock;
 	}
 	if (debug & DEBUG_HFCMULTI_INIT)
 		printk(KERN_DEBUG "%s: Registering %s:%s chip type %d (0x%x)\n",
@@ -5024,7 +5245,8 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 	hc = kzalloc(sizeof(struct hfc_multi), GFP_KERNEL);
 	if (!hc) {
 		printk(KERN_ERR "No kmem for HFC-Multi card\n");
-		return -ENOMEM;
+		ret_err = -ENOMEM;
+		goto out_unlock;
 	}
 	spin_lock_init(&hc->lock);
 	hfcmulti_locks[HFC_cnt] = &hc->lock;
@@ -5034,6 +5256,14 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 	hc->id = HFC_cnt;
 	hc->pcm = pcm[HFC_cnt];
 	hc->io_mode = iomode[HFC_cnt];
+	hc->poll = poll_card[HFC_cnt] ? poll_card[HFC_cnt] : poll;
+	hc->poll_timer = poll_to_timer(hc->poll);
+	if (hc->poll_timer < 0) {
+		printk(KERN_ERR "HFC-multi #%d: Wrong poll value (%d).\n",
+		       HFC_cnt + 1, hc->poll);
+		ret_err = -EINVAL;
+		goto free_hc;
+	}
 	if (hc->ctype == HFC_TYPE_E1 && dmask[E1_cnt]) {
 		/* fragment card */
 		pt = 0;
@@ -5048,8 +5278,8 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 				printk(KERN_INFO
 				       "HFC-E1 #%d has overlapping B-channels on fragment #%d\n",
 				       E1_cnt + 1, pt);
-				kfree(hc);
-				return -EINVAL;
+				ret_err = -EINVAL;
+				goto free_hc;
 			}
 			maskcheck |= hc->bmask[pt];
 			printk(KERN_INFO
@@ -5073,13 +5303,13 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 		hc->silence = 0xff; /* ulaw silence */
 	} else
 		hc->silence = 0x2a; /* alaw silence */
-	if ((poll >> 1) > sizeof(hc->silence_data)) {
+	if ((hc->poll >> 1) > sizeof(hc->silence_data)) {
 		printk(KERN_ERR "HFCMULTI error: silence_data too small, "
 		       "please fix\n");
-		kfree(hc);
-		return -EINVAL;
+		ret_err = -EINVAL;
+		goto free_hc;
 	}
-	for (i = 0; i < (poll >> 1); i++)
+	for (i = 0; i < (hc->poll >> 1); i++)
 		hc->silence_data[i] = hc->silence;
 
 	if (hc->ctype != HFC_TYPE_XHFC) {
@@ -5125,8 +5355,7 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 	if (ret_err) {
 		if (hc == syncmaster)
 			syncmaster = NULL;
-		kfree(hc);
-		return ret_err;
+		goto free_hc;
 	}
 
 	hc->HFC_outb_nodebug = hc->HFC_outb;
@@ -5240,6 +5469,10 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 	if (clock == HFC_cnt + 1)
 		hc->iclock = mISDN_register_clock("HFCMulti", 0, clockctl, hc);
 
+	/* the number stays taken, even if the hardware fails below */
+	HFC_cnt++;
+	mutex_unlock(&hfc_probe_mutex);
+
 	/* initialize hardware */
 	hc->irq = (m->irq) ? : hc->pci_dev->irq;
 	ret_err = init_card(hc);
@@ -5253,13 +5486,18 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 	spin_lock_irqsave(&hc->lock, flags);
 	enable_hwirq(hc);
 	spin_unlock_irqrestore(&hc->lock, flags);
+	printk(KERN_INFO "HFC-multi #%d: initialized in %lld ms\n",
+	       hc->id + 1, ktime_ms_delta(ktime_get(), start));
 	return 0;
 
 free_card:
 	release_io_hfcmulti(hc);
 	if (hc == syncmaster)
 		syncmaster = NULL;
+free_hc:
 	kfree(hc);
+out_unlock:
+	mutex_unlock(&hfc_probe_mutex);
 	return ret_err;
 }
 
@@ -5435,7 +5673,6 @@ static int
 hfcmulti_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 {
 	struct hm_map	*m = (struct hm_map *)ent->driver_data;
-	int		ret;
 
 	if (m == NULL && ent->vendor == PCI_VENDOR_ID_CCD && (
 		    ent->device == PCI_DEVICE_ID_CCD_HFC4S ||
@@ -5450,12 +5687,7 @@ hfcmulti_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 		       "Please contact the driver maintainer for support.\n");
 		return -ENODEV;
 	}
-	ret = hfcmulti_init(m, pdev, ent);
-	if (ret)
-		return ret;
-	HFC_cnt++;
-	printk(KERN_INFO "%d devices registered\n", HFC_cnt);
-	return 0;
+	return hfcmulti_init(m, pdev, ent);
 }
 
 static struct pci_driver hfcmultipci_driver = {
@@ -5463,8 +5695,38 @@ static struct pci_driver hfcmultipci_driver = {
 	.probe		= hfcmulti_probe,
 	.remove		= hfc_remove_pci,
 	.id_table	= hfmultipci_ids,
+	.driver		= {
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+	},
 };
 
+/*
+ * per card parameters, the clock card number and the bmask fragments are
+ * indexed in probe order, so cards are probed one after the other, if any
+ * of them is given
+ */
+static int
+hfcmulti_card_params(void)
+{
+	int i;
+
+	if (clock)
+		return 1;
+	for (i = 0; i < MAX_CARDS; i++) {
+		if (type[i] || pcm[i] || dmask[i] || iomode[i] || poll_card[i])
+			return 1;
+	}
+	for (i = 0; i < MAX_FRAGS; i++) {
+		if (bmask[i])
+			return 1;
+	}
+	for (i = 0; i < MAX_PORTS; i++) {
+		if (port[i])
+			return 1;
+	}
+	return 0;
+}
+
 static void __exit
 HFCmulti_cleanup(void)
 {
@@ -5495,37 +5757,18 @@ HFCmulti_init(void)
 	if (debug & DEBUG_HFCMULTI_INIT)
 		printk(KERN_DEBUG "%s: init entered\n", __func__);
 
-	switch (poll) {
-	case 0:
-		poll_timer = 6;
+	if (!poll)
 		poll = 128;
-		break;
-	case 8:
-		poll_timer = 2;
-		break;
-	case 16:
-		poll_timer = 3;
-		break;
-	case 32:
-		poll_timer = 4;
-		break;
-	case 64:
-		poll_timer = 5;
-		break;
-	case 128:
-		poll_timer = 6;
-		break;
-	case 256:
-		poll_timer = 7;
-		break;
-	default:
+	if (poll_to_timer(poll) < 0) {
 		printk(KERN_ERR
 		       "%s: Wrong poll value (%d).\n", __func__, poll);
 		err = -EINVAL;
 		return err;
-
 	}
 
+	/* check before the clock card defaults to the first one */
+	if (hfcmulti_card_params())
+		hfcmultipci_driver.driver.probe_type = PROBE_FORCE_SYNCHRONOUS;
 	if (!clock)
 		clock = 1;
 
@@ -5555,8 +5798,6 @@ HFCmulti_init(void)
 			       "%x\n", err);
 			return err;
 		}
-		HFC_cnt++;
-		printk(KERN_INFO "%d devices registered\n", HFC_cnt);
 	}
 
 	/* Register the PCI cards */
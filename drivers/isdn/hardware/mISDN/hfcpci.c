@@ -408,9 +408,7 @@ hfcpci_empty_bfifo(struct bchannel *bch, struct bzfifo *bz,
 		if (bch->debug & DEBUG_HW)
 			printk(KERN_DEBUG "hfcpci_empty_fifo: incoming packet "
 			       "invalid length %d or crc\n", count);
-#ifdef ERROR_STATISTIC
-		bch->err_inv++;
-#endif
+		bch_stats_inc(bch, frame_err);
 		bz->za[new_f2].z2 = cpu_to_le16(new_z2);
 		bz->f2 = new_f2;	/* next buffer */
 	} else {
@@ -568,6 +566,8 @@ hfcpci_empty_fifo_trans(struct bchannel *bch, struct bzfifo *rxbz,
 	if (maxlen < 0) {
 		pr_warn("B%d: No bufferspace for %d bytes\n", bch->nr, fcnt_rx);
 	} else {
+		/* the fifo moves once per F0 frame */
+		mISDN_stamp_rx(bch->rx_skb, fcnt_rx);
 		ptr = skb_put(bch->rx_skb, fcnt_rx);
 		if (le16_to_cpu(*z2r) + fcnt_rx <= B_FIFO_SIZE + B_SUB_VAL)
 			maxlen = fcnt_rx;	/* complete transfer */
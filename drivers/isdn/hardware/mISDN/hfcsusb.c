@@ -924,6 +924,8 @@ hfcsusb_rx_frame(struct usb_fifo *fifo, __u8 *data, unsigned int len,
 						       rx_skb->data[i++]);
 					printk("\n");
 				}
+				if (fifo->bch)
+					bch_stats_inc(fifo->bch, crc_err);
 				skb_trim(rx_skb, 0);
 			}
 		}
@@ -13,6 +13,8 @@
 #ifndef _IOHELPER_H
 #define _IOHELPER_H
 
+#include <linux/io.h>
+
 typedef	u8	(read_reg_func)(void *hwp, u8 offset);
 			       typedef	void	(write_reg_func)(void *hwp, u8 offset, u8 value);
 			       typedef	void	(fifo_func)(void *hwp, u8 offset, u8 *datap, int size);
@@ -22,6 +24,91 @@ typedef	u8	(read_reg_func)(void *hwp, u8 offset);
 				       u32	ale;
 			       };
 
+/*
+ * Direct access description for drivers which want the register access
+ * inlined into their interrupt path instead of going through the
+ * read_reg/write_reg function pointers. The mode is selected once at
+ * probe time, the users dispatch on it with a compile time constant.
+ */
+#define IOHELPER_NONE	0	/* use the function pointers */
+#define IOHELPER_IO	1
+#define IOHELPER_IND	2
+#define IOHELPER_MEMIO	3
+
+struct _iodirect {
+	u32		mode;
+	u32		port;
+	u32		ale;
+	void __iomem	*p;
+	u32		shift;	/* register stride for MEMIO */
+};
+
+static __always_inline u8
+iodirect_read(struct _iodirect *io, const u32 mode, u8 off)
+{
+	switch (mode) {
+	case IOHELPER_IND:
+		outb(off, io->ale);
+		return inb(io->port);
+	case IOHELPER_MEMIO:
+		return readb(io->p + (off << io->shift));
+	default:
+		return inb(io->port + off);
+	}
+}
+
+static __always_inline void
+iodirect_write(struct _iodirect *io, const u32 mode, u8 off, u8 val)
+{
+	switch (mode) {
+	case IOHELPER_IND:
+		outb(off, io->ale);
+		outb(val, io->port);
+		break;
+	case IOHELPER_MEMIO:
+		writeb(val, io->p + (off << io->shift));
+		break;
+	default:
+		outb(val, io->port + off);
+	}
+}
+
+static __always_inline void
+iodirect_read_fifo(struct _iodirect *io, const u32 mode, u8 off, u8 *dp,
+		   int size)
+{
+	switch (mode) {
+	case IOHELPER_IND:
+		outb(off, io->ale);
+		insb(io->port, dp, size);
+		break;
+	case IOHELPER_MEMIO:
+		while (size--)
+			*dp++ = readb(io->p + (off << io->shift));
+		break;
+	default:
+		insb(io->port + off, dp, size);
+	}
+}
+
+static __always_inline void
+iodirect_write_fifo(struct _iodirect *io, const u32 mode, u8 off, u8 *dp,
+		    int size)
+{
+	switch (mode) {
+	case IOHELPER_IND:
+		outb(off, io->ale);
+		outsb(io->port, dp, size);
+		break;
+	case IOHELPER_MEMIO:
+		while (size--)
+			writeb(*dp++, io->p + (off << io->shift));
+		break;
+	default:
+		outsb(io->port + off, dp, size);
+	}
+}
+
 #define IOFUNC_IO(name, hws, ap)					\
 	static u8 Read##name##_IO(void *p, u8 off) {			\
 		struct hws *hw = p;					\
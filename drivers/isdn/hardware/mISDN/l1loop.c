@@ -38,6 +38,22 @@
  * - pri=<n>, n=[0,1] default 0
  *      0: register all interfaces as BRI
  *      1: register all interfaces as PRI
+ * - loss=<n>[,<n>...], n=[0..1000] default 0
+ *     frames lost per 1000 frames
+ * - corrupt=<n>[,<n>...], n=[0..1000] default 0
+ *     frames with one flipped bit per 1000 frames. HDLC frames (D-channel
+ *     and HDLC B-channel) are dropped and counted as CRC error instead,
+ *     like a controller does.
+ * - delay=<n>[,<n>...] default 0
+ *     fixed delay of each frame in ms
+ * - jitter=<n>[,<n>...] default 0
+ *     random additional delay of each frame, 0..n ms
+ * - reorder=<n>[,<n>...], n=[0..1000] default 0
+ *     frames held back L1LOOP_REORDER_MS per 1000 frames, so that the
+ *     following frames overtake them
+ *     All impairment values are given per interface and apply to the frames
+ *     sent by that interface. They may be changed at runtime. Counters of
+ *     injected events are found in debugfs at l1loop/<interface>.
  * - debug=<n>, default=0, with n=0xHHHHGGGG
  *      H - l1 driver flags described in hfcs_usb.h
  *      G - common mISDN debug flags described at mISDNhw.h
@@ -46,6 +62,9 @@
 
 #include <linux/module.h>
 #include <linux/delay.h>
+#include <linux/random.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/mISDNhw.h>
 #include "l1loop.h"
 
@@ -57,6 +76,7 @@ static LIST_HEAD(l1loop_list);
 static DEFINE_RWLOCK(l1loop_lock);
 struct l1loop *hw;
 struct port *vbusnt; /* NT of virtual S0/E1 bus when using vline=1 */
+static struct dentry *l1loop_debugfs;
 
 /* module params */
 static unsigned int interfaces = 2;
@@ -64,6 +84,11 @@ static unsigned int vline = 1;
 static unsigned int nchannel[32] = {2};
 static unsigned int pri;
 static unsigned int debug;
+static unsigned int loss[64];
+static unsigned int corrupt[64];
+static unsigned int delay[64];
+static unsigned int jitter[64];
+static unsigned int reorder[64];
 
 MODULE_AUTHOR("Martin Bachem");
 MODULE_LICENSE("GPL");
@@ -72,6 +97,11 @@ module_param(vline, uint, S_IRUGO | S_IWUSR);
 module_param_array(nchannel, uint, NULL, S_IRUGO | S_IWUSR);
 module_param(pri, uint, S_IRUGO | S_IWUSR);
 module_param(debug, uint, S_IRUGO | S_IWUSR);
+module_param_array(loss, uint, NULL, S_IRUGO | S_IWUSR);
+module_param_array(corrupt, uint, NULL, S_IRUGO | S_IWUSR);
+module_param_array(delay, uint, NULL, S_IRUGO | S_IWUSR);
+module_param_array(jitter, uint, NULL, S_IRUGO | S_IWUSR);
+module_param_array(reorder, uint, NULL, S_IRUGO | S_IWUSR);
 
 /*
  * send full D/B channel status information
@@ -163,17 +193,207 @@ deactivate_bchannel(struct bchannel *bch)
 		bch->tx_skb = NULL;
 	}
 	bch->tx_idx = 0;
+	/* no delayed frame may be delivered after this */
+	spin_lock_bh(&p->rx_lock);
 	if (bch->rx_skb) {
 		dev_kfree_skb(bch->rx_skb);
 		bch->rx_skb = NULL;
 	}
 	clear_bit(FLG_ACTIVE, &bch->Flags);
+	spin_unlock_bh(&p->rx_lock);
 	clear_bit(FLG_TX_BUSY, &bch->Flags);
 	spin_unlock(&p->lock);
 
 	l1loop_setup_bch(bch, ISDN_P_NONE);
 }
 
+/*
+ * hand a received frame to the target channel
+ */
+static void
+l1loop_deliver(struct port *to, int kind, void *target, struct sk_buff *skb)
+{
+	struct dchannel *dch = target;
+	struct bchannel *bch = target;
+
+	memset(skb->cb, 0, sizeof(skb->cb));
+	spin_lock_bh(&to->rx_lock);
+	switch (kind) {
+	case L1LOOP_RX_D:
+		dch->rx_skb = skb;
+		recv_Dchannel(dch);
+		break;
+	case L1LOOP_RX_E:
+		dch->rx_skb = skb;
+		recv_Echannel(dch, dch);
+		break;
+	case L1LOOP_RX_B:
+		if (!test_bit(FLG_ACTIVE, &bch->Flags)) {
+			/* deactivated while the frame was delayed */
+			dev_kfree_skb(skb);
+			break;
+		}
+		bch->rx_skb = skb;
+		recv_Bchannel(bch, MISDN_ID_ANY, false);
+		break;
+	}
+	spin_unlock_bh(&to->rx_lock);
+}
+
+/*
+ * deliver all delayed frames that are due
+ */
+static void
+l1loop_delay_timer(struct timer_list *t)
+{
+	struct port *p = from_timer(p, t, delay_tl);
+	struct sk_buff *skb;
+	struct l1loop_rx rx;
+	u_long flags;
+
+	spin_lock_irqsave(&p->delayq.lock, flags);
+	while ((skb = skb_peek(&p->delayq))) {
+		rx = *L1LOOP_RX_P(skb);
+		if (time_after(rx.due, jiffies)) {
+			mod_timer(&p->delay_tl, rx.due);
+			break;
+		}
+		__skb_unlink(skb, &p->delayq);
+		spin_unlock_irqrestore(&p->delayq.lock, flags);
+		if (rx.kind != L1LOOP_RX_B && !test_bit(FLG_ACTIVE,
+		    &((struct dchannel *)rx.target)->Flags))
+			/* layer1 deactivated while the frame was delayed */
+			dev_kfree_skb(skb);
+		else
+			l1loop_deliver(p, rx.kind, rx.target, skb);
+		spin_lock_irqsave(&p->delayq.lock, flags);
+	}
+	spin_unlock_irqrestore(&p->delayq.lock, flags);
+}
+
+static void
+l1loop_delay(struct port *to, int kind, void *target, struct sk_buff *skb,
+	     u_int ms)
+{
+	struct l1loop_rx *rx = L1LOOP_RX_P(skb);
+	struct sk_buff *prev;
+	u_long flags;
+
+	rx->target = target;
+	rx->kind = kind;
+	rx->due = jiffies + msecs_to_jiffies(ms);
+	spin_lock_irqsave(&to->delayq.lock, flags);
+	/* frames due at the same time keep their order */
+	skb_queue_reverse_walk(&to->delayq, prev) {
+		if (!time_after(L1LOOP_RX_P(prev)->due, rx->due))
+			break;
+	}
+	__skb_queue_after(&to->delayq, prev, skb);
+	if (skb_peek(&to->delayq) == skb)
+		mod_timer(&to->delay_tl, rx->due);
+	spin_unlock_irqrestore(&to->delayq.lock, flags);
+}
+
+static int
+l1loop_chance(u_int permille)
+{
+	return permille && (get_random_u32() % 1000) < permille;
+}
+
+/*
+ * copy a frame sent by port 'from' to the target channel, with the line
+ * impairment configured for 'from'
+ */
+static void
+l1loop_rx(struct port *from, int kind, void *target, struct sk_buff *skb)
+{
+	struct dchannel *dch = target;
+	struct bchannel *bch = target;
+	struct port *to = (kind == L1LOOP_RX_B) ? bch->hw : dch->hw;
+	struct sk_buff *nskb;
+	int i = from->instance;
+	int hdlc, crc_err = 0;
+	u_int ms;
+
+	nskb = skb_copy(skb, GFP_KERNEL);
+	if (!nskb) {
+		if (debug & DEBUG_HW)
+			printk(KERN_ERR "%s: %s: skb_copy failed\n",
+				from->name, __func__);
+		return;
+	}
+	if (!(loss[i] | corrupt[i] | delay[i] | jitter[i] | reorder[i])) {
+		l1loop_deliver(to, kind, target, nskb);
+		return;
+	}
+
+	hdlc = (kind != L1LOOP_RX_B) || test_bit(FLG_HDLC, &bch->Flags);
+	ms = delay[i];
+	if (jitter[i])
+		ms += get_random_u32() % (jitter[i] + 1);
+	spin_lock(&from->lock);
+	if (l1loop_chance(loss[i])) {
+		from->impair.lost++;
+		spin_unlock(&from->lock);
+		dev_kfree_skb(nskb);
+		return;
+	}
+	if (nskb->len && l1loop_chance(corrupt[i])) {
+		from->impair.corrupted++;
+		if (hdlc) {
+			from->impair.crc_err++;
+			crc_err = 1;
+		} else
+			nskb->data[get_random_u32() % nskb->len] ^=
+				1 << (get_random_u32() % 8);
+	}
+	if (!crc_err && l1loop_chance(reorder[i])) {
+		from->impair.reordered++;
+		ms += L1LOOP_REORDER_MS;
+	}
+	if (!crc_err && ms)
+		from->impair.delayed++;
+	spin_unlock(&from->lock);
+
+	if (crc_err) {
+		/* the receiver's HDLC controller discards the frame */
+		spin_lock_bh(&to->rx_lock);
+		if (kind == L1LOOP_RX_B)
+			bch_stats_inc(bch, crc_err);
+		else
+			dch->err_crc++;
+		spin_unlock_bh(&to->rx_lock);
+		dev_kfree_skb(nskb);
+	} else if (ms)
+		l1loop_delay(to, kind, target, nskb, ms);
+	else
+		l1loop_deliver(to, kind, target, nskb);
+}
+
+/*
+ * debugfs l1loop/<interface>: impairment settings and injected events
+ */
+static int
+l1loop_impair_show(struct seq_file *m, void *unused)
+{
+	struct port *p = m->private;
+	int i = p->instance;
+
+	seq_printf(m, "loss:      %u/1000\n", loss[i]);
+	seq_printf(m, "corrupt:   %u/1000\n", corrupt[i]);
+	seq_printf(m, "delay:     %u ms\n", delay[i]);
+	seq_printf(m, "jitter:    %u ms\n", jitter[i]);
+	seq_printf(m, "reorder:   %u/1000\n", reorder[i]);
+	seq_printf(m, "lost:      %llu\n", p->impair.lost);
+	seq_printf(m, "corrupted: %llu\n", p->impair.corrupted);
+	seq_printf(m, "crc_err:   %llu\n", p->impair.crc_err);
+	seq_printf(m, "delayed:   %llu\n", p->impair.delayed);
+	seq_printf(m, "reordered: %llu\n", p->impair.reordered);
+	seq_printf(m, "queued:    %u\n", skb_queue_len(&p->delayq));
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(l1loop_impair);
+
 /*
  * bch layer1 loop (vline=2): immediatly loop back every B-channel data
  */
@@ -181,13 +401,7 @@ static void bch_vline_loop(struct bchannel *bch, struct sk_buff *skb)
 {
 	struct port *p = bch->hw;
 
-	bch->rx_skb = skb_copy(skb, GFP_KERNEL);
-	if (bch->rx_skb)
-		recv_Bchannel(bch, MISDN_ID_ANY, false);
-	else
-		if (debug & DEBUG_HW)
-			printk(KERN_ERR "%s: %s: mI_alloc_skb failed\n",
-				p->name, __func__);
+	l1loop_rx(p, L1LOOP_RX_B, bch, skb);
 	dev_kfree_skb(skb);
 	get_next_bframe(bch);
 }
@@ -206,12 +420,8 @@ static void bch_vbus(struct bchannel *bch, struct sk_buff *skb)
 	for (i = 0; i < interfaces; i++) {
 		party = hw->ports + i;
 		target = &party->bch[b];
-		if ((me != party) && test_bit(FLG_ACTIVE, &target->Flags)) {
-			/* immediately queue data to bch's RX queue */
-			target->rx_skb = skb_copy(skb, GFP_KERNEL);
-			if (target->rx_skb)
-				recv_Bchannel(target, MISDN_ID_ANY, false);
-		}
+		if ((me != party) && test_bit(FLG_ACTIVE, &target->Flags))
+			l1loop_rx(me, L1LOOP_RX_B, target, skb);
 	}
 
 	dev_kfree_skb(skb);
@@ -230,12 +440,8 @@ static void bch_vlink(struct bchannel *bch, struct sk_buff *skb)
 
 	b = bch->nr - 1 - (bch->nr > 16);
 	target = &party->bch[b];
-	if (test_bit(FLG_ACTIVE, &target->Flags)) {
-		/* immediately queue data to bch's RX queue */
-		target->rx_skb = skb_copy(skb, GFP_KERNEL);
-		if (target->rx_skb)
-			recv_Bchannel(target, MISDN_ID_ANY, false);
-	}
+	if (test_bit(FLG_ACTIVE, &target->Flags))
+		l1loop_rx(me, L1LOOP_RX_B, target, skb);
 
 	dev_kfree_skb(skb);
 	get_next_bframe(bch);
@@ -484,13 +690,7 @@ static void dch_vline_loop(struct dchannel *dch, struct sk_buff *skb)
 {
 	struct port *p = dch->hw;
 
-	dch->rx_skb = skb_copy(skb, GFP_KERNEL);
-	if (dch->rx_skb)
-		recv_Dchannel(dch);
-	else
-		if (debug & DEBUG_HW)
-			printk(KERN_ERR "%s: %s: mI_alloc_skb failed\n",
-				p->name, __func__);
+	l1loop_rx(p, L1LOOP_RX_D, dch, skb);
 	dev_kfree_skb(skb);
 	get_next_dframe(dch);
 }
@@ -504,11 +704,8 @@ static void dch_vline_link(struct dchannel *dch, struct sk_buff *skb)
 	struct port *party = &hw->ports[me->instance ^ 1];
 	struct dchannel *party_dch = &party->dch;
 
-	if (test_bit(FLG_ACTIVE, &party_dch->Flags)) {
-		party_dch->rx_skb = skb_copy(skb, GFP_KERNEL);
-		if (party_dch->rx_skb)
-			recv_Dchannel(party_dch);
-	}
+	if (test_bit(FLG_ACTIVE, &party_dch->Flags))
+		l1loop_rx(me, L1LOOP_RX_D, party_dch, skb);
 	dev_kfree_skb(skb);
 	get_next_dframe(dch);
 }
@@ -526,20 +723,15 @@ static void dch_vbus_S0(struct dchannel *dch, struct sk_buff *skb)
 	if (vbusnt) {
 		if (me != vbusnt) {
 			/* TE -> NT */
-			vbusnt->dch.rx_skb = skb_copy(skb, GFP_KERNEL);
-			if (vbusnt->dch.rx_skb)
-				recv_Dchannel(&vbusnt->dch);
+			l1loop_rx(me, L1LOOP_RX_D, &vbusnt->dch, skb);
 			/* virtual E-channel ECHO */
 			for (i = 0; i < interfaces; i++) {
 				party = hw->ports + i;
 				if ((party != vbusnt) && test_bit(FLG_ACTIVE,
 				     &party->dch.Flags)) {
 					party_dch = &party->dch;
-					party_dch->rx_skb = skb_copy(skb,
-							GFP_KERNEL);
-					if (party_dch->rx_skb)
-						recv_Echannel(party_dch,
-							party_dch);
+					l1loop_rx(me, L1LOOP_RX_E, party_dch,
+						  skb);
 				}
 			}
 		} else {
@@ -549,10 +741,8 @@ static void dch_vbus_S0(struct dchannel *dch, struct sk_buff *skb)
 				if ((me != party) && test_bit(FLG_ACTIVE,
 				     &party->dch.Flags)) {
 					party_dch = &party->dch;
-					party_dch->rx_skb = skb_copy(skb,
-							GFP_KERNEL);
-					if (party_dch->rx_skb)
-						recv_Dchannel(party_dch);
+					l1loop_rx(me, L1LOOP_RX_D, party_dch,
+						  skb);
 				}
 			}
 		}
@@ -568,18 +758,13 @@ static void dch_vbus_E1(struct dchannel *dch, struct sk_buff *skb)
 {
 	struct port *me = dch->hw;
 	struct port *party;
-	struct dchannel *party_dch;
 	int i;
 
 	/* NT->TE / TE->NT */
 	for (i = 0; i < interfaces; i++) {
 		party = hw->ports + i;
-		if ((me != party) && test_bit(FLG_ACTIVE, &party->dch.Flags)) {
-			party_dch = &party->dch;
-			party_dch->rx_skb = skb_copy(skb, GFP_KERNEL);
-			if (party_dch->rx_skb)
-				recv_Dchannel(party_dch);
-		}
+		if ((me != party) && test_bit(FLG_ACTIVE, &party->dch.Flags))
+			l1loop_rx(me, L1LOOP_RX_D, &party->dch, skb);
 	}
 	dev_kfree_skb(skb);
 	get_next_dframe(dch);
@@ -666,10 +851,12 @@ l1loop_l2l1D(struct mISDNchannel *ch, struct sk_buff *skb) {
 			dch->tx_skb = NULL;
 		}
 		dch->tx_idx = 0;
+		spin_lock_bh(&p->rx_lock);
 		if (dch->rx_skb) {
 			dev_kfree_skb(dch->rx_skb);
 			dch->rx_skb = NULL;
 		}
+		spin_unlock_bh(&p->rx_lock);
 		spin_unlock(&p->lock);
 		ret = 0;
 		break;
@@ -934,6 +1121,9 @@ setup_instance(struct l1loop *hw) {
 		}
 
 		spin_lock_init(&p->lock);
+		spin_lock_init(&p->rx_lock);
+		skb_queue_head_init(&p->delayq);
+		timer_setup(&p->delay_tl, l1loop_delay_timer, 0);
 		p->instance = i;
 		mISDN_initdchannel(&p->dch, MAX_DFRAME_LEN_L1, ph_state);
 		p->dch.debug = debug & 0xFFFF;
@@ -974,6 +1164,8 @@ setup_instance(struct l1loop *hw) {
 				mISDN_freebchannel(&p->bch[b]);
 			mISDN_freedchannel(&p->dch);
 		} else {
+			p->debugfs = debugfs_create_file(p->name, 0444,
+					l1loop_debugfs, p, &l1loop_impair_fops);
 			l1loop_cnt++;
 			write_lock_irqsave(&l1loop_lock, flags);
 			list_add_tail(&hw->list, &l1loop_list);
@@ -998,6 +1190,14 @@ release_instance(struct l1loop *hw) {
 			l1loop_setup_bch(&p->bch[b], ISDN_P_NONE);
 
 		mISDN_unregister_device(&p->dch.dev);
+	}
+	debugfs_remove_recursive(l1loop_debugfs);
+
+	/* no port sends anymore, so no frame is delayed after this */
+	for (i = 0; i < interfaces; i++) {
+		p = hw->ports + i;
+		del_timer_sync(&p->delay_tl);
+		skb_queue_purge(&p->delayq);
 		for (b = 0; b < p->nrbchan; b++)
 			mISDN_freebchannel(&p->bch[b]);
 		mISDN_freedchannel(&p->dch);
@@ -1016,7 +1216,7 @@ release_instance(struct l1loop *hw) {
 static int __init
 l1loop_init(void)
 {
-	int i;
+	int i, err;
 
 	if (vline == 3 && (interfaces & 1)) {
 		printk(KERN_ERR "%s: %s: an even number of interfaces are "
@@ -1057,7 +1257,11 @@ l1loop_init(void)
 		return -ENOMEM;
 	}
 
-	return setup_instance(hw);
+	l1loop_debugfs = debugfs_create_dir("l1loop", NULL);
+	err = setup_instance(hw);
+	if (err)
+		debugfs_remove_recursive(l1loop_debugfs);
+	return err;
 }
 
 static void __exit
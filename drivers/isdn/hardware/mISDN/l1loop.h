@@ -44,8 +44,35 @@ char *ISDN_P_TEXT[] = {
 
 struct hwskel;
 
+/* line impairment, frame delivery is delayed with skb->cb */
+#define L1LOOP_RX_D		0	/* D-channel */
+#define L1LOOP_RX_E		1	/* E-channel (S0 bus echo) */
+#define L1LOOP_RX_B		2	/* B-channel */
+#define L1LOOP_REORDER_MS	10	/* hold back time of reordered frames */
+
+struct l1loop_rx {
+	void		*target;	/* receiving dchannel or bchannel */
+	int		kind;
+	unsigned long	due;		/* jiffies */
+};
+#define L1LOOP_RX_P(s)	((struct l1loop_rx *)&((s)->cb[0]))
+
+/* injected events of frames sent by a port */
+struct l1loop_impair_stats {
+	u64	lost;
+	u64	corrupted;
+	u64	crc_err;	/* corrupted HDLC frames, dropped */
+	u64	delayed;
+	u64	reordered;
+};
+
 struct port {
 	spinlock_t	lock; /* port lock */
+	spinlock_t	rx_lock; /* delivery of frames to this port */
+	struct sk_buff_head	delayq; /* delayed frames, ordered by due */
+	struct timer_list	delay_tl;
+	struct l1loop_impair_stats	impair;
+	struct dentry	*debugfs;
 	int		instance;
 	char		name[MISDN_MAX_IDLEN];
 	struct dchannel	dch;
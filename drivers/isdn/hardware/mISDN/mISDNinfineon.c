@@ -647,6 +647,20 @@ release_io(struct inf_hw *hw)
 	}
 }
 
+/* let mISDNipac inline the register access matching our IOFUNC set */
+static void
+set_iodirect(struct _iodirect *io, struct _ioaddr *a, u32 mode)
+{
+	io->mode = mode;
+	if (mode == IOHELPER_MEMIO) {
+		io->p = a->a.p;
+		io->shift = 2;	/* registers are u32 spaced */
+	} else {
+		io->port = a->a.io.port;
+		io->ale = a->a.io.ale;
+	}
+}
+
 static int
 setup_io(struct inf_hw *hw)
 {
@@ -836,12 +850,18 @@ setup_io(struct inf_hw *hw)
 	switch (hw->isac.mode) {
 	case AM_MEMIO:
 		ASSIGN_FUNC_IPAC(MIO, hw->ipac);
+		set_iodirect(&hw->ipac.isac.io, &hw->isac, IOHELPER_MEMIO);
+		set_iodirect(&hw->ipac.io, &hw->hscx, IOHELPER_MEMIO);
 		break;
 	case AM_IND_IO:
 		ASSIGN_FUNC_IPAC(IND, hw->ipac);
+		set_iodirect(&hw->ipac.isac.io, &hw->isac, IOHELPER_IND);
+		set_iodirect(&hw->ipac.io, &hw->hscx, IOHELPER_IND);
 		break;
 	case AM_IO:
 		ASSIGN_FUNC_IPAC(IO, hw->ipac);
+		set_iodirect(&hw->ipac.isac.io, &hw->isac, IOHELPER_IO);
+		set_iodirect(&hw->ipac.io, &hw->hscx, IOHELPER_IO);
 		break;
 	default:
 		return -EINVAL;
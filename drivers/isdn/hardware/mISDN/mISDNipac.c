@@ -23,16 +23,95 @@ MODULE_AUTHOR("Karsten Keil");
 MODULE_VERSION(ISAC_REV);
 MODULE_LICENSE("GPL v2");
 
-#define ReadISAC(is, o)		(is->read_reg(is->dch.hw, o + is->off))
-#define	WriteISAC(is, o, v)	(is->write_reg(is->dch.hw, o + is->off, v))
-#define ReadHSCX(h, o)		(h->ip->read_reg(h->ip->hw, h->off + o))
-#define WriteHSCX(h, o, v)	(h->ip->write_reg(h->ip->hw, h->off + o, v))
-#define ReadIPAC(ip, o)		(ip->read_reg(ip->hw, o))
-#define WriteIPAC(ip, o, v)	(ip->write_reg(ip->hw, o, v))
+/*
+ * All register accessors take the access mode from a variable "am" in
+ * scope. The interrupt path gets "am" as a constant from the dispatch in
+ * mISDNisac_irq()/mISDNipac_irq(), so with IOHELPER_NONE the indirect
+ * read_reg/write_reg calls are used and otherwise the port or memory
+ * access is inlined; the slow paths simply pass the runtime mode.
+ */
+static __always_inline u8
+isac_rd(struct isac_hw *isac, const u32 am, u8 off)
+{
+	if (am == IOHELPER_NONE)
+		return isac->read_reg(isac->dch.hw, off);
+	return iodirect_read(&isac->io, am, off);
+}
+
+static __always_inline void
+isac_wr(struct isac_hw *isac, const u32 am, u8 off, u8 val)
+{
+	if (am == IOHELPER_NONE)
+		isac->write_reg(isac->dch.hw, off, val);
+	else
+		iodirect_write(&isac->io, am, off, val);
+}
+
+static __always_inline void
+isac_rd_fifo(struct isac_hw *isac, const u32 am, u8 off, u8 *dp, int size)
+{
+	if (am == IOHELPER_NONE)
+		isac->read_fifo(isac->dch.hw, off, dp, size);
+	else
+		iodirect_read_fifo(&isac->io, am, off, dp, size);
+}
+
+static __always_inline void
+isac_wr_fifo(struct isac_hw *isac, const u32 am, u8 off, u8 *dp, int size)
+{
+	if (am == IOHELPER_NONE)
+		isac->write_fifo(isac->dch.hw, off, dp, size);
+	else
+		iodirect_write_fifo(&isac->io, am, off, dp, size);
+}
+
+static __always_inline u8
+ipac_rd(struct ipac_hw *ipac, const u32 am, u8 off)
+{
+	if (am == IOHELPER_NONE)
+		return ipac->read_reg(ipac->hw, off);
+	return iodirect_read(&ipac->io, am, off);
+}
+
+static __always_inline void
+ipac_wr(struct ipac_hw *ipac, const u32 am, u8 off, u8 val)
+{
+	if (am == IOHELPER_NONE)
+		ipac->write_reg(ipac->hw, off, val);
+	else
+		iodirect_write(&ipac->io, am, off, val);
+}
+
+static __always_inline void
+ipac_rd_fifo(struct ipac_hw *ipac, const u32 am, u8 off, u8 *dp, int size)
+{
+	if (am == IOHELPER_NONE)
+		ipac->read_fifo(ipac->hw, off, dp, size);
+	else
+		iodirect_read_fifo(&ipac->io, am, off, dp, size);
+}
+
+static __always_inline void
+ipac_wr_fifo(struct ipac_hw *ipac, const u32 am, u8 off, u8 *dp, int size)
+{
+	if (am == IOHELPER_NONE)
+		ipac->write_fifo(ipac->hw, off, dp, size);
+	else
+		iodirect_write_fifo(&ipac->io, am, off, dp, size);
+}
+
+#define ReadISAC(is, o)		isac_rd(is, am, (o) + (is)->off)
+#define	WriteISAC(is, o, v)	isac_wr(is, am, (o) + (is)->off, v)
+#define ReadHSCX(h, o)		ipac_rd((h)->ip, am, (h)->off + (o))
+#define WriteHSCX(h, o, v)	ipac_wr((h)->ip, am, (h)->off + (o), v)
+#define ReadIPAC(ip, o)		ipac_rd(ip, am, o)
+#define WriteIPAC(ip, o, v)	ipac_wr(ip, am, o, v)
 
 static inline void
 ph_command(struct isac_hw *isac, u8 command)
 {
+	const u32 am = isac->io.mode;
+
 	pr_debug("%s: ph_command %x\n", isac->name, command);
 	if (isac->type & IPAC_TYPE_ISACX)
 		WriteISAC(isac, ISACX_CIX0, (command << 4) | 0xE);
@@ -100,8 +179,8 @@ isac_ph_state_bh(struct dchannel *dch)
 	pr_debug("%s: TE newstate %x\n", isac->name, dch->state);
 }
 
-static void
-isac_empty_fifo(struct isac_hw *isac, int count)
+static __always_inline void
+isac_empty_fifo(struct isac_hw *isac, int count, const u32 am)
 {
 	u8 *ptr;
 
@@ -122,7 +201,7 @@ isac_empty_fifo(struct isac_hw *isac, int count)
 		return;
 	}
 	ptr = skb_put(isac->dch.rx_skb, count);
-	isac->read_fifo(isac->dch.hw, isac->off, ptr, count);
+	isac_rd_fifo(isac, am, isac->off, ptr, count);
 	WriteISAC(isac, ISAC_CMDR, 0x80);
 	if (isac->dch.debug & DEBUG_HW_DFIFO) {
 		char	pfx[MISDN_MAX_IDLEN + 16];
@@ -133,8 +212,8 @@ isac_empty_fifo(struct isac_hw *isac, int count)
 	}
 }
 
-static void
-isac_fill_fifo(struct isac_hw *isac)
+static __always_inline void
+isac_fill_fifo(struct isac_hw *isac, const u32 am)
 {
 	int count, more;
 	u8 *ptr;
@@ -153,7 +232,7 @@ isac_fill_fifo(struct isac_hw *isac)
 	pr_debug("%s: %s  %d\n", isac->name, __func__, count);
 	ptr = isac->dch.tx_skb->data + isac->dch.tx_idx;
 	isac->dch.tx_idx += count;
-	isac->write_fifo(isac->dch.hw, isac->off, ptr, count);
+	isac_wr_fifo(isac, am, isac->off, ptr, count);
 	WriteISAC(isac, ISAC_CMDR, more ? 0x8 : 0xa);
 	if (test_and_set_bit(FLG_BUSY_TIMER, &isac->dch.Flags)) {
 		pr_debug("%s: %s dbusytimer running\n", isac->name, __func__);
@@ -170,8 +249,8 @@ isac_fill_fifo(struct isac_hw *isac)
 	}
 }
 
-static void
-isac_rme_irq(struct isac_hw *isac)
+static __always_inline void
+isac_rme_irq(struct isac_hw *isac, const u32 am)
 {
 	u8 val, count;
 
@@ -196,43 +275,43 @@ isac_rme_irq(struct isac_hw *isac)
 		count = ReadISAC(isac, ISAC_RBCL) & 0x1f;
 		if (count == 0)
 			count = 32;
-		isac_empty_fifo(isac, count);
+		isac_empty_fifo(isac, count, am);
 		recv_Dchannel(&isac->dch);
 	}
 }
 
-static void
-isac_xpr_irq(struct isac_hw *isac)
+static __always_inline void
+isac_xpr_irq(struct isac_hw *isac, const u32 am)
 {
 	if (test_and_clear_bit(FLG_BUSY_TIMER, &isac->dch.Flags))
 		del_timer(&isac->dch.timer);
 	if (isac->dch.tx_skb && isac->dch.tx_idx < isac->dch.tx_skb->len) {
-		isac_fill_fifo(isac);
+		isac_fill_fifo(isac, am);
 	} else {
 		dev_kfree_skb(isac->dch.tx_skb);
 		if (get_next_dframe(&isac->dch))
-			isac_fill_fifo(isac);
+			isac_fill_fifo(isac, am);
 	}
 }
 
-static void
-isac_retransmit(struct isac_hw *isac)
+static __always_inline void
+isac_retransmit(struct isac_hw *isac, const u32 am)
 {
 	if (test_and_clear_bit(FLG_BUSY_TIMER, &isac->dch.Flags))
 		del_timer(&isac->dch.timer);
 	if (test_bit(FLG_TX_BUSY, &isac->dch.Flags)) {
 		/* Restart frame */
 		isac->dch.tx_idx = 0;
-		isac_fill_fifo(isac);
+		isac_fill_fifo(isac, am);
 	} else if (isac->dch.tx_skb) { /* should not happen */
 		pr_info("%s: tx_skb exist but not busy\n", isac->name);
 		test_and_set_bit(FLG_TX_BUSY, &isac->dch.Flags);
 		isac->dch.tx_idx = 0;
-		isac_fill_fifo(isac);
+		isac_fill_fifo(isac, am);
 	} else {
 		pr_info("%s: ISAC XDU no TX_BUSY\n", isac->name);
 		if (get_next_dframe(&isac->dch))
-			isac_fill_fifo(isac);
+			isac_fill_fifo(isac, am);
 	}
 }
 
@@ -241,6 +320,7 @@ isac_mos_irq(struct isac_hw *isac)
 {
 	u8 val;
 	int ret;
+	const u32 am = isac->io.mode;
 
 	val = ReadISAC(isac, ISAC_MOSR);
 	pr_debug("%s: ISAC MOSR %02x\n", isac->name, val);
@@ -412,6 +492,7 @@ AfterMOX1:
 static void
 isac_cisq_irq(struct isac_hw *isac) {
 	u8 val;
+	const u32 am = isac->io.mode;
 
 	val = ReadISAC(isac, ISAC_CIR0);
 	pr_debug("%s: ISAC CIR0 %02X\n", isac->name, val);
@@ -431,6 +512,7 @@ static void
 isacsx_cic_irq(struct isac_hw *isac)
 {
 	u8 val;
+	const u32 am = isac->io.mode;
 
 	val = ReadISAC(isac, ISACX_CIR0);
 	pr_debug("%s: ISACX CIR0 %02X\n", isac->name, val);
@@ -442,8 +524,8 @@ isacsx_cic_irq(struct isac_hw *isac)
 	}
 }
 
-static void
-isacsx_rme_irq(struct isac_hw *isac)
+static __always_inline void
+isacsx_rme_irq(struct isac_hw *isac, const u32 am)
 {
 	int count;
 	u8 val;
@@ -468,7 +550,7 @@ isacsx_rme_irq(struct isac_hw *isac)
 		count = ReadISAC(isac, ISACX_RBCLD) & 0x1f;
 		if (count == 0)
 			count = 32;
-		isac_empty_fifo(isac, count);
+		isac_empty_fifo(isac, count, am);
 		if (isac->dch.rx_skb) {
 			skb_trim(isac->dch.rx_skb, isac->dch.rx_skb->len - 1);
 			pr_debug("%s: dchannel received %d\n", isac->name,
@@ -478,8 +560,8 @@ isacsx_rme_irq(struct isac_hw *isac)
 	}
 }
 
-irqreturn_t
-mISDNisac_irq(struct isac_hw *isac, u8 val)
+static __always_inline irqreturn_t
+__mISDNisac_irq(struct isac_hw *isac, u8 val, const u32 am)
 {
 	if (unlikely(!val))
 		return IRQ_NONE;
@@ -495,33 +577,33 @@ mISDNisac_irq(struct isac_hw *isac, u8 val)
 #ifdef ERROR_STATISTIC
 				isac->dch.err_tx++;
 #endif
-				isac_retransmit(isac);
+				isac_retransmit(isac, am);
 			}
 			if (val & ISACX_D_XMR) {
 				pr_debug("%s: ISAC XMR\n", isac->name);
 #ifdef ERROR_STATISTIC
 				isac->dch.err_tx++;
 #endif
-				isac_retransmit(isac);
+				isac_retransmit(isac, am);
 			}
 			if (val & ISACX_D_XPR)
-				isac_xpr_irq(isac);
+				isac_xpr_irq(isac, am);
 			if (val & ISACX_D_RFO) {
 				pr_debug("%s: ISAC RFO\n", isac->name);
 				WriteISAC(isac, ISACX_CMDRD, ISACX_CMDRD_RMC);
 			}
 			if (val & ISACX_D_RME)
-				isacsx_rme_irq(isac);
+				isacsx_rme_irq(isac, am);
 			if (val & ISACX_D_RPF)
-				isac_empty_fifo(isac, 0x20);
+				isac_empty_fifo(isac, 0x20, am);
 		}
 	} else {
 		if (val & 0x80)	/* RME */
-			isac_rme_irq(isac);
+			isac_rme_irq(isac, am);
 		if (val & 0x40)	/* RPF */
-			isac_empty_fifo(isac, 32);
+			isac_empty_fifo(isac, 32, am);
 		if (val & 0x10)	/* XPR */
-			isac_xpr_irq(isac);
+			isac_xpr_irq(isac, am);
 		if (val & 0x04)	/* CISQ */
 			isac_cisq_irq(isac);
 		if (val & 0x20)	/* RSC - never */
@@ -538,7 +620,7 @@ mISDNisac_irq(struct isac_hw *isac, u8 val)
 #ifdef ERROR_STATISTIC
 				isac->dch.err_tx++;
 #endif
-				isac_retransmit(isac);
+				isac_retransmit(isac, am);
 			}
 			if (val & 0x04)	/* MOS */
 				isac_mos_irq(isac);
@@ -546,6 +628,21 @@ mISDNisac_irq(struct isac_hw *isac, u8 val)
 	}
 	return IRQ_HANDLED;
 }
+
+irqreturn_t
+mISDNisac_irq(struct isac_hw *isac, u8 val)
+{
+	switch (isac->io.mode) {
+	case IOHELPER_IO:
+		return __mISDNisac_irq(isac, val, IOHELPER_IO);
+	case IOHELPER_IND:
+		return __mISDNisac_irq(isac, val, IOHELPER_IND);
+	case IOHELPER_MEMIO:
+		return __mISDNisac_irq(isac, val, IOHELPER_MEMIO);
+	default:
+		return __mISDNisac_irq(isac, val, IOHELPER_NONE);
+	}
+}
 EXPORT_SYMBOL(mISDNisac_irq);
 
 static int
@@ -558,6 +655,7 @@ isac_l1hw(struct mISDNchannel *ch, struct sk_buff *skb)
 	struct mISDNhead	*hh = mISDN_HEAD_P(skb);
 	u32			id;
 	u_long			flags;
+	const u32		am = isac->io.mode;
 
 	switch (hh->prim) {
 	case PH_DATA_REQ:
@@ -565,7 +663,7 @@ isac_l1hw(struct mISDNchannel *ch, struct sk_buff *skb)
 		ret = dchannel_senddata(dch, skb);
 		if (ret > 0) { /* direct TX */
 			id = hh->id; /* skb can be freed */
-			isac_fill_fifo(isac);
+			isac_fill_fifo(isac, am);
 			ret = 0;
 			spin_unlock_irqrestore(isac->hwlock, flags);
 			queue_ch_frame(ch, PH_DATA_CNF, id, NULL);
@@ -592,6 +690,7 @@ isac_ctrl(struct isac_hw *isac, u32 cmd, unsigned long para)
 	u8 tl = 0;
 	unsigned long flags;
 	int ret = 0;
+	const u32 am = isac->io.mode;
 
 	switch (cmd) {
 	case HW_TESTLOOP:
@@ -692,6 +791,8 @@ isac_l1cmd(struct dchannel *dch, u32 cmd)
 static void
 isac_release(struct isac_hw *isac)
 {
+	const u32 am = isac->io.mode;
+
 	if (isac->type & IPAC_TYPE_ISACX)
 		WriteISAC(isac, ISACX_MASK, 0xff);
 	else
@@ -715,6 +816,7 @@ dbusy_timer_handler(struct timer_list *t)
 	struct isac_hw *isac = from_timer(isac, t, dch.timer);
 	int rbch, star;
 	u_long flags;
+	const u32 am = isac->io.mode;
 
 	if (test_bit(FLG_BUSY_TIMER, &isac->dch.Flags)) {
 		spin_lock_irqsave(isac->hwlock, flags);
@@ -772,6 +874,7 @@ isac_init(struct isac_hw *isac)
 {
 	u8 val;
 	int err = 0;
+	const u32 am = isac->io.mode;
 
 	if (!isac->dch.l1) {
 		err = create_l1(&isac->dch, isac_l1cmd);
@@ -869,8 +972,8 @@ mISDNisac_init(struct isac_hw *isac, void *hw)
 }
 EXPORT_SYMBOL(mISDNisac_init);
 
-static void
-waitforCEC(struct hscx_hw *hx)
+static __always_inline void
+waitforCEC(struct hscx_hw *hx, const u32 am)
 {
 	u8 starb, to = 50;
 
@@ -889,8 +992,8 @@ waitforCEC(struct hscx_hw *hx)
 }
 
 
-static void
-waitforXFW(struct hscx_hw *hx)
+static __always_inline void
+waitforXFW(struct hscx_hw *hx, const u32 am)
 {
 	u8 starb, to = 50;
 
@@ -908,19 +1011,19 @@ waitforXFW(struct hscx_hw *hx)
 		pr_info("%s: B%1d XFW timeout\n", hx->ip->name, hx->bch.nr);
 }
 
-static void
-hscx_cmdr(struct hscx_hw *hx, u8 cmd)
+static __always_inline void
+hscx_cmdr(struct hscx_hw *hx, u8 cmd, const u32 am)
 {
 	if (hx->ip->type & IPAC_TYPE_IPACX)
 		WriteHSCX(hx, IPACX_CMDRB, cmd);
 	else {
-		waitforCEC(hx);
+		waitforCEC(hx, am);
 		WriteHSCX(hx, IPAC_CMDRB, cmd);
 	}
 }
 
-static void
-hscx_empty_fifo(struct hscx_hw *hscx, u8 count)
+static __always_inline void
+hscx_empty_fifo(struct hscx_hw *hscx, u8 count, const u32 am)
 {
 	u8 *p;
 	int maxlen;
@@ -928,12 +1031,12 @@ hscx_empty_fifo(struct hscx_hw *hscx, u8 count)
 	pr_debug("%s: B%1d %d\n", hscx->ip->name, hscx->bch.nr, count);
 	if (test_bit(FLG_RX_OFF, &hscx->bch.Flags)) {
 		hscx->bch.dropcnt += count;
-		hscx_cmdr(hscx, 0x80); /* RMC */
+		hscx_cmdr(hscx, 0x80, am); /* RMC */
 		return;
 	}
 	maxlen = bchannel_get_rxbuf(&hscx->bch, count);
 	if (maxlen < 0) {
-		hscx_cmdr(hscx, 0x80); /* RMC */
+		hscx_cmdr(hscx, 0x80, am); /* RMC */
 		if (hscx->bch.rx_skb)
 			skb_trim(hscx->bch.rx_skb, 0);
 		pr_warn("%s.B%d: No bufferspace for %d bytes\n",
@@ -943,13 +1046,11 @@ hscx_empty_fifo(struct hscx_hw *hscx, u8 count)
 	p = skb_put(hscx->bch.rx_skb, count);
 
 	if (hscx->ip->type & IPAC_TYPE_IPACX)
-		hscx->ip->read_fifo(hscx->ip->hw,
-				    hscx->off + IPACX_RFIFOB, p, count);
+		ipac_rd_fifo(hscx->ip, am, hscx->off + IPACX_RFIFOB, p, count);
 	else
-		hscx->ip->read_fifo(hscx->ip->hw,
-				    hscx->off, p, count);
+		ipac_rd_fifo(hscx->ip, am, hscx->off, p, count);
 
-	hscx_cmdr(hscx, 0x80); /* RMC */
+	hscx_cmdr(hscx, 0x80, am); /* RMC */
 
 	if (hscx->bch.debug & DEBUG_HW_BFIFO) {
 		snprintf(hscx->log, 64, "B%1d-recv %s %d ",
@@ -958,8 +1059,8 @@ hscx_empty_fifo(struct hscx_hw *hscx, u8 count)
 	}
 }
 
-static void
-hscx_fill_fifo(struct hscx_hw *hscx)
+static __always_inline void
+hscx_fill_fifo(struct hscx_hw *hscx, const u32 am)
 {
 	int count, more;
 	u8 *p;
@@ -987,14 +1088,12 @@ hscx_fill_fifo(struct hscx_hw *hscx)
 		hscx->bch.tx_idx += count;
 	}
 	if (hscx->ip->type & IPAC_TYPE_IPACX)
-		hscx->ip->write_fifo(hscx->ip->hw,
-				     hscx->off + IPACX_XFIFOB, p, count);
+		ipac_wr_fifo(hscx->ip, am, hscx->off + IPACX_XFIFOB, p, count);
 	else {
-		waitforXFW(hscx);
-		hscx->ip->write_fifo(hscx->ip->hw,
-				     hscx->off, p, count);
+		waitforXFW(hscx, am);
+		ipac_wr_fifo(hscx->ip, am, hscx->off, p, count);
 	}
-	hscx_cmdr(hscx, more ? 0x08 : 0x0a);
+	hscx_cmdr(hscx, more ? 0x08 : 0x0a, am);
 
 	if (hscx->bch.tx_skb && (hscx->bch.debug & DEBUG_HW_BFIFO)) {
 		snprintf(hscx->log, 64, "B%1d-send %s %d ",
@@ -1003,24 +1102,24 @@ hscx_fill_fifo(struct hscx_hw *hscx)
 	}
 }
 
-static void
-hscx_xpr(struct hscx_hw *hx)
+static __always_inline void
+hscx_xpr(struct hscx_hw *hx, const u32 am)
 {
 	if (hx->bch.tx_skb && hx->bch.tx_idx < hx->bch.tx_skb->len) {
-		hscx_fill_fifo(hx);
+		hscx_fill_fifo(hx, am);
 	} else {
 		dev_kfree_skb(hx->bch.tx_skb);
 		if (get_next_bframe(&hx->bch)) {
-			hscx_fill_fifo(hx);
+			hscx_fill_fifo(hx, am);
 			test_and_clear_bit(FLG_TX_EMPTY, &hx->bch.Flags);
 		} else if (test_bit(FLG_TX_EMPTY, &hx->bch.Flags)) {
-			hscx_fill_fifo(hx);
+			hscx_fill_fifo(hx, am);
 		}
 	}
 }
 
-static void
-ipac_rme(struct hscx_hw *hx)
+static __always_inline void
+ipac_rme(struct hscx_hw *hx, const u32 am)
 {
 	int count;
 	u8 rstab;
@@ -1036,19 +1135,22 @@ ipac_rme(struct hscx_hw *hx)
 			if (hx->bch.debug & DEBUG_HW_BCHANNEL)
 				pr_notice("%s: B%1d invalid frame\n",
 					  hx->ip->name, hx->bch.nr);
+			bch_stats_inc(&hx->bch, frame_err);
 		}
 		if (rstab & 0x40) {
 			if (hx->bch.debug & DEBUG_HW_BCHANNEL)
 				pr_notice("%s: B%1d RDO proto=%x\n",
 					  hx->ip->name, hx->bch.nr,
 					  hx->bch.state);
+			bch_stats_inc(&hx->bch, rx_overrun);
 		}
 		if (!(rstab & 0x20)) {
 			if (hx->bch.debug & DEBUG_HW_BCHANNEL)
 				pr_notice("%s: B%1d CRC error\n",
 					  hx->ip->name, hx->bch.nr);
+			bch_stats_inc(&hx->bch, crc_err);
 		}
-		hscx_cmdr(hx, 0x80); /* Do RMC */
+		hscx_cmdr(hx, 0x80, am); /* Do RMC */
 		return;
 	}
 	if (hx->ip->type & IPAC_TYPE_IPACX)
@@ -1058,7 +1160,7 @@ ipac_rme(struct hscx_hw *hx)
 	count &= (hx->fifo_size - 1);
 	if (count == 0)
 		count = hx->fifo_size;
-	hscx_empty_fifo(hx, count);
+	hscx_empty_fifo(hx, count, am);
 	if (!hx->bch.rx_skb)
 		return;
 	if (hx->bch.rx_skb->len < 2) {
@@ -1071,8 +1173,8 @@ ipac_rme(struct hscx_hw *hx)
 	}
 }
 
-static void
-ipac_irq(struct hscx_hw *hx, u8 ista)
+static __always_inline void
+ipac_irq(struct hscx_hw *hx, u8 ista, const u32 am)
 {
 	u8 istab, m, exirb = 0;
 
@@ -1086,9 +1188,7 @@ ipac_irq(struct hscx_hw *hx, u8 ista)
 			pr_debug("%s: B%1d EXIRB %02x\n", hx->ip->name,
 				 hx->bch.nr, exirb);
 		}
-	} else if (hx->bch.nr & 2) { /* HSCX B */
-		if (ista & (HSCX__EXA | HSCX__ICA))
-			ipac_irq(&hx->ip->hscx[0], ista);
+	} else if (hx->bch.nr & 2) { /* HSCX B, HSCX A done by caller */
 		if (ista & HSCX__EXB) {
 			exirb = ReadHSCX(hx, IPAC_EXIRB);
 			pr_debug("%s: B%1d EXIRB %02x\n", hx->ip->name,
@@ -1114,38 +1214,38 @@ ipac_irq(struct hscx_hw *hx, u8 ista)
 		return;
 
 	if (istab & IPACX_B_RME)
-		ipac_rme(hx);
+		ipac_rme(hx, am);
 
 	if (istab & IPACX_B_RPF) {
-		hscx_empty_fifo(hx, hx->fifo_size);
+		hscx_empty_fifo(hx, hx->fifo_size, am);
 		if (test_bit(FLG_TRANSPARENT, &hx->bch.Flags))
 			recv_Bchannel(&hx->bch, 0, false);
 	}
 
 	if (istab & IPACX_B_RFO) {
 		pr_debug("%s: B%1d RFO error\n", hx->ip->name, hx->bch.nr);
-		hscx_cmdr(hx, 0x40);	/* RRES */
+		hscx_cmdr(hx, 0x40, am);	/* RRES */
 	}
 
 	if (istab & IPACX_B_XPR)
-		hscx_xpr(hx);
+		hscx_xpr(hx, am);
 
 	if (istab & IPACX_B_XDU) {
 		if (test_bit(FLG_TRANSPARENT, &hx->bch.Flags)) {
 			if (test_bit(FLG_FILLEMPTY, &hx->bch.Flags))
 				test_and_set_bit(FLG_TX_EMPTY, &hx->bch.Flags);
-			hscx_xpr(hx);
+			hscx_xpr(hx, am);
 			return;
 		}
 		pr_debug("%s: B%1d XDU error at len %d\n", hx->ip->name,
 			 hx->bch.nr, hx->bch.tx_idx);
 		hx->bch.tx_idx = 0;
-		hscx_cmdr(hx, 0x01);	/* XRES */
+		hscx_cmdr(hx, 0x01, am);	/* XRES */
 	}
 }
 
-irqreturn_t
-mISDNipac_irq(struct ipac_hw *ipac, int maxloop)
+static __always_inline irqreturn_t
+__mISDNipac_irq(struct ipac_hw *ipac, int maxloop, const u32 am)
 {
 	int cnt = maxloop + 1;
 	u8 ista, istad;
@@ -1156,11 +1256,11 @@ mISDNipac_irq(struct ipac_hw *ipac, int maxloop)
 		while (ista && --cnt) {
 			pr_debug("%s: ISTA %02x\n", ipac->name, ista);
 			if (ista & IPACX__ICA)
-				ipac_irq(&ipac->hscx[0], ista);
+				ipac_irq(&ipac->hscx[0], ista, am);
 			if (ista & IPACX__ICB)
-				ipac_irq(&ipac->hscx[1], ista);
+				ipac_irq(&ipac->hscx[1], ista, am);
 			if (ista & (ISACX__ICD | ISACX__CIC))
-				mISDNisac_irq(&ipac->isac, ista);
+				__mISDNisac_irq(&ipac->isac, ista, am);
 			ista = ReadIPAC(ipac, ISACX_ISTA);
 		}
 	} else if (ipac->type & IPAC_TYPE_IPAC) {
@@ -1174,24 +1274,26 @@ mISDNipac_irq(struct ipac_hw *ipac, int maxloop)
 					pr_debug("%s TIN2 irq\n", ipac->name);
 				if (ista & IPAC__EXD)
 					istad |= 1; /* ISAC EXI */
-				mISDNisac_irq(isac, istad);
+				__mISDNisac_irq(isac, istad, am);
 			}
 			if (ista & (IPAC__ICA | IPAC__EXA))
-				ipac_irq(&ipac->hscx[0], ista);
+				ipac_irq(&ipac->hscx[0], ista, am);
 			if (ista & (IPAC__ICB | IPAC__EXB))
-				ipac_irq(&ipac->hscx[1], ista);
+				ipac_irq(&ipac->hscx[1], ista, am);
 			ista = ReadIPAC(ipac, IPAC_ISTA);
 		}
 	} else if (ipac->type & IPAC_TYPE_HSCX) {
 		while (--cnt) {
 			ista = ReadIPAC(ipac, IPAC_ISTAB + ipac->hscx[1].off);
 			pr_debug("%s: B2 ISTA %02x\n", ipac->name, ista);
+			if (ista & (HSCX__EXA | HSCX__ICA))
+				ipac_irq(&ipac->hscx[0], ista, am);
 			if (ista)
-				ipac_irq(&ipac->hscx[1], ista);
+				ipac_irq(&ipac->hscx[1], ista, am);
 			istad = ReadISAC(isac, ISAC_ISTA);
 			pr_debug("%s: ISTAD %02x\n", ipac->name, istad);
 			if (istad)
-				mISDNisac_irq(isac, istad);
+				__mISDNisac_irq(isac, istad, am);
 			if (0 == (ista | istad))
 				break;
 		}
@@ -1206,11 +1308,29 @@ mISDNipac_irq(struct ipac_hw *ipac, int maxloop)
 			  maxloop, smp_processor_id());
 	return IRQ_HANDLED;
 }
+
+/* ISAC and HSCX part always share the access method */
+irqreturn_t
+mISDNipac_irq(struct ipac_hw *ipac, int maxloop)
+{
+	switch (ipac->io.mode) {
+	case IOHELPER_IO:
+		return __mISDNipac_irq(ipac, maxloop, IOHELPER_IO);
+	case IOHELPER_IND:
+		return __mISDNipac_irq(ipac, maxloop, IOHELPER_IND);
+	case IOHELPER_MEMIO:
+		return __mISDNipac_irq(ipac, maxloop, IOHELPER_MEMIO);
+	default:
+		return __mISDNipac_irq(ipac, maxloop, IOHELPER_NONE);
+	}
+}
 EXPORT_SYMBOL(mISDNipac_irq);
 
 static int
 hscx_mode(struct hscx_hw *hscx, u32 bprotocol)
 {
+	const u32 am = hscx->ip->io.mode;
+
 	pr_debug("%s: HSCX %c protocol %x-->%x ch %d\n", hscx->ip->name,
 		 '@' + hscx->bch.nr, hscx->bch.state, bprotocol, hscx->bch.nr);
 	if (hscx->ip->type & IPAC_TYPE_IPACX) {
@@ -1226,21 +1346,21 @@ hscx_mode(struct hscx_hw *hscx, u32 bprotocol)
 			WriteHSCX(hscx, IPACX_MODEB, 0xC0);	/* rec off */
 			WriteHSCX(hscx, IPACX_EXMB,  0x30);	/* std adj. */
 			WriteHSCX(hscx, IPACX_MASKB, 0xFF);	/* ints off */
-			hscx_cmdr(hscx, 0x41);
+			hscx_cmdr(hscx, 0x41, am);
 			test_and_clear_bit(FLG_HDLC, &hscx->bch.Flags);
 			test_and_clear_bit(FLG_TRANSPARENT, &hscx->bch.Flags);
 			break;
 		case ISDN_P_B_RAW:
 			WriteHSCX(hscx, IPACX_MODEB, 0x88);	/* ex trans */
 			WriteHSCX(hscx, IPACX_EXMB,  0x00);	/* trans */
-			hscx_cmdr(hscx, 0x41);
+			hscx_cmdr(hscx, 0x41, am);
 			WriteHSCX(hscx, IPACX_MASKB, IPACX_B_ON);
 			test_and_set_bit(FLG_TRANSPARENT, &hscx->bch.Flags);
 			break;
 		case ISDN_P_B_HDLC:
 			WriteHSCX(hscx, IPACX_MODEB, 0xC0);	/* trans */
 			WriteHSCX(hscx, IPACX_EXMB,  0x00);	/* hdlc,crc */
-			hscx_cmdr(hscx, 0x41);
+			hscx_cmdr(hscx, 0x41, am);
 			WriteHSCX(hscx, IPACX_MASKB, IPACX_B_ON);
 			test_and_set_bit(FLG_HDLC, &hscx->bch.Flags);
 			break;
@@ -1269,14 +1389,14 @@ hscx_mode(struct hscx_hw *hscx, u32 bprotocol)
 		case ISDN_P_B_RAW:
 			WriteHSCX(hscx, IPAC_MODEB, 0xe4);	/* ex trans */
 			WriteHSCX(hscx, IPAC_CCR1, 0x82);
-			hscx_cmdr(hscx, 0x41);
+			hscx_cmdr(hscx, 0x41, am);
 			WriteHSCX(hscx, IPAC_MASKB, 0);
 			test_and_set_bit(FLG_TRANSPARENT, &hscx->bch.Flags);
 			break;
 		case ISDN_P_B_HDLC:
 			WriteHSCX(hscx, IPAC_MODEB, 0x8c);
 			WriteHSCX(hscx, IPAC_CCR1, 0x8a);
-			hscx_cmdr(hscx, 0x41);
+			hscx_cmdr(hscx, 0x41, am);
 			WriteHSCX(hscx, IPAC_MASKB, 0);
 			test_and_set_bit(FLG_HDLC, &hscx->bch.Flags);
 			break;
@@ -1305,14 +1425,14 @@ hscx_mode(struct hscx_hw *hscx, u32 bprotocol)
 		case ISDN_P_B_RAW:
 			WriteHSCX(hscx, IPAC_MODEB, 0xe4);	/* ex trans */
 			WriteHSCX(hscx, IPAC_CCR1, 0x85);
-			hscx_cmdr(hscx, 0x41);
+			hscx_cmdr(hscx, 0x41, am);
 			WriteHSCX(hscx, IPAC_MASKB, 0);
 			test_and_set_bit(FLG_TRANSPARENT, &hscx->bch.Flags);
 			break;
 		case ISDN_P_B_HDLC:
 			WriteHSCX(hscx, IPAC_MODEB, 0x8c);
 			WriteHSCX(hscx, IPAC_CCR1, 0x8d);
-			hscx_cmdr(hscx, 0x41);
+			hscx_cmdr(hscx, 0x41, am);
 			WriteHSCX(hscx, IPAC_MASKB, 0);
 			test_and_set_bit(FLG_HDLC, &hscx->bch.Flags);
 			break;
@@ -1335,6 +1455,7 @@ hscx_l2l1(struct mISDNchannel *ch, struct sk_buff *skb)
 	int ret = -EINVAL;
 	struct mISDNhead *hh = mISDN_HEAD_P(skb);
 	unsigned long flags;
+	const u32 am = hx->ip->io.mode;
 
 	switch (hh->prim) {
 	case PH_DATA_REQ:
@@ -1342,7 +1463,7 @@ hscx_l2l1(struct mISDNchannel *ch, struct sk_buff *skb)
 		ret = bchannel_senddata(bch, skb);
 		if (ret > 0) { /* direct TX */
 			ret = 0;
-			hscx_fill_fifo(hx);
+			hscx_fill_fifo(hx, am);
 		}
 		spin_unlock_irqrestore(hx->ip->hwlock, flags);
 		return ret;
@@ -1430,6 +1551,7 @@ static void
 hscx_init(struct hscx_hw *hx)
 {
 	u8 val;
+	const u32 am = hx->ip->io.mode;
 
 	WriteHSCX(hx, IPAC_RAH2, 0xFF);
 	WriteHSCX(hx, IPAC_XBCH, 0x00);
@@ -1453,6 +1575,7 @@ static int
 ipac_init(struct ipac_hw *ipac)
 {
 	u8 val;
+	const u32 am = ipac->io.mode;
 
 	if (ipac->type & IPAC_TYPE_HSCX) {
 		hscx_init(&ipac->hscx[0]);
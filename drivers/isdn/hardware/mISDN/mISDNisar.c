@@ -450,12 +450,10 @@ isar_rcv_frame(struct isar_ch *ch)
 		if (ch->is->cmsb & HDLC_ERROR) {
 			pr_debug("%s: ISAR frame error %x len %d\n",
 				 ch->is->name, ch->is->cmsb, ch->is->clsb);
-#ifdef ERROR_STATISTIC
 			if (ch->is->cmsb & HDLC_ERR_RER)
-				ch->bch.err_inv++;
+				bch_stats_inc(&ch->bch, frame_err);
 			if (ch->is->cmsb & HDLC_ERR_CER)
-				ch->bch.err_crc++;
-#endif
+				bch_stats_inc(&ch->bch, crc_err);
 			skb_trim(ch->bch.rx_skb, 0);
 			ch->is->write_reg(ch->is->hw, ISAR_IIA, 0);
 			break;
@@ -1056,15 +1054,13 @@ mISDNisar_irq(struct isar_hw *isar)
 		check_send(isar, isar->cmsb);
 		break;
 	case ISAR_IIS_BSTEV:
-#ifdef ERROR_STATISTIC
 		ch = sel_bch_isar(isar, isar->iis >> 6);
 		if (ch) {
 			if (isar->cmsb == BSTEV_TBO)
-				ch->bch.err_tx++;
+				bch_stats_inc(&ch->bch, tx_underrun);
 			if (isar->cmsb == BSTEV_RBO)
-				ch->bch.err_rdo++;
+				bch_stats_inc(&ch->bch, rx_overrun);
 		}
-#endif
 		pr_debug("%s: Buffer STEV dpath%d msb(%x)\n",
 			 isar->name, isar->iis >> 6, isar->cmsb);
 		isar->write_reg(isar->hw, ISAR_IIA, 0);
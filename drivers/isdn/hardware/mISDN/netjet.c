@@ -425,14 +425,21 @@ read_dma(struct tiger_ch *bc, u32 idx, int cnt)
 				return;
 			}
 		} else if (stat == -HDLC_CRC_ERROR) {
-			pr_info("%s: B%1d receive frame CRC error\n",
-				card->name, bc->bch.nr);
+			if (debug & DEBUG_HW_BFIFO)
+				pr_debug("%s: B%1d receive frame CRC error\n",
+					 card->name, bc->bch.nr);
+			bch_stats_inc(&bc->bch, crc_err);
 		} else if (stat == -HDLC_FRAMING_ERROR) {
-			pr_info("%s: B%1d receive framing error\n",
-				card->name, bc->bch.nr);
+			if (debug & DEBUG_HW_BFIFO)
+				pr_debug("%s: B%1d receive framing error\n",
+					 card->name, bc->bch.nr);
+			bch_stats_inc(&bc->bch, frame_err);
 		} else if (stat == -HDLC_LENGTH_ERROR) {
-			pr_info("%s: B%1d receive frame too long (> %d)\n",
-				card->name, bc->bch.nr, bc->bch.maxlen);
+			if (debug & DEBUG_HW_BFIFO)
+				pr_debug("%s: B%1d receive frame too long "
+					 "(> %d)\n", card->name, bc->bch.nr,
+					 bc->bch.maxlen);
+			bch_stats_inc(&bc->bch, frame_err);
 		}
 		pn += i;
 		cnt -= i;
@@ -629,8 +636,10 @@ send_tiger_bc(struct tiger_hw *card, struct tiger_ch *bc)
 	bc->free += card->send.size / 2;
 	if (bc->free >= card->send.size) {
 		if (!(bc->txstate & (TX_UNDERRUN | TX_INIT))) {
-			pr_info("%s: B%1d TX underrun state %x\n", card->name,
-				bc->bch.nr, bc->txstate);
+			if (debug & DEBUG_HW_BFIFO)
+				pr_debug("%s: B%1d TX underrun state %x\n",
+					 card->name, bc->bch.nr, bc->txstate);
+			bch_stats_inc(&bc->bch, tx_underrun);
 			bc->txstate |= TX_UNDERRUN;
 		}
 		bc->free = card->send.size;
@@ -660,24 +660,18 @@ W6692B_interrupt(struct w6692_hw *card, int ch)
 			    test_bit(FLG_ACTIVE, &wch->bch.Flags)) {
 				pr_debug("%s: B%d RDOV proto=%x\n", card->name,
 					 wch->bch.nr, wch->bch.state);
-#ifdef ERROR_STATISTIC
-				wch->bch.err_rdo++;
-#endif
+				bch_stats_inc(&wch->bch, rx_overrun);
 			}
 			if (test_bit(FLG_HDLC, &wch->bch.Flags)) {
 				if (star & W_B_STAR_CRCE) {
 					pr_debug("%s: B%d CRC error\n",
 						 card->name, wch->bch.nr);
-#ifdef ERROR_STATISTIC
-					wch->bch.err_crc++;
-#endif
+					bch_stats_inc(&wch->bch, crc_err);
 				}
 				if (star & W_B_STAR_RMB) {
 					pr_debug("%s: B%d message abort\n",
 						 card->name, wch->bch.nr);
-#ifdef ERROR_STATISTIC
-					wch->bch.err_inv++;
-#endif
+					bch_stats_inc(&wch->bch, frame_err);
 				}
 			}
 			WriteW6692B(wch, W_B_CMDR, W_B_CMDR_RACK |
@@ -699,9 +693,7 @@ W6692B_interrupt(struct w6692_hw *card, int ch)
 		if (star & W_B_STAR_RDOV) {
 			pr_debug("%s: B%d RDOV proto=%x\n", card->name,
 				 wch->bch.nr, wch->bch.state);
-#ifdef ERROR_STATISTIC
-			wch->bch.err_rdo++;
-#endif
+			bch_stats_inc(&wch->bch, rx_overrun);
 			WriteW6692B(wch, W_B_CMDR, W_B_CMDR_RACK |
 				    W_B_CMDR_RRST | W_B_CMDR_RACT);
 		} else {
@@ -715,9 +707,7 @@ W6692B_interrupt(struct w6692_hw *card, int ch)
 		if (!(star & W_B_STAR_RDOV)) {
 			pr_debug("%s: B%d RDOV IRQ proto=%x\n", card->name,
 				 wch->bch.nr, wch->bch.state);
-#ifdef ERROR_STATISTIC
-			wch->bch.err_rdo++;
-#endif
+			bch_stats_inc(&wch->bch, rx_overrun);
 			WriteW6692B(wch, W_B_CMDR, W_B_CMDR_RACK |
 				    W_B_CMDR_RRST | W_B_CMDR_RACT);
 		}
@@ -729,11 +719,10 @@ W6692B_interrupt(struct w6692_hw *card, int ch)
 				 wch->bch.nr, star);
 		}
 		if (star & W_B_STAR_XDOW) {
-			pr_warn("%s: B%d XDOW proto=%x\n", card->name,
-				wch->bch.nr, wch->bch.state);
-#ifdef ERROR_STATISTIC
-			wch->bch.err_xdu++;
-#endif
+			if (debug & DEBUG_HW_BFIFO)
+				pr_warn("%s: B%d XDOW proto=%x\n", card->name,
+					wch->bch.nr, wch->bch.state);
+			bch_stats_inc(&wch->bch, tx_underrun);
 			WriteW6692B(wch, W_B_CMDR, W_B_CMDR_XRST |
 				    W_B_CMDR_RACT);
 			/* resend */
@@ -747,11 +736,10 @@ W6692B_interrupt(struct w6692_hw *card, int ch)
 			return; /* handle XDOW only once */
 	}
 	if (stat & W_B_EXI_XDUN) {
-		pr_warn("%s: B%d XDUN proto=%x\n", card->name,
-			wch->bch.nr, wch->bch.state);
-#ifdef ERROR_STATISTIC
-		wch->bch.err_xdu++;
-#endif
+		if (debug & DEBUG_HW_BFIFO)
+			pr_warn("%s: B%d XDUN proto=%x\n", card->name,
+				wch->bch.nr, wch->bch.state);
+		bch_stats_inc(&wch->bch, tx_underrun);
 		/* resend - no XRST needed */
 		if (wch->bch.tx_skb) {
 			if (!test_bit(FLG_TRANSPARENT, &wch->bch.Flags))
@@ -8,6 +8,8 @@
 #include <linux/stddef.h>
 #include <linux/module.h>
 #include <linux/spinlock.h>
+#include <linux/rcupdate.h>
+#include <linux/mutex.h>
 #include <linux/mISDNif.h>
 #include "core.h"
 
@@ -18,7 +20,12 @@ MODULE_LICENSE("GPL");
 module_param(debug, uint, S_IRUGO | S_IWUSR);
 
 static u64		device_ids;
-#define MAX_DEVICE_ID	63
+#define MAX_DEVICE_ID	(MISDN_MAX_DEVICES - 1)
+
+/* id indexed view of the registered devices, readers use RCU */
+static struct mISDNdevice __rcu	*device_table[MISDN_MAX_DEVICES];
+/* held by writers and by readers which sleep while using the device */
+static DEFINE_MUTEX(device_table_mutex);
 
 static LIST_HEAD(Bprotocols);
 static DEFINE_RWLOCK(bp_lock);
@@ -166,38 +173,78 @@ static struct class mISDN_class = {
 	.class_release = mISDN_class_release,
 };
 
-static int
-_get_mdevice(struct device *dev, const void *id)
+/*
+ * The device returned is only valid while the caller holds rcu_read_lock()
+ * or mISDN_devtable_lock(), unregister waits for both before the driver
+ * may free it.
+ */
+struct mISDNdevice
+*get_mdevice(u_int id)
 {
-	struct mISDNdevice *mdev = dev_to_mISDN(dev);
-
-	if (!mdev)
-		return 0;
-	if (mdev->id != *(const u_int *)id)
-		return 0;
-	return 1;
+	if (id > MAX_DEVICE_ID)
+		return NULL;
+	return rcu_dereference_check(device_table[id],
+				     lockdep_is_held(&device_table_mutex));
 }
 
-struct mISDNdevice
-*get_mdevice(u_int id)
+void
+mISDN_devtable_lock(void)
 {
-	return dev_to_mISDN(class_find_device(&mISDN_class, NULL, &id,
-					      _get_mdevice));
+	mutex_lock(&device_table_mutex);
 }
 
-static int
-_get_mdevice_count(struct device *dev, void *cnt)
+void
+mISDN_devtable_unlock(void)
 {
-	*(int *)cnt += 1;
-	return 0;
+	mutex_unlock(&device_table_mutex);
 }
 
 int
 get_mdevice_count(void)
 {
-	int cnt = 0;
+	int i, cnt = 0;
+
+	rcu_read_lock();
+	for (i = 0; i <= MAX_DEVICE_ID; i++)
+		if (rcu_access_pointer(device_table[i]))
+			cnt++;
+	rcu_read_unlock();
+	return cnt;
+}
+
+void
+get_mdevice_info(struct mISDNdevice *dev, struct mISDN_devinfo *di)
+{
+	memset(di, 0, sizeof(*di));
+	di->id = dev->id;
+	di->Dprotocols = dev->Dprotocols;
+	di->Bprotocols = dev->Bprotocols | get_all_Bprotocols();
+	di->protocol = dev->D.protocol;
+	memcpy(di->channelmap, dev->channelmap, sizeof(di->channelmap));
+	di->nrbchan = dev->nrbchan;
+	strscpy(di->name, dev_name(&dev->dev), sizeof(di->name));
+}
 
-	class_for_each_device(&mISDN_class, NULL, &cnt, _get_mdevice_count);
+/*
+ * fill up to max entries of di with the registered devices in id order,
+ * returns the number of registered devices
+ */
+int
+get_mdevice_list(struct mISDN_devinfo *di, int max)
+{
+	struct mISDNdevice *dev;
+	int i, cnt = 0;
+
+	rcu_read_lock();
+	for (i = 0; i <= MAX_DEVICE_ID; i++) {
+		dev = rcu_dereference(device_table[i]);
+		if (!dev)
+			continue;
+		if (cnt < max)
+			get_mdevice_info(dev, &di[cnt]);
+		cnt++;
+	}
+	rcu_read_unlock();
 	return cnt;
 }
 
@@ -245,6 +292,9 @@ mISDN_register_device(struct mISDNdevice *dev,
 	err = device_add(&dev->dev);
 	if (err)
 		goto error3;
+	mutex_lock(&device_table_mutex);
+	rcu_assign_pointer(device_table[dev->id], dev);
+	mutex_unlock(&device_table_mutex);
 	return 0;
 
 error3:
@@ -261,6 +311,10 @@ mISDN_unregister_device(struct mISDNdevice *dev) {
 	if (debug & DEBUG_CORE)
 		printk(KERN_DEBUG "mISDN_unregister %s %d\n",
 		       dev_name(&dev->dev), dev->id);
+	mutex_lock(&device_table_mutex);
+	RCU_INIT_POINTER(device_table[dev->id], NULL);
+	mutex_unlock(&device_table_mutex);
+	synchronize_rcu();
 	/* sysfs_remove_link(&dev->dev.kobj, "device"); */
 	device_del(&dev->dev);
 	dev_set_drvdata(&dev->dev, NULL);
@@ -390,8 +444,13 @@ mISDNInit(void)
 	err = misdn_sock_init(&debug);
 	if (err)
 		goto error5;
+	err = mISDN_nl_init();
+	if (err)
+		goto error6;
 	return 0;
 
+error6:
+	misdn_sock_cleanup();
 error5:
 	Isdnl2_cleanup();
 error4:
@@ -406,6 +465,7 @@ error1:
 
 static void mISDN_cleanup(void)
 {
+	mISDN_nl_cleanup();
 	misdn_sock_cleanup();
 	Isdnl2_cleanup();
 	l1_cleanup();
@@ -7,7 +7,19 @@
 #define mISDN_CORE_H
 
 extern struct mISDNdevice	*get_mdevice(u_int);
+extern void			mISDN_devtable_lock(void);
+extern void			mISDN_devtable_unlock(void);
 extern int			get_mdevice_count(void);
+extern void			get_mdevice_info(struct mISDNdevice *,
+						 struct mISDN_devinfo *);
+extern int			get_mdevice_list(struct mISDN_devinfo *, int);
+extern int			get_bchannel_stats(struct mISDNdevice *,
+						   struct mISDN_bchstats *,
+						   u_int);
+extern int			get_l2_stats(struct mISDNdevice *,
+					     struct mISDN_l2stats *, u_int);
+extern int			mISDN_nl_init(void);
+extern void			mISDN_nl_cleanup(void);
 
 /* stack status flag */
 #define mISDN_STACK_ACTION_MASK		0x0000ffff
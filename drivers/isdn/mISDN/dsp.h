@@ -22,12 +22,24 @@
  *
  * bit 0 = use ulaw instead of alaw
  * bit 1 = enable hfc hardware acceleration for all channels
+ * bit 2 = disable blowfish encryption
+ * bit 3 = disable pipeline (software echo cancelers)
+ * bit 4 = disable volume change
  *
+ * Bits 2-4 may be changed at runtime, they remove the feature's tests from
+ * the per frame path. A feature can only be disabled while no channel
+ * uses it.
  */
 #define DSP_OPT_ULAW		(1 << 0)
 #define DSP_OPT_NOHARDWARE	(1 << 1)
+#define DSP_OPT_NOBLOWFISH	(1 << 2)
+#define DSP_OPT_NOPIPELINE	(1 << 3)
+#define DSP_OPT_NOVOLUME	(1 << 4)
+#define DSP_OPT_RUNTIME		(DSP_OPT_NOBLOWFISH | DSP_OPT_NOPIPELINE | \
+				 DSP_OPT_NOVOLUME)
 
 #include <linux/timer.h>
+#include <linux/jump_label.h>
 #include <linux/workqueue.h>
 
 #include "dsp_ecdis.h"
@@ -70,6 +82,7 @@ extern u8 dsp_silence;
 #define CMX_BUFF_SIZE	0x8000	/* must be 2**n (0x1000 about 1/2 second) */
 #define CMX_BUFF_HALF	0x4000	/* CMX_BUFF_SIZE / 2 */
 #define CMX_BUFF_MASK	0x7fff	/* CMX_BUFF_SIZE - 1 */
+#define CMX_STAMP_JITTER	8	/* samples a stamp may be off */
 
 /* how many seconds will we check the lowest delay until the jitter buffer
    is reduced by that delay */
@@ -80,6 +93,22 @@ extern struct timer_list dsp_spl_tl;
 /* the datatype need to match jiffies datatype */
 extern unsigned long dsp_spl_jiffies;
 
+/*
+ * the tick stops while no dsp needs software clocking, state changes that
+ * may need it call dsp_cmx_tick_wake() with dsp_lock held
+ */
+extern int dsp_tick_running;
+extern unsigned long dsp_tick_stopped;
+extern u64 dsp_tick_count, dsp_tick_skipped;
+extern void dsp_cmx_tick_start(void);
+
+static inline void
+dsp_cmx_tick_wake(void)
+{
+	if (!dsp_tick_running)
+		dsp_cmx_tick_start();
+}
+
 /* the structure of conferences:
  *
  * each conference has a unique number, given by user space.
@@ -105,6 +134,9 @@ struct dsp_conf {
 	int			software; /* conf is processed by software */
 	int			hardware; /* conf is processed by hardware */
 	/* note: if both unset, has only one member */
+	int			cmx_pending; /* samples collected for frame */
+	int			cmx_len; /* samples to send this tick */
+	int			record; /* DSP_RECORD_* of all members */
 };
 
 
@@ -130,6 +162,32 @@ struct dsp_dtmf {
 	u8		digits[16]; /* dtmf result */
 };
 
+/*
+ * rx idle detection: after this many silent samples in a row, the channel
+ * is idle and DTMF decoding, volume change and mixing are skipped
+ */
+#define DSP_IDLE_SAMPLES	256	/* more than two DTMF blocks */
+#define dsp_rx_idle(dsp)	((dsp)->rx_idle_run >= DSP_IDLE_SAMPLES)
+
+/* loopback latency measurement */
+#define LAT_MARK_LEN	32	/* samples of marker, power of 2 */
+
+enum {
+	DSP_LAT_IDLE = 0,
+	DSP_LAT_ARMED,		/* marker goes out with next frame */
+	DSP_LAT_WAIT,		/* waiting for marker on rx */
+};
+
+struct dsp_latency {
+	int		state;
+	u16		t_tx; /* sample clock when marker was sent */
+	s32		hist[LAT_MARK_LEN]; /* last rx samples */
+	int		pos;
+	int		last, min, max; /* delay in samples, -1 = lost */
+	int		cmx; /* rx jitter buffer at detection */
+	u_int		count, lost;
+};
+
 
 /******************
  * pipeline stuff *
@@ -138,6 +196,7 @@ struct dsp_pipeline {
 	rwlock_t  lock;
 	struct list_head list;
 	int inuse;
+	int fpu; /* an element wants the FPU for process_rx */
 };
 
 /***************
@@ -179,8 +238,14 @@ struct dsp {
 	int		tx_mix;
 	struct dsp_tone	tone;
 	struct dsp_dtmf	dtmf;
+	struct dsp_latency latency;
 	int		tx_volume, rx_volume;
 
+	/* rx idle detection */
+	int		rx_idle_run; /* silent samples received in a row */
+	u64		rx_samples; /* statistics for debugfs */
+	u64		rx_idle_samples;
+
 	/* queue for sending frames */
 	struct work_struct	workq;
 	struct sk_buff_head	sendq;
@@ -197,6 +262,8 @@ struct dsp {
 	int		rx_W; /* current write pos for data without timestamp */
 	int		rx_R; /* current read pos for transmit clock */
 	int		rx_init; /* if set, pointers will be adjusted first */
+	int		rx_stamp_off; /* rx_W minus sample stamp of frames */
+	int		rx_stamped; /* rx_stamp_off is set by the last frame */
 	int		tx_W; /* current write pos for transmit data */
 	int		tx_R; /* current read pos for transmit clock */
 	int		rx_delay[MAX_SECONDS_JITTER_CHECK];
@@ -207,12 +274,18 @@ struct dsp {
 	int		cmx_delay; /* initial delay of buffers,
 				      or 0 for dynamic jitter buffer */
 	int		tx_dejitter; /* if set, dejitter tx buffer */
+	int		cmx_frame; /* samples per tx frame, 0 = each tick */
+	int		cmx_pending; /* samples collected for next frame */
+	int		cmx_len; /* samples sent this tick, 0 = none */
 	int		tx_data; /* enables tx-data of CMX to upper layer */
+	int		record; /* DSP_RECORD_* conf mix to upper layer */
 
 	/* hardware stuff */
 	struct dsp_features features;
 	int		features_rx_off; /* set if rx_off is featured */
 	int		features_fill_empty; /* set if fill_empty is featured */
+	int		features_gain; /* set if MISDN_CTRL_GAIN is featured */
+	int		hw_gain; /* volumes are set in hardware too */
 	int		pcm_slot_rx; /* current PCM slot (or -1) */
 	int		pcm_bank_rx;
 	int		pcm_slot_tx;
@@ -252,8 +325,16 @@ extern void dsp_cmx_transmit(struct dsp *dsp, struct sk_buff *skb);
 extern int dsp_cmx_del_conf_member(struct dsp *dsp);
 extern int dsp_cmx_del_conf(struct dsp_conf *conf);
 
+extern void dsp_latency_start(struct dsp *dsp);
+extern void dsp_latency_tx(struct dsp *dsp, u8 *data, int len);
+extern int dsp_latency_rx(struct dsp *dsp, u8 *data, int len);
+extern void dsp_latency_report(struct dsp *dsp);
+extern void dsp_latency_init(void);
+extern struct dentry *dsp_debugfs;
+
 extern void dsp_dtmf_goertzel_init(struct dsp *dsp);
 extern void dsp_dtmf_hardware(struct dsp *dsp);
+extern void dsp_dtmf_hw_message(struct dsp *dsp, int on);
 extern u8 *dsp_dtmf_goertzel_decode(struct dsp *dsp, u8 *data, int len,
 				    int fmt);
 
@@ -261,10 +342,37 @@ extern int dsp_tone(struct dsp *dsp, int tone);
 extern void dsp_tone_copy(struct dsp *dsp, u8 *data, int len);
 extern void dsp_tone_timeout(struct timer_list *t);
 
+/*
+ * per frame feature tests, patched out while a feature is disabled by
+ * options, constant 0 if it is not compiled in
+ */
+DECLARE_STATIC_KEY_TRUE(dsp_key_volume);
+#define dsp_use_volume()	static_branch_likely(&dsp_key_volume)
+
+#ifdef CONFIG_MISDN_DSP_BLOWFISH
+DECLARE_STATIC_KEY_TRUE(dsp_key_blowfish);
+#define dsp_use_blowfish()	static_branch_likely(&dsp_key_blowfish)
+
 extern void dsp_bf_encrypt(struct dsp *dsp, u8 *data, int len);
 extern void dsp_bf_decrypt(struct dsp *dsp, u8 *data, int len);
 extern int dsp_bf_init(struct dsp *dsp, const u8 *key, unsigned int keylen);
 extern void dsp_bf_cleanup(struct dsp *dsp);
+#else
+#define dsp_use_blowfish()	0
+
+static inline void dsp_bf_encrypt(struct dsp *dsp, u8 *data, int len) {}
+static inline void dsp_bf_decrypt(struct dsp *dsp, u8 *data, int len) {}
+static inline int dsp_bf_init(struct dsp *dsp, const u8 *key,
+			      unsigned int keylen)
+{
+	return -EOPNOTSUPP;
+}
+static inline void dsp_bf_cleanup(struct dsp *dsp) {}
+#endif
+
+#ifdef CONFIG_MISDN_DSP_PIPELINE
+DECLARE_STATIC_KEY_TRUE(dsp_key_pipeline);
+#define dsp_use_pipeline()	static_branch_likely(&dsp_key_pipeline)
 
 extern int  dsp_pipeline_module_init(void);
 extern void dsp_pipeline_module_exit(void);
@@ -274,4 +382,36 @@ extern int  dsp_pipeline_build(struct dsp_pipeline *pipeline, const char *cfg);
 extern void dsp_pipeline_process_tx(struct dsp_pipeline *pipeline, u8 *data,
 				    int len);
 extern void dsp_pipeline_process_rx(struct dsp_pipeline *pipeline, u8 *data,
-				    int len, unsigned int txlen);
+				    int len, unsigned int txlen, int fpu);
+extern int  dsp_pipeline_fpu_begin(struct dsp_pipeline *pipeline);
+extern void dsp_pipeline_fpu_end(int fpu);
+#else
+#define dsp_use_pipeline()	0
+
+static inline int dsp_pipeline_module_init(void)
+{
+	return 0;
+}
+static inline void dsp_pipeline_module_exit(void) {}
+static inline int dsp_pipeline_init(struct dsp_pipeline *pipeline)
+{
+	return 0;
+}
+static inline void dsp_pipeline_destroy(struct dsp_pipeline *pipeline) {}
+static inline int dsp_pipeline_build(struct dsp_pipeline *pipeline,
+				     const char *cfg)
+{
+	/* an empty config just clears the pipeline */
+	return (cfg && *cfg) ? -EOPNOTSUPP : 0;
+}
+static inline void dsp_pipeline_process_tx(struct dsp_pipeline *pipeline,
+					   u8 *data, int len) {}
+static inline void dsp_pipeline_process_rx(struct dsp_pipeline *pipeline,
+					   u8 *data, int len,
+					   unsigned int txlen, int fpu) {}
+static inline int dsp_pipeline_fpu_begin(struct dsp_pipeline *pipeline)
+{
+	return 0;
+}
+static inline void dsp_pipeline_fpu_end(int fpu) {}
+#endif
@@ -238,6 +238,17 @@ static inline int CONVOLVE2(const short *coeffs, const short *hist, int len)
 
 	return sum;
 }
+
+static inline void UPDATE_NLMS2(int *taps, short *taps_short,
+    const short *err, const short *history, int len, int ntaps, int div)
+{
+	int k;
+	for (k = 0; k < ntaps; k++) {
+		taps[k] += CONVOLVE2(err, history + k, len) / div;
+		taps_short[k] = taps[k] >> 16;
+	}
+}
+
 static inline short MAX16(const short *y, int len, int *pos)
 {
 	int k;
@@ -305,11 +316,163 @@ static inline int CONVOLVE(const int *coeffs, const short *hist, int len)
 static inline int CONVOLVE2(const short *coeffs, const short *hist, int len)
 {
 	int x;
+	int sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+
+	/* four independent accumulators let the compiler vectorize */
+	for (x = 0; x + 4 <= len; x += 4) {
+		sum0 += coeffs[x] * hist[x];
+		sum1 += coeffs[x + 1] * hist[x + 1];
+		sum2 += coeffs[x + 2] * hist[x + 2];
+		sum3 += coeffs[x + 3] * hist[x + 3];
+	}
+	for (; x < len; x++)
+		sum0 += coeffs[x] * hist[x];
+	return sum0 + sum1 + sum2 + sum3;
+}
+
+/*
+ * Block coefficient update: taps[k] += sum(err[m] * history[k + m]) / div
+ * for all ntaps coefficients.  Four taps are correlated per pass, so each
+ * error sample is loaded once for four coefficients.
+ */
+static inline void UPDATE_NLMS2(int *taps, short *taps_short,
+    const short *err, const short *history, int len, int ntaps, int div)
+{
+	int k, m;
+	int g0, g1, g2, g3;
+
+	for (k = 0; k + 4 <= ntaps; k += 4) {
+		const short *h = history + k;
+
+		g0 = g1 = g2 = g3 = 0;
+		for (m = 0; m < len; m++) {
+			g0 += err[m] * h[m];
+			g1 += err[m] * h[m + 1];
+			g2 += err[m] * h[m + 2];
+			g3 += err[m] * h[m + 3];
+		}
+		taps[k] += g0 / div;
+		taps[k + 1] += g1 / div;
+		taps[k + 2] += g2 / div;
+		taps[k + 3] += g3 / div;
+		taps_short[k] = taps[k] >> 16;
+		taps_short[k + 1] = taps[k + 1] >> 16;
+		taps_short[k + 2] = taps[k + 2] >> 16;
+		taps_short[k + 3] = taps[k + 3] >> 16;
+	}
+	for (; k < ntaps; k++) {
+		taps[k] += CONVOLVE2(err, history + k, len) / div;
+		taps_short[k] = taps[k] >> 16;
+	}
+}
+
+#ifdef CONFIG_MISDN_DSP_EC_SIMD
+/*
+ * Vector versions of CONVOLVE2.  They must only run while the FPU is
+ * claimed, see dsp_eccore.h.  All sums wrap
+ * modulo 2^32 like the C version, so the result is identical.
+ */
+#ifdef CONFIG_X86_64
+static inline int CONVOLVE2_SSE2(const short *coeffs, const short *hist,
+    int len)
+{
+	const short *c = coeffs, *h = hist;
+	unsigned long n = len >> 3;
+	int x = len & ~7;
 	int sum = 0;
-	for (x = 0; x < len; x++)
+
+	if (n)
+		__asm__ __volatile__ (
+			"pxor %%xmm0, %%xmm0;\n"
+			"1:"
+				"movdqu (%1), %%xmm1;\n"
+				"movdqu (%2), %%xmm2;\n"
+				"pmaddwd %%xmm2, %%xmm1;\n"
+				"paddd %%xmm1, %%xmm0;\n"
+				"add $16, %1;\n"
+				"add $16, %2;\n"
+				"dec %3;\n"
+			"jnz 1b;\n"
+			"pshufd $0x4e, %%xmm0, %%xmm1;\n"
+			"paddd %%xmm1, %%xmm0;\n"
+			"pshufd $0xb1, %%xmm0, %%xmm1;\n"
+			"paddd %%xmm1, %%xmm0;\n"
+			"movd %%xmm0, %0;\n"
+			: "=r" (sum), "+r" (c), "+r" (h), "+r" (n)
+			:
+			: "memory", "cc", "xmm0", "xmm1", "xmm2");
+	for (; x < len; x++)
+		sum += coeffs[x] * hist[x];
+	return sum;
+}
+
+static inline int CONVOLVE2_AVX2(const short *coeffs, const short *hist,
+    int len)
+{
+	const short *c = coeffs, *h = hist;
+	unsigned long n = len >> 4;
+	int x = len & ~15;
+	int sum = 0;
+
+	if (n)
+		__asm__ __volatile__ (
+			"vpxor %%ymm0, %%ymm0, %%ymm0;\n"
+			"1:"
+				"vmovdqu (%1), %%ymm1;\n"
+				"vpmaddwd (%2), %%ymm1, %%ymm1;\n"
+				"vpaddd %%ymm1, %%ymm0, %%ymm0;\n"
+				"add $32, %1;\n"
+				"add $32, %2;\n"
+				"dec %3;\n"
+			"jnz 1b;\n"
+			"vextracti128 $1, %%ymm0, %%xmm1;\n"
+			"vpaddd %%xmm1, %%xmm0, %%xmm0;\n"
+			"vpshufd $0x4e, %%xmm0, %%xmm1;\n"
+			"vpaddd %%xmm1, %%xmm0, %%xmm0;\n"
+			"vpshufd $0xb1, %%xmm0, %%xmm1;\n"
+			"vpaddd %%xmm1, %%xmm0, %%xmm0;\n"
+			"vmovd %%xmm0, %0;\n"
+			"vzeroupper;\n"
+			: "=r" (sum), "+r" (c), "+r" (h), "+r" (n)
+			:
+			/* the ymm registers are the xmm ones, widened */
+			: "memory", "cc", "xmm0", "xmm1");
+	for (; x < len; x++)
+		sum += coeffs[x] * hist[x];
+	return sum;
+}
+#endif	/* CONFIG_X86_64 */
+
+#ifdef CONFIG_ARM64
+static inline int CONVOLVE2_NEON(const short *coeffs, const short *hist,
+    int len)
+{
+	const short *c = coeffs, *h = hist;
+	unsigned long n = len >> 3;
+	int x = len & ~7;
+	int sum = 0;
+
+	if (n)
+		__asm__ __volatile__ (
+			"movi v0.4s, #0;\n"
+			"1:"
+				"ld1 {v1.8h}, [%1], #16;\n"
+				"ld1 {v2.8h}, [%2], #16;\n"
+				"smlal v0.4s, v1.4h, v2.4h;\n"
+				"smlal2 v0.4s, v1.8h, v2.8h;\n"
+				"subs %3, %3, #1;\n"
+			"b.ne 1b;\n"
+			"addv s0, v0.4s;\n"
+			"fmov %w0, s0;\n"
+			: "=r" (sum), "+r" (c), "+r" (h), "+r" (n)
+			:
+			: "memory", "cc", "v0", "v1", "v2");
+	for (; x < len; x++)
 		sum += coeffs[x] * hist[x];
 	return sum;
 }
+#endif	/* CONFIG_ARM64 */
+#endif	/* CONFIG_MISDN_DSP_EC_SIMD */
 
 static inline void UPDATE(int *taps, const short *history,
     const int nsuppr, const int ntaps)
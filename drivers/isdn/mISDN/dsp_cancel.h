@@ -26,12 +26,14 @@
  *
  */
 
-#ifdef ARCH_I386
-#include <asm/i387.h>
+/* only the mark2 family (dsp_eccore.h) has vector kernels */
+#ifdef _DSP_ECCORE_H
+#define dsp_cancel_isa(p, fpu)	((p)->ec->isa = ec_core_select(fpu))
 #else
-#define kernel_fpu_begin()
-#define kernel_fpu_end()
+#define dsp_cancel_isa(p, fpu)	do { } while (0)
 #endif
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #define EC_TIMER 2000
 
@@ -44,6 +46,16 @@
 #define ECHO_STATE_ACTIVE		(5)
 #define AMI_MASK			0x55
 
+/*
+ * Adaptation throttling: once the residual echo stays ECHO_THROTTLE_ERLE
+ * times (24 dB) below the far-end signal for ECHO_THROTTLE_HOLD samples,
+ * the canceller only adapts on every 'throttle'th update. Near-end speech
+ * or a rising residual return it to full-rate adaptation.
+ */
+#define ECHO_THROTTLE_ERLE		16
+#define ECHO_THROTTLE_HOLD		4000	/* 500 ms */
+#define ECHO_THROTTLE_MINTX		64	/* average far-end level */
+
 struct ec_prv {
 	struct echo_can_state *ec;
 	uint16_t echotimer;
@@ -53,12 +65,24 @@ struct ec_prv {
 	int  tx_W;
 	int  underrun;
 	int  overflow;
+	int  throttle;
+	int  decim;
+	int  conv_hold;
+	unsigned long adapt_full;
+	unsigned long adapt_throttled;
+	struct list_head list;
 };
 
+/* instances of this element, listed in debugfs mISDN_dsp/<element> */
+static LIST_HEAD(dsp_cancel_list);
+static DEFINE_SPINLOCK(dsp_cancel_lock);
+static struct dentry *dsp_cancel_dentry;
+
 static inline void *
-dsp_cancel_new(int deftaps, int training)
+dsp_cancel_new(int deftaps, int training, int throttle)
 {
 	struct ec_prv *p;
+	u_long flags;
 
 	p = kzalloc(sizeof(struct ec_prv), GFP_ATOMIC);
 	if (!p)
@@ -75,6 +99,12 @@ dsp_cancel_new(int deftaps, int training)
 	p->tx_W = 0;
 	p->underrun = 0;
 	p->overflow = 0;
+	p->throttle = throttle > 1 ? throttle : 0;
+	p->decim = 1;
+
+	spin_lock_irqsave(&dsp_cancel_lock, flags);
+	list_add_tail(&p->list, &dsp_cancel_list);
+	spin_unlock_irqrestore(&dsp_cancel_lock, flags);
 
 	return p;
 
@@ -84,15 +114,69 @@ err1:
 	return NULL;
 }
 
+/* the "throttle" argument, common to all elements that support it */
+#define DSP_CANCEL_ARG_THROTTLE \
+	{ "throttle", "0", "Adapt only every n-th update while converged " \
+		"(0: disabled)." }
+
+static inline void
+dsp_cancel_arg_throttle(const char *name, const char *val, int *throttle)
+{
+	int tmp;
+
+	if (!strcmp(name, "throttle") && sscanf(val, "%d", &tmp) == 1)
+		*throttle = tmp;
+}
+
 static inline void
 dsp_cancel_free(struct ec_prv *p)
 {
+	u_long flags;
+
 	if (!p)
 		return;
+	spin_lock_irqsave(&dsp_cancel_lock, flags);
+	list_del(&p->list);
+	spin_unlock_irqrestore(&dsp_cancel_lock, flags);
+	if (p->throttle)
+		printk(KERN_DEBUG "%s: %s adaptation throttled for %lu of %lu "
+			"samples\n", __func__, EC_TYPE, p->adapt_throttled,
+			p->adapt_full + p->adapt_throttled);
 	echo_can_free(p->ec);
 	kfree(p);
 }
 
+static int
+dsp_cancel_stats_show(struct seq_file *m, void *unused)
+{
+	struct ec_prv *p;
+	u_long flags;
+	int i = 0;
+
+	seq_printf(m, "%s: instance throttle decim full throttled\n",
+		   EC_TYPE);
+	spin_lock_irqsave(&dsp_cancel_lock, flags);
+	list_for_each_entry(p, &dsp_cancel_list, list)
+		seq_printf(m, "%d %d %d %lu %lu\n", i++, p->throttle,
+			   p->decim, p->adapt_full, p->adapt_throttled);
+	spin_unlock_irqrestore(&dsp_cancel_lock, flags);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(dsp_cancel_stats);
+
+static inline void
+dsp_cancel_debugfs_init(const char *name)
+{
+	dsp_cancel_dentry = debugfs_create_file(name, 0444, dsp_debugfs,
+						NULL, &dsp_cancel_stats_fops);
+}
+
+static inline void
+dsp_cancel_debugfs_exit(void)
+{
+	debugfs_remove(dsp_cancel_dentry);
+}
+
 static inline void dsp_cancel_tx(struct ec_prv *p, u8 *data, int len)
 {
 	u8 *d;
@@ -110,12 +194,52 @@ static inline void dsp_cancel_tx(struct ec_prv *p, u8 *data, int len)
 	p->tx_W = w;
 }
 
-/** Processes one TX- and one RX-packet with echocancellation */
-static inline void dsp_cancel_rx(struct ec_prv *p, u8 *data, int len, unsigned int txlen)
+/*
+ * Decide on the adaptation rate from the levels of the last frame:
+ * 'tx' is the far-end reference, 'rx' the near-end input and 'out' the
+ * residual after cancellation, all summed over 'n' samples.
+ */
+static inline void
+dsp_cancel_throttle(struct ec_prv *p, int n, int tx, int rx, int out)
+{
+	int decim = 1;
+
+	if (rx > tx) {
+		/* double-talk, the echo path estimate may get disturbed */
+		p->conv_hold = 0;
+	} else if (tx > n * ECHO_THROTTLE_MINTX) {
+		if (out < tx / ECHO_THROTTLE_ERLE)
+			p->conv_hold += n;
+		else
+			p->conv_hold = 0;	/* not converged or diverging */
+	}
+	/* without far-end signal there is nothing to adapt, keep the state */
+
+	if (p->conv_hold >= ECHO_THROTTLE_HOLD) {
+		p->conv_hold = ECHO_THROTTLE_HOLD;
+		decim = p->throttle;
+	}
+	if (decim != p->decim) {
+		p->decim = decim;
+		echo_can_decimate(p->ec, decim);
+	}
+	if (decim > 1)
+		p->adapt_throttled += n;
+	else
+		p->adapt_full += n;
+}
+
+/**
+ * Processes one TX- and one RX-packet with echocancellation, 'fpu' is set
+ * if the DSP claimed the FPU for this frame
+ */
+static inline void dsp_cancel_rx(struct ec_prv *p, u8 *data, int len,
+	unsigned int txlen, int fpu)
 {
 	int16_t	rxlin, txlin;
 	int	r;
 	u8	*s;
+	int	n = len, txsum = 0, rxsum = 0, outsum = 0;
 
 	if (!p || !data)
 		return;
@@ -126,7 +250,7 @@ static inline void dsp_cancel_rx(struct ec_prv *p, u8 *data, int len, unsigned i
 	s = p->txbuff;
 	/* calculation V0.1 : 'len' and 'txlen' samples off the end */
 	r = (p->tx_W - len - txlen) & ECHOCAN_BUFF_MASK;
-	kernel_fpu_begin();
+	dsp_cancel_isa(p, fpu);
 	if (p->echostate & __ECHO_STATE_MUTE) {
 		/* Special stuff for training the echo can */
 		while (len--) {
@@ -157,10 +281,15 @@ static inline void dsp_cancel_rx(struct ec_prv *p, u8 *data, int len, unsigned i
 		while (len--) {
 			rxlin = dsp_audio_law_to_s32[*data];
 			txlin = dsp_audio_law_to_s32[s[r]];
+			txsum += abs(txlin);
+			rxsum += abs(rxlin);
 			rxlin = echo_can_update(p->ec, txlin, rxlin);
+			outsum += abs(rxlin);
 			*data++ = dsp_audio_s16_to_law[rxlin & 0xffff];
 			r = (r + 1) & ECHOCAN_BUFF_MASK;
 		}
+		if (p->throttle)
+			dsp_cancel_throttle(p, n, txsum, rxsum, outsum);
 	}
-	kernel_fpu_end();
+	dsp_cancel_isa(p, 0);
 }
@@ -380,8 +380,8 @@ dsp_cmx_hw_message(struct dsp *dsp, u32 message, u32 param1, u32 param2,
  * and therefore removed. if a conference is given, the dsp is expected to
  * be member of that conference.
  */
-void
-dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp)
+static void
+dsp_cmx_hardware_update(struct dsp_conf *conf, struct dsp *dsp)
 {
 	struct dsp_conf_member	*member, *nextm;
 	struct dsp		*finddsp;
@@ -389,7 +389,7 @@ dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp)
 	int		freeunits[8];
 	u_char		freeslots[256];
 	int		same_hfc = -1, same_pcm = -1, current_conf = -1,
-		all_conf = 1, tx_data = 0;
+		all_conf = 1, tx_data = 0, record = 0, gain = 0;
 
 	/* dsp gets updated (no conf) */
 	if (!conf) {
@@ -584,15 +584,18 @@ dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp)
 			goto conf_software;
 		}
 		/* check if member changes volume at an not suppoted level */
-		if (member->dsp->tx_volume) {
+		if (member->dsp->hw_gain) {
+			/* only the conference unit applies the gain */
+			if (member->dsp->tx_volume || member->dsp->rx_volume)
+				gain = 1;
+		} else if (member->dsp->tx_volume) {
 			if (dsp_debug & DEBUG_DSP_CMX)
 				printk(KERN_DEBUG
 				       "%s dsp %s cannot form a conf, because "
 				       "tx_volume is changed\n",
 				       __func__, member->dsp->name);
 			goto conf_software;
-		}
-		if (member->dsp->rx_volume) {
+		} else if (member->dsp->rx_volume) {
 			if (dsp_debug & DEBUG_DSP_CMX)
 				printk(KERN_DEBUG
 				       "%s dsp %s cannot form a conf, because "
@@ -608,6 +611,15 @@ dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp)
 				       __func__, member->dsp->name);
 			tx_data = 1;
 		}
+		/* check if conference is recorded, this requires rx data */
+		if (member->dsp->record) {
+			if (dsp_debug & DEBUG_DSP_CMX)
+				printk(KERN_DEBUG
+				       "%s dsp %s records the conference\n",
+				       __func__, member->dsp->name);
+			tx_data = 1;
+			record = 1;
+		}
 		/* check if pipeline exists */
 		if (member->dsp->pipeline.inuse) {
 			if (dsp_debug & DEBUG_DSP_CMX)
@@ -668,7 +680,7 @@ dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp)
 			       "%s conf %d cannot form a HW conference, "
 			       "because dsp is alone\n", __func__, conf->id);
 		conf->hardware = 0;
-		conf->software = 0;
+		conf->software = record;
 		member = list_entry(conf->mlist.next, struct dsp_conf_member,
 				    list);
 		dsp = member->dsp;
@@ -681,8 +693,8 @@ dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp)
 	 * crossconnections, which don't have any limitations.
 	 */
 
-	/* if we have only two members */
-	if (memb == 2) {
+	/* if we have only two members, unless the gain requires a conf */
+	if (memb == 2 && !gain) {
 		member = list_entry(conf->mlist.next, struct dsp_conf_member,
 				    list);
 		nextm = list_entry(member->list.next, struct dsp_conf_member,
@@ -1055,6 +1067,14 @@ dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp)
 	goto join_members;
 }
 
+void
+dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp)
+{
+	dsp_cmx_hardware_update(conf, dsp);
+	/* conf or dsp may have fallen back to software mixing */
+	dsp_cmx_tick_wake();
+}
+
 
 /*
  * conf_id != 0: join or change conference
@@ -1184,7 +1204,11 @@ dsp_cmx_receive(struct dsp *dsp, struct sk_buff *skb)
 	u8 *d, *p;
 	int len = skb->len;
 	struct mISDNhead *hh = mISDN_HEAD_P(skb);
-	int w, i, ii;
+	struct mISDNstamp *st = mISDN_STAMP_P(skb);
+	int w, i, ii, stamped, gap;
+
+	/* the driver stamped the frame from the sample counter of the card */
+	stamped = !dsp->features.unordered && st->valid;
 
 	/* check if we have sompen */
 	if (len < 1)
@@ -1220,11 +1244,27 @@ dsp_cmx_receive(struct dsp *dsp, struct sk_buff *skb)
 			else
 				dsp->rx_W = dsp_poll >> 1;
 		}
+		dsp->rx_stamped = 0;
 	}
 	/* if frame contains time code, write directly */
 	if (dsp->features.unordered) {
 		dsp->rx_W = (hh->id & CMX_BUFF_MASK);
 		/* printk(KERN_DEBUG "%s %08x\n", dsp->name, hh->id); */
+	} else if (stamped && dsp->rx_stamped) {
+		/*
+		 * frames are still written one after the other, the stamp
+		 * only tells about samples the card lost, they are filled
+		 * with silence; smaller differences are jitter of the clock
+		 */
+		gap = ((st->first + dsp->rx_stamp_off - dsp->rx_W +
+			CMX_BUFF_HALF) & CMX_BUFF_MASK) - CMX_BUFF_HALF;
+		if (gap > CMX_STAMP_JITTER) {
+			d = dsp->rx_buff;
+			w = dsp->rx_W;
+			for (i = 0; i < gap; i++)
+				d[w++ & CMX_BUFF_MASK] = dsp_silence;
+			dsp->rx_W = w & CMX_BUFF_MASK;
+		}
 	}
 	/*
 	 * if we underrun (or maybe overrun),
@@ -1276,6 +1316,11 @@ dsp_cmx_receive(struct dsp *dsp, struct sk_buff *skb)
 			memset(dsp->rx_buff, dsp_silence, sizeof(dsp->rx_buff));
 		}
 
+	/* the next stamp is compared to where this frame goes */
+	if (stamped)
+		dsp->rx_stamp_off = (dsp->rx_W - st->first) & CMX_BUFF_MASK;
+	dsp->rx_stamped = stamped;
+
 	/* show where to write */
 #ifdef CMX_DEBUG
 	printk(KERN_DEBUG
@@ -1572,6 +1617,9 @@ dsp_cmx_send_member(struct dsp *dsp, int len, s32 *c, int members)
 	goto send_packet;
 
 send_packet:
+	/* latency measurement marker */
+	if (dsp->latency.state == DSP_LAT_ARMED)
+		dsp_latency_tx(dsp, nskb->data + preload, len);
 	/*
 	 * send tx-data if enabled - don't filter,
 	 * because we want what we send, not what we filtered
@@ -1604,25 +1652,149 @@ send_packet:
 
 	/* send data only to card, if we don't just calculated tx_data */
 	/* adjust volume */
-	if (dsp->tx_volume)
+	if (dsp_use_volume() && dsp->tx_volume)
 		dsp_change_volume(nskb, dsp->tx_volume);
 	/* pipeline */
-	if (dsp->pipeline.inuse)
+	if (dsp_use_pipeline() && dsp->pipeline.inuse)
 		dsp_pipeline_process_tx(&dsp->pipeline, nskb->data,
 					nskb->len);
 	/* crypt */
-	if (dsp->bf_enable)
+	if (dsp_use_blowfish() && dsp->bf_enable)
 		dsp_bf_encrypt(dsp, nskb->data, nskb->len);
 	/* queue and trigger */
 	skb_queue_tail(&dsp->sendq, nskb);
 	schedule_work(&dsp->workq);
 }
 
+/*
+ * indicate the conference mix to all members that record the conference,
+ * called with the mix of all members, before rx data is removed
+ */
+static void
+dsp_cmx_record(struct dsp_conf *conf, s32 *c, int len, int members)
+{
+	struct dsp_conf_member *member, *other;
+	struct dsp *dsp;
+	struct sk_buff *nskb;
+	struct mISDNhead *hh;
+	int channels, r, i;
+	s32 sample;
+	u8 *d;
+
+	list_for_each_entry(member, &conf->mlist, list) {
+		dsp = member->dsp;
+		if (!(dsp->record & DSP_RECORD_MIX) || !dsp->b_active)
+			continue;
+		channels = (dsp->record & DSP_RECORD_MEMBERS) ? members : 0;
+		nskb = mI_alloc_skb(2 * sizeof(int) + len * (channels + 1),
+				    GFP_ATOMIC);
+		if (!nskb) {
+			printk(KERN_ERR "%s: No mem for record data (%s)\n",
+			       __func__, dsp->name);
+			continue;
+		}
+		hh = mISDN_HEAD_P(nskb);
+		hh->prim = PH_CONTROL_IND;
+		hh->id = MISDN_ID_ANY;
+		*(int *)skb_put(nskb, sizeof(int)) = DSP_RECORD_DATA;
+		*(int *)skb_put(nskb, sizeof(int)) = channels;
+		d = skb_put(nskb, len);
+		for (i = 0; i < len; i++) {
+			sample = c[i];
+			if (sample < -32768)
+				sample = -32768;
+			else if (sample > 32767)
+				sample = 32767;
+			d[i] = dsp_audio_s16_to_law[sample & 0xffff];
+		}
+		if (channels) {
+			list_for_each_entry(other, &conf->mlist, list) {
+				d = skb_put(nskb, len);
+				r = other->dsp->rx_R;
+				for (i = 0; i < len; i++) {
+					d[i] = other->dsp->rx_buff[r];
+					r = (r + 1) & CMX_BUFF_MASK;
+				}
+			}
+		}
+		/* queue, sent with the frame's tx data */
+		skb_queue_tail(&dsp->sendq, nskb);
+		schedule_work(&dsp->workq);
+	}
+}
+
 static u32	jittercount; /* counter for jitter check */
 struct timer_list dsp_spl_tl;
 unsigned long	dsp_spl_jiffies; /* calculate the next time to fire */
 static u16	dsp_count; /* last sample count */
 static int	dsp_count_valid; /* if we have last sample count */
+int		dsp_tick_running; /* timer is armed */
+unsigned long	dsp_tick_stopped; /* jiffies when the timer stopped */
+u64		dsp_tick_count, dsp_tick_skipped; /* statistics */
+
+/*
+ * check if a dsp needs the tick after this one, this is the case for
+ * software conferences, echo, tones and pending tx data
+ * hardware bridged dsps need no tick, and neither do idle dsps if the
+ * card fills its FIFO with silence
+ */
+static int
+dsp_cmx_need_tick(struct dsp *dsp)
+{
+	if (!dsp->b_active)
+		return 0;
+	if (dsp->conf && dsp->conf->software)
+		return 1;
+	if (dsp->tx_R != dsp->tx_W)
+		return 1;
+	if (dsp->tone.tone && dsp->tone.software)
+		return 1;
+	if (dsp->echo.software || dsp->tx_data || dsp->record)
+		return 1;
+	if (dsp->latency.state != DSP_LAT_IDLE)
+		return 1;
+	if ((dsp->conf && dsp->conf->hardware) || dsp->echo.hardware)
+		return 0;
+	return !dsp->features_fill_empty;
+}
+
+/*
+ * restart the stopped tick, must be called with dsp_lock held
+ * the sample count continues from now, so the first tick only handles
+ * the samples since the restart
+ */
+void
+dsp_cmx_tick_start(void)
+{
+	dsp_tick_skipped += (jiffies - dsp_tick_stopped) / dsp_tics;
+	dsp_count = mISDN_clock_get();
+	dsp_count_valid = 1;
+	dsp_spl_jiffies = jiffies + dsp_tics;
+	mod_timer(&dsp_spl_tl, dsp_spl_jiffies);
+	dsp_tick_running = 1;
+	if (dsp_debug & DEBUG_DSP_CLOCK)
+		printk(KERN_DEBUG "%s: tick restarted\n", __func__);
+}
+
+/*
+ * tx frame batching: collect the samples of each tick and return the
+ * length to send once a frame is complete, 0 if not yet (frame 0 means
+ * every tick)
+ */
+static int
+dsp_cmx_frame_len(int *pending, int frame, int length)
+{
+	int len;
+
+	*pending += length;
+	if (*pending < frame)
+		return 0;
+	len = *pending;
+	if (len > MAX_POLL + 100)
+		len = MAX_POLL + 100;
+	*pending -= len;
+	return len;
+}
 
 void
 dsp_cmx_send(void *arg)
@@ -1635,12 +1807,13 @@ dsp_cmx_send(void *arg)
 	s32 *c;
 	u8 *p, *q;
 	int r, rr;
-	int jittercheck = 0, delay, i;
+	int jittercheck = 0, delay, i, busy = 0;
 	u_long flags;
 	u16 length, count;
 
 	/* lock */
 	spin_lock_irqsave(&dsp_lock, flags);
+	dsp_tick_count++;
 
 	if (!dsp_count_valid) {
 		dsp_count = mISDN_clock_get();
@@ -1651,8 +1824,10 @@ dsp_cmx_send(void *arg)
 		length = count - dsp_count;
 		dsp_count = count;
 	}
-	if (length > MAX_POLL + 100)
+	if (length > MAX_POLL + 100) {
+		mISDN_nl_event(NULL, MISDN_EVENT_DSP_OVERRUN, -1, -1, length);
 		length = MAX_POLL + 100;
+	}
 	/* printk(KERN_DEBUG "len=%d dsp_count=0x%x\n", length, dsp_count); */
 
 	/*
@@ -1664,11 +1839,30 @@ dsp_cmx_send(void *arg)
 		jittercheck = 1;
 	}
 
+	/* a conference sends with the smallest frame size of its members */
+	list_for_each_entry(conf, &conf_ilist, list) {
+		i = MAX_POLL;
+		conf->record = 0;
+		list_for_each_entry(member, &conf->mlist, list) {
+			if (member->dsp->cmx_frame < i)
+				i = member->dsp->cmx_frame;
+			conf->record |= member->dsp->record;
+		}
+		conf->cmx_len = dsp_cmx_frame_len(&conf->cmx_pending, i,
+						  length);
+	}
+
 	/* loop all members that do not require conference mixing */
 	list_for_each_entry(dsp, &dsp_ilist, list) {
 		if (dsp->hdlc)
 			continue;
 		conf = dsp->conf;
+		if (conf)
+			dsp->cmx_len = conf->cmx_len;
+		else
+			dsp->cmx_len = dsp_cmx_frame_len(&dsp->cmx_pending,
+							 dsp->cmx_frame,
+							 length);
 		mustmix = 0;
 		members = 0;
 		if (conf) {
@@ -1682,8 +1876,9 @@ dsp_cmx_send(void *arg)
 		}
 
 		/* transmission required */
-		if (!mustmix) {
-			dsp_cmx_send_member(dsp, length, mixbuffer, members);
+		if (!mustmix && dsp->cmx_len) {
+			dsp_cmx_send_member(dsp, dsp->cmx_len, mixbuffer,
+					    members);
 
 			/*
 			 * unused mixbuffer is given to prevent a
@@ -1692,40 +1887,52 @@ dsp_cmx_send(void *arg)
 		}
 	}
 
-	/* loop all members that require conference mixing */
+	/* loop all members that require conference mixing or recording */
 	list_for_each_entry(conf, &conf_ilist, list) {
 		/* count members and check hardware */
 		members = count_list_member(&conf->mlist);
 #ifdef CMX_CONF_DEBUG
-		if (conf->software && members > 1) {
+		mustmix = (conf->software && members > 1);
 #else
-		if (conf->software && members > 2) {
+		mustmix = (conf->software && members > 2);
 #endif
-			/* check for hdlc conf */
-			member = list_entry(conf->mlist.next,
-					    struct dsp_conf_member, list);
-			if (member->dsp->hdlc)
+		if (!mustmix && !(conf->software && conf->record))
+			continue;
+		/* check for hdlc conf */
+		member = list_entry(conf->mlist.next,
+				    struct dsp_conf_member, list);
+		if (member->dsp->hdlc || !conf->cmx_len)
+			continue;
+		/* mix all data */
+		memset(mixbuffer, 0, conf->cmx_len * sizeof(s32));
+		list_for_each_entry(member, &conf->mlist, list) {
+			dsp = member->dsp;
+			/* skip idle members, if all buffered data is silent */
+			if (dsp_rx_idle(dsp) && dsp->rx_idle_run >=
+			    ((dsp->rx_W - dsp->rx_R) & CMX_BUFF_MASK))
 				continue;
-			/* mix all data */
-			memset(mixbuffer, 0, length * sizeof(s32));
-			list_for_each_entry(member, &conf->mlist, list) {
-				dsp = member->dsp;
-				/* get range of data to mix */
-				c = mixbuffer;
-				q = dsp->rx_buff;
-				r = dsp->rx_R;
-				rr = (r + length) & CMX_BUFF_MASK;
-				/* add member's data */
-				while (r != rr) {
-					*c++ += dsp_audio_law_to_s32[q[r]];
-					r = (r + 1) & CMX_BUFF_MASK;
-				}
+			/* get range of data to mix */
+			c = mixbuffer;
+			q = dsp->rx_buff;
+			r = dsp->rx_R;
+			rr = (r + conf->cmx_len) & CMX_BUFF_MASK;
+			/* add member's data */
+			while (r != rr) {
+				*c++ += dsp_audio_law_to_s32[q[r]];
+				r = (r + 1) & CMX_BUFF_MASK;
 			}
+		}
 
-			/* process each member */
+		/* one recording stream for the whole conference */
+		if (conf->record)
+			dsp_cmx_record(conf, mixbuffer, conf->cmx_len,
+				       members);
+
+		/* process each member */
+		if (mustmix) {
 			list_for_each_entry(member, &conf->mlist, list) {
 				/* transmission */
-				dsp_cmx_send_member(member->dsp, length,
+				dsp_cmx_send_member(member->dsp, conf->cmx_len,
 						    mixbuffer, members);
 			}
 		}
@@ -1735,12 +1942,14 @@ dsp_cmx_send(void *arg)
 	list_for_each_entry(dsp, &dsp_ilist, list) {
 		if (dsp->hdlc)
 			continue;
+		if (!busy)
+			busy = dsp_cmx_need_tick(dsp);
 		p = dsp->rx_buff;
 		q = dsp->tx_buff;
 		r = dsp->rx_R;
 		/* move receive pointer when receiving */
 		if (!dsp->rx_is_off) {
-			rr = (r + length) & CMX_BUFF_MASK;
+			rr = (r + dsp->cmx_len) & CMX_BUFF_MASK;
 			/* delete rx-data */
 			while (r != rr) {
 				p[r] = dsp_silence;
@@ -1840,6 +2049,17 @@ dsp_cmx_send(void *arg)
 		}
 	}
 
+	/* stop the tick if nobody needs it */
+	if (!busy) {
+		dsp_tick_running = 0;
+		dsp_tick_stopped = jiffies;
+		dsp_count_valid = 0;
+		if (dsp_debug & DEBUG_DSP_CLOCK)
+			printk(KERN_DEBUG "%s: tick stopped\n", __func__);
+		spin_unlock_irqrestore(&dsp_lock, flags);
+		return;
+	}
+
 	/* if next event would be in the past ... */
 	if ((s32)(dsp_spl_jiffies + dsp_tics-jiffies) <= 0)
 		dsp_spl_jiffies = jiffies + 1;
@@ -1907,6 +2127,7 @@ dsp_cmx_transmit(struct dsp *dsp, struct sk_buff *skb)
 	printk(KERN_DEBUG "%s\n", debugbuf);
 #endif
 
+	dsp_cmx_tick_wake();
 }
 
 /*
@@ -111,6 +111,15 @@
  * Echo: Is generated by CMX and is used to check performance of hard and
  * software CMX.
  *
+ * Latency: DSP_LATENCY_MEASURE sends a marker in the next tx frame and
+ * reports the loop delay in samples once it comes back on rx (see
+ * dsp_latency.c). Results are also listed in debugfs mISDN_dsp/latency.
+ *
+ * Recording: DSP_CONF_RECORD on one member indicates the mix of the whole
+ * conference once per frame, optionally followed by each member's receive
+ * data. This replaces tx-data on every member and mixing in user space.
+ * The conference stays in hardware, if possible, with software receive.
+ *
  * The CMX has special functions for conferences with one, two and more
  * members. It will allow different types of data flow. Receive and transmit
  * data to/form upper layer may be switched on/off individually without losing
@@ -151,11 +160,13 @@
  *
  */
 
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/gfp.h>
 #include <linux/mISDNif.h>
 #include <linux/mISDNdsp.h>
 #include <linux/module.h>
+#include <linux/seq_file.h>
 #include <linux/vmalloc.h>
 #include "core.h"
 #include "dsp.h"
@@ -166,12 +177,32 @@ static int debug;
 static int options;
 static int poll;
 static int dtmfthreshold = 100;
+static int pool; /* preallocated dsp instances */
+
+static int dsp_running; /* set once dsp_init() applied the options */
+
+DEFINE_STATIC_KEY_TRUE(dsp_key_volume);
+#ifdef CONFIG_MISDN_DSP_BLOWFISH
+DEFINE_STATIC_KEY_TRUE(dsp_key_blowfish);
+#endif
+#ifdef CONFIG_MISDN_DSP_PIPELINE
+DEFINE_STATIC_KEY_TRUE(dsp_key_pipeline);
+#endif
+
+static int options_set(const char *val, const struct kernel_param *kp);
+
+static const struct kernel_param_ops options_ops = {
+	.set = options_set,
+	.get = param_get_uint,
+};
 
 MODULE_AUTHOR("Andreas Eversberg");
 module_param(debug, uint, S_IRUGO | S_IWUSR);
-module_param(options, uint, S_IRUGO | S_IWUSR);
+module_param_cb(options, &options_ops, &options, S_IRUGO | S_IWUSR);
 module_param(poll, uint, S_IRUGO | S_IWUSR);
 module_param(dtmfthreshold, uint, S_IRUGO | S_IWUSR);
+module_param(pool, uint, S_IRUGO);
+MODULE_PARM_DESC(pool, "number of dsp instances kept for reuse");
 MODULE_LICENSE("GPL");
 
 /*int spinnest = 0;*/
@@ -183,6 +214,163 @@ int dsp_debug;
 int dsp_options;
 int dsp_poll, dsp_tics;
 
+struct dentry *dsp_debugfs; /* mISDN_dsp directory */
+EXPORT_SYMBOL(dsp_debugfs); /* echo canceller elements add their files */
+
+/*
+ * pool of free dsp instances, reuse costs one memset instead of the
+ * vmalloc mapping and the TLB flush of vfree
+ */
+static DEFINE_SPINLOCK(dsp_pool_lock);
+static LIST_HEAD(dsp_pool);
+static int dsp_pool_count;
+
+/* create and release times for debugfs, protected by dsp_pool_lock */
+struct dsp_setup_stat {
+	u_int	count;
+	u_int	pooled; /* served from or returned to the pool */
+	u64	total_ns;
+	u64	max_ns;
+};
+static struct dsp_setup_stat dsp_stat_create, dsp_stat_release;
+
+static struct dsp *
+dsp_alloc(int *pooled)
+{
+	struct dsp *dsp = NULL;
+	u_long flags;
+
+	spin_lock_irqsave(&dsp_pool_lock, flags);
+	if (!list_empty(&dsp_pool)) {
+		dsp = list_first_entry(&dsp_pool, struct dsp, list);
+		list_del(&dsp->list);
+		dsp_pool_count--;
+	}
+	spin_unlock_irqrestore(&dsp_pool_lock, flags);
+	*pooled = !!dsp;
+	if (dsp)
+		memset(dsp, 0, sizeof(*dsp));
+	else
+		dsp = vzalloc(sizeof(struct dsp));
+	return dsp;
+}
+
+/* returns 1 if the instance was kept in the pool */
+static int
+dsp_free(struct dsp *dsp)
+{
+	u_long flags;
+
+	spin_lock_irqsave(&dsp_pool_lock, flags);
+	if (dsp_pool_count < pool) {
+		list_add(&dsp->list, &dsp_pool);
+		dsp_pool_count++;
+		dsp = NULL;
+	}
+	spin_unlock_irqrestore(&dsp_pool_lock, flags);
+	if (!dsp)
+		return 1;
+	vfree(dsp);
+	return 0;
+}
+
+static void
+dsp_pool_release(void)
+{
+	struct dsp *dsp, *next;
+
+	pool = 0;
+	list_for_each_entry_safe(dsp, next, &dsp_pool, list) {
+		list_del(&dsp->list);
+		vfree(dsp);
+	}
+	dsp_pool_count = 0;
+}
+
+static void
+dsp_setup_time(struct dsp_setup_stat *st, u64 start, int pooled)
+{
+	u64 ns = ktime_get_ns() - start;
+	u_long flags;
+
+	spin_lock_irqsave(&dsp_pool_lock, flags);
+	st->count++;
+	st->pooled += pooled;
+	st->total_ns += ns;
+	if (ns > st->max_ns)
+		st->max_ns = ns;
+	spin_unlock_irqrestore(&dsp_pool_lock, flags);
+}
+
+/*
+ * switch the runtime option bits (DSP_OPT_RUNTIME) to the given value
+ * a feature is only turned off if no channel uses it, the option bit is
+ * set before the static key is patched out, and cleared after it is
+ * patched in, so the control requests can test the bit under dsp_lock
+ */
+static int
+dsp_set_features(u_int opt)
+{
+	struct dsp *dsp;
+	u_int off;
+	u_long flags;
+
+	spin_lock_irqsave(&dsp_lock, flags);
+	off = opt & DSP_OPT_RUNTIME & ~dsp_options;
+	list_for_each_entry(dsp, &dsp_ilist, list) {
+		if (((off & DSP_OPT_NOBLOWFISH) && dsp->bf_enable) ||
+		    ((off & DSP_OPT_NOPIPELINE) && dsp->pipeline.inuse) ||
+		    ((off & DSP_OPT_NOVOLUME) &&
+		     (dsp->tx_volume || dsp->rx_volume))) {
+			spin_unlock_irqrestore(&dsp_lock, flags);
+			return -EBUSY;
+		}
+	}
+	dsp_options |= off;
+	spin_unlock_irqrestore(&dsp_lock, flags);
+
+	if (opt & DSP_OPT_NOVOLUME)
+		static_branch_disable(&dsp_key_volume);
+	else
+		static_branch_enable(&dsp_key_volume);
+#ifdef CONFIG_MISDN_DSP_BLOWFISH
+	if (opt & DSP_OPT_NOBLOWFISH)
+		static_branch_disable(&dsp_key_blowfish);
+	else
+		static_branch_enable(&dsp_key_blowfish);
+#endif
+#ifdef CONFIG_MISDN_DSP_PIPELINE
+	if (opt & DSP_OPT_NOPIPELINE)
+		static_branch_disable(&dsp_key_pipeline);
+	else
+		static_branch_enable(&dsp_key_pipeline);
+#endif
+
+	spin_lock_irqsave(&dsp_lock, flags);
+	dsp_options &= ~(DSP_OPT_RUNTIME & ~opt);
+	spin_unlock_irqrestore(&dsp_lock, flags);
+	return 0;
+}
+
+/* law and hardware bits are only used when loading */
+static int
+options_set(const char *val, const struct kernel_param *kp)
+{
+	u_int opt;
+	int ret;
+
+	ret = kstrtouint(val, 0, &opt);
+	if (ret)
+		return ret;
+	if (dsp_running) {
+		ret = dsp_set_features(opt);
+		if (ret)
+			return ret;
+	}
+	options = opt;
+	return 0;
+}
+
 /* check if rx may be turned off or must be turned on */
 static void
 dsp_rx_off_member(struct dsp *dsp)
@@ -250,6 +438,36 @@ dsp_rx_off(struct dsp *dsp)
 	}
 }
 
+/*
+ * hand the volumes to the hardware, so that hardware bridging, conference
+ * and DTMF stay possible, if a volume is changed
+ */
+static void
+dsp_hw_gain(struct dsp *dsp)
+{
+	struct mISDN_ctrl_req	cq;
+
+	dsp->hw_gain = 0;
+	if (!dsp->features_gain || !dsp->ch.peer)
+		return;
+	memset(&cq, 0, sizeof(cq));
+	cq.op = MISDN_CTRL_GAIN;
+	cq.p1 = dsp->tx_volume;
+	cq.p2 = dsp->rx_volume;
+	if (dsp->ch.peer->ctrl(dsp->ch.peer, CONTROL_CHANNEL, &cq)) {
+		if (dsp_debug & DEBUG_DSP_CORE)
+			printk(KERN_DEBUG "%s: %s gain tx %d rx %d not "
+			       "supported by hardware\n", __func__, dsp->name,
+			       dsp->tx_volume, dsp->rx_volume);
+		/* remove former gain */
+		cq.p1 = 0;
+		cq.p2 = 0;
+		dsp->ch.peer->ctrl(dsp->ch.peer, CONTROL_CHANNEL, &cq);
+		return;
+	}
+	dsp->hw_gain = 1;
+}
+
 /* enable "fill empty" feature */
 static void
 dsp_fill_empty(struct dsp *dsp)
@@ -277,6 +495,28 @@ dsp_fill_empty(struct dsp *dsp)
 		       __func__, dsp->name);
 }
 
+/*
+ * tx samples ahead of the received frame for echo cancelation: the tx fifo
+ * level if the driver reports it in hh->id, plus what the dsp sent since
+ * the frame was received, if the frame is stamped
+ */
+static unsigned int
+dsp_rx_txlen(struct sk_buff *skb)
+{
+	struct mISDNstamp *st = mISDN_STAMP_P(skb);
+	unsigned int txlen = mISDN_HEAD_ID(skb);
+	u16 age;
+
+	if (!st->valid)
+		return txlen;
+	if (txlen > 0xf000)
+		txlen = 0;
+	age = mISDN_clock_get() - st->first - skb->len;
+	if (age < 0xf000)
+		txlen += age;
+	return txlen;
+}
+
 static int
 dsp_control_req(struct dsp *dsp, struct mISDNhead *hh, struct sk_buff *skb)
 {
@@ -320,6 +560,8 @@ dsp_control_req(struct dsp *dsp, struct mISDNhead *hh, struct sk_buff *skb)
 		if (dsp_debug & DEBUG_DSP_CORE)
 			printk(KERN_DEBUG "%s: stop dtmf\n", __func__);
 		dsp->dtmf.enable = 0;
+		if (dsp->dtmf.hardware)
+			dsp_dtmf_hw_message(dsp, 0);
 		dsp->dtmf.hardware = 0;
 		dsp->dtmf.software = 0;
 		break;
@@ -389,6 +631,10 @@ dsp_control_req(struct dsp *dsp, struct mISDNhead *hh, struct sk_buff *skb)
 			ret = -EINVAL;
 			break;
 		}
+		if (dsp_options & DSP_OPT_NOVOLUME) {
+			ret = -EOPNOTSUPP;
+			break;
+		}
 		if (len < sizeof(int)) {
 			ret = -EINVAL;
 			break;
@@ -397,6 +643,7 @@ dsp_control_req(struct dsp *dsp, struct mISDNhead *hh, struct sk_buff *skb)
 		if (dsp_debug & DEBUG_DSP_CORE)
 			printk(KERN_DEBUG "%s: change tx vol to %d\n",
 			       __func__, dsp->tx_volume);
+		dsp_hw_gain(dsp);
 		dsp_cmx_hardware(dsp->conf, dsp);
 		dsp_dtmf_hardware(dsp);
 		dsp_rx_off(dsp);
@@ -406,6 +653,10 @@ dsp_control_req(struct dsp *dsp, struct mISDNhead *hh, struct sk_buff *skb)
 			ret = -EINVAL;
 			break;
 		}
+		if (dsp_options & DSP_OPT_NOVOLUME) {
+			ret = -EOPNOTSUPP;
+			break;
+		}
 		if (len < sizeof(int)) {
 			ret = -EINVAL;
 			break;
@@ -414,6 +665,7 @@ dsp_control_req(struct dsp *dsp, struct mISDNhead *hh, struct sk_buff *skb)
 		if (dsp_debug & DEBUG_DSP_CORE)
 			printk(KERN_DEBUG "%s: change rx vol to %d\n",
 			       __func__, dsp->tx_volume);
+		dsp_hw_gain(dsp);
 		dsp_cmx_hardware(dsp->conf, dsp);
 		dsp_dtmf_hardware(dsp);
 		dsp_rx_off(dsp);
@@ -497,6 +749,21 @@ dsp_control_req(struct dsp *dsp, struct mISDNhead *hh, struct sk_buff *skb)
 		if (dsp_debug & DEBUG_DSP_CMX)
 			dsp_cmx_debug(dsp);
 		break;
+	case DSP_CONF_RECORD: /* indicate conference mix */
+		if (len < sizeof(int)) {
+			ret = -EINVAL;
+			break;
+		}
+		dsp->record = *((int *)data) &
+			(DSP_RECORD_MIX | DSP_RECORD_MEMBERS);
+		if (dsp_debug & DEBUG_DSP_CORE)
+			printk(KERN_DEBUG "%s: conference record 0x%x\n",
+			       __func__, dsp->record);
+		dsp_cmx_hardware(dsp->conf, dsp);
+		dsp_rx_off(dsp);
+		if (dsp_debug & DEBUG_DSP_CMX)
+			dsp_cmx_debug(dsp);
+		break;
 	case DSP_DELAY: /* use delay algorithm instead of dynamic
 			   jitter algorithm */
 		if (dsp->hdlc) {
@@ -549,11 +816,43 @@ dsp_control_req(struct dsp *dsp, struct mISDNhead *hh, struct sk_buff *skb)
 			printk(KERN_DEBUG "%s: use TX buffer without "
 			       "dejittering\n", __func__);
 		break;
+	case DSP_LATENCY_MEASURE: /* send marker, report DSP_LATENCY_RESULT */
+		if (dsp->hdlc) {
+			ret = -EINVAL;
+			break;
+		}
+		if (dsp_debug & DEBUG_DSP_CORE)
+			printk(KERN_DEBUG "%s: start latency measurement\n",
+			       __func__);
+		dsp_latency_start(dsp);
+		break;
+	case DSP_CMX_FRAME: /* tx frame size in samples, 0 = each tick */
+		if (dsp->hdlc) {
+			ret = -EINVAL;
+			break;
+		}
+		if (len < sizeof(int)) {
+			ret = -EINVAL;
+			break;
+		}
+		dsp->cmx_frame = *((int *)data);
+		if (dsp->cmx_frame < 0)
+			dsp->cmx_frame = 0;
+		if (dsp->cmx_frame > MAX_POLL)
+			dsp->cmx_frame = MAX_POLL;
+		if (dsp_debug & DEBUG_DSP_CORE)
+			printk(KERN_DEBUG "%s: tx frame size %d samples\n",
+			       __func__, dsp->cmx_frame);
+		break;
 	case DSP_PIPELINE_CFG:
 		if (dsp->hdlc) {
 			ret = -EINVAL;
 			break;
 		}
+		if (!dsp_use_pipeline() || (dsp_options & DSP_OPT_NOPIPELINE)) {
+			ret = -EOPNOTSUPP;
+			break;
+		}
 		if (len > 0 && ((char *)data)[len - 1]) {
 			printk(KERN_DEBUG "%s: pipeline config string "
 			       "is not NULL terminated!\n", __func__);
@@ -579,7 +878,10 @@ dsp_control_req(struct dsp *dsp, struct mISDNhead *hh, struct sk_buff *skb)
 		if (dsp_debug & DEBUG_DSP_CORE)
 			printk(KERN_DEBUG "%s: turn blowfish on (key "
 			       "not shown)\n", __func__);
-		ret = dsp_bf_init(dsp, (u8 *)data, len);
+		if (!dsp_use_blowfish() || (dsp_options & DSP_OPT_NOBLOWFISH))
+			ret = -EOPNOTSUPP;
+		else
+			ret = dsp_bf_init(dsp, (u8 *)data, len);
 		/* set new cont */
 		if (!ret)
 			cont = DSP_BF_ACCEPT;
@@ -647,6 +949,8 @@ get_features(struct mISDNchannel *ch)
 		dsp->features_fill_empty = 1;
 	if (dsp_options & DSP_OPT_NOHARDWARE)
 		return;
+	if (cq.op & MISDN_CTRL_GAIN)
+		dsp->features_gain = 1;
 	if ((cq.op & MISDN_CTRL_HW_FEATURES_OP)) {
 		cq.op = MISDN_CTRL_HW_FEATURES;
 		*((u_long *)&cq.p1) = (u_long)&dsp->features;
@@ -667,6 +971,8 @@ dsp_function(struct mISDNchannel *ch,  struct sk_buff *skb)
 	struct mISDNhead	*hh;
 	int			ret = 0;
 	u8			*digits = NULL;
+	int			lat_report = 0;
+	int			fpu = 0;
 	u_long			flags;
 
 	hh = mISDN_HEAD_P(skb);
@@ -709,23 +1015,39 @@ dsp_function(struct mISDNchannel *ch,  struct sk_buff *skb)
 			break;
 		}
 
+		/* vector echo cancelers need the FPU, not under dsp_lock */
+		if (dsp_use_pipeline())
+			fpu = dsp_pipeline_fpu_begin(&dsp->pipeline);
 		spin_lock_irqsave(&dsp_lock, flags);
 
 		/* decrypt if enabled */
-		if (dsp->bf_enable)
+		if (dsp_use_blowfish() && dsp->bf_enable)
 			dsp_bf_decrypt(dsp, skb->data, skb->len);
 		/* pipeline */
-		if (dsp->pipeline.inuse)
+		if (dsp_use_pipeline() && dsp->pipeline.inuse)
 			dsp_pipeline_process_rx(&dsp->pipeline, skb->data,
-						skb->len, hh->id);
+						skb->len, dsp_rx_txlen(skb),
+						fpu);
+		/* idle detection, the card also fills gaps with silence */
+		dsp->rx_samples += skb->len;
+		if (memchr_inv(skb->data, dsp_silence, skb->len)) {
+			dsp->rx_idle_run = 0;
+		} else {
+			dsp->rx_idle_samples += skb->len;
+			if (dsp->rx_idle_run < CMX_BUFF_SIZE)
+				dsp->rx_idle_run += skb->len;
+		}
 		/* change volume if requested */
-		if (dsp->rx_volume)
+		if (dsp_use_volume() && dsp->rx_volume && !dsp_rx_idle(dsp))
 			dsp_change_volume(skb, dsp->rx_volume);
 		/* check if dtmf soft decoding is turned on */
-		if (dsp->dtmf.software) {
+		if (dsp->dtmf.software && !dsp_rx_idle(dsp)) {
 			digits = dsp_dtmf_goertzel_decode(dsp, skb->data,
 							  skb->len, (dsp_options & DSP_OPT_ULAW) ? 1 : 0);
 		}
+		/* look for the latency marker before cmx buffers the data */
+		if (dsp->latency.state == DSP_LAT_WAIT)
+			lat_report = dsp_latency_rx(dsp, skb->data, skb->len);
 		/* we need to process receive data if software */
 		if (dsp->conf && dsp->conf->software) {
 			/* process data from card at cmx */
@@ -733,6 +1055,10 @@ dsp_function(struct mISDNchannel *ch,  struct sk_buff *skb)
 		}
 
 		spin_unlock_irqrestore(&dsp_lock, flags);
+		dsp_pipeline_fpu_end(fpu);
+
+		if (lat_report)
+			dsp_latency_report(dsp);
 
 		/* send dtmf result, if any */
 		if (digits) {
@@ -804,16 +1130,36 @@ dsp_function(struct mISDNchannel *ch,  struct sk_buff *skb)
 				digits++;
 			}
 			break;
+		case (DTMF_TONE_VAL): /* digit decoded by the card */
+			if (!dsp->dtmf.hardware || skb->len != sizeof(int)) {
+				if (dsp_debug & DEBUG_DSP_DTMFCOEFF)
+					printk(KERN_DEBUG "%s: ignoring DTMF "
+					       "digit from HFC\n", __func__);
+				break;
+			}
+			if (dsp_debug & DEBUG_DSP_DTMF)
+				printk(KERN_DEBUG "%s: digit(%c) to layer %s\n",
+				       __func__, *((int *)skb->data) &
+				       DTMF_TONE_MASK, dsp->name);
+			hh->id = MISDN_ID_ANY;
+			if (dsp->up)
+				return dsp->up->send(dsp->up, skb);
+			break;
 		case (HFC_VOL_CHANGE_TX): /* change volume */
 			if (skb->len != sizeof(int)) {
 				ret = -EINVAL;
 				break;
 			}
+			if (dsp_options & DSP_OPT_NOVOLUME) {
+				ret = -EOPNOTSUPP;
+				break;
+			}
 			spin_lock_irqsave(&dsp_lock, flags);
 			dsp->tx_volume = *((int *)skb->data);
 			if (dsp_debug & DEBUG_DSP_CORE)
 				printk(KERN_DEBUG "%s: change tx volume to "
 				       "%d\n", __func__, dsp->tx_volume);
+			dsp_hw_gain(dsp);
 			dsp_cmx_hardware(dsp->conf, dsp);
 			dsp_dtmf_hardware(dsp);
 			dsp_rx_off(dsp);
@@ -843,6 +1189,7 @@ dsp_function(struct mISDNchannel *ch,  struct sk_buff *skb)
 		dsp_cmx_hardware(dsp->conf, dsp);
 		dsp_dtmf_hardware(dsp);
 		dsp_rx_off(dsp);
+		dsp_cmx_tick_wake();
 		spin_unlock_irqrestore(&dsp_lock, flags);
 		if (dsp_debug & DEBUG_DSP_CORE)
 			printk(KERN_DEBUG "%s: done with activation, sending "
@@ -899,6 +1246,7 @@ dsp_function(struct mISDNchannel *ch,  struct sk_buff *skb)
 	case (PH_CONTROL_REQ):
 		spin_lock_irqsave(&dsp_lock, flags);
 		ret = dsp_control_req(dsp, hh, skb);
+		dsp_cmx_tick_wake();
 		spin_unlock_irqrestore(&dsp_lock, flags);
 		break;
 	case (DL_ESTABLISH_REQ):
@@ -953,7 +1301,8 @@ dsp_ctrl(struct mISDNchannel *ch, u_int cmd, void *arg)
 {
 	struct dsp		*dsp = container_of(ch, struct dsp, ch);
 	u_long		flags;
-	int		err = 0;
+	int		err = 0, pooled;
+	u64		start;
 
 	if (debug & DEBUG_DSP_CTRL)
 		printk(KERN_DEBUG "%s:(%x)\n", __func__, cmd);
@@ -962,6 +1311,7 @@ dsp_ctrl(struct mISDNchannel *ch, u_int cmd, void *arg)
 	case OPEN_CHANNEL:
 		break;
 	case CLOSE_CHANNEL:
+		start = ktime_get_ns();
 		if (dsp->ch.peer)
 			dsp->ch.peer->ctrl(dsp->ch.peer, CLOSE_CHANNEL, NULL);
 
@@ -994,7 +1344,8 @@ dsp_ctrl(struct mISDNchannel *ch, u_int cmd, void *arg)
 		if (dsp_debug & DEBUG_DSP_CTRL)
 			printk(KERN_DEBUG "%s: dsp instance released\n",
 			       __func__);
-		vfree(dsp);
+		pooled = dsp_free(dsp);
+		dsp_setup_time(&dsp_stat_release, start, pooled);
 		module_put(THIS_MODULE);
 		break;
 	}
@@ -1023,8 +1374,8 @@ dsp_send_bh(struct work_struct *work)
 			continue;
 		}
 		hh = mISDN_HEAD_P(skb);
-		if (hh->prim == DL_DATA_REQ) {
-			/* send packet up */
+		if (hh->prim == DL_DATA_REQ || hh->prim == PH_CONTROL_IND) {
+			/* send packet up (tx data or conference record) */
 			if (dsp->up) {
 				if (dsp->up->send(dsp->up, skb))
 					dev_kfree_skb(skb);
@@ -1049,11 +1400,13 @@ dspcreate(struct channel_req *crq)
 {
 	struct dsp		*ndsp;
 	u_long		flags;
+	u64		start = ktime_get_ns();
+	int		pooled;
 
 	if (crq->protocol != ISDN_P_B_L2DSP
 	    && crq->protocol != ISDN_P_B_L2DSPHDLC)
 		return -EPROTONOSUPPORT;
-	ndsp = vzalloc(sizeof(struct dsp));
+	ndsp = dsp_alloc(&pooled);
 	if (!ndsp) {
 		printk(KERN_ERR "%s: vmalloc struct dsp failed\n", __func__);
 		return -ENOMEM;
@@ -1102,6 +1455,7 @@ dspcreate(struct channel_req *crq)
 	list_add_tail(&ndsp->list, &dsp_ilist);
 	spin_unlock_irqrestore(&dsp_lock, flags);
 
+	dsp_setup_time(&dsp_stat_create, start, pooled);
 	return 0;
 }
 
@@ -1113,6 +1467,128 @@ static struct Bprotocol DSP = {
 	.create = dspcreate
 };
 
+/*
+ * debugfs mISDN_dsp/idle: received and silent samples of each channel
+ */
+static int
+dsp_idle_show(struct seq_file *m, void *v)
+{
+	struct dsp *dsp;
+	u_long flags;
+	u64 ratio;
+
+	seq_puts(m, "# name rx idle ratio(%) (samples)\n");
+	spin_lock_irqsave(&dsp_lock, flags);
+	list_for_each_entry(dsp, &dsp_ilist, list) {
+		if (dsp->hdlc)
+			continue;
+		ratio = 0;
+		if (dsp->rx_samples)
+			ratio = div64_u64(dsp->rx_idle_samples * 100,
+					  dsp->rx_samples);
+		seq_printf(m, "%s %llu %llu %llu\n", dsp->name,
+			   dsp->rx_samples, dsp->rx_idle_samples, ratio);
+	}
+	spin_unlock_irqrestore(&dsp_lock, flags);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(dsp_idle);
+
+/*
+ * debugfs mISDN_dsp/setup: time spent in dspcreate() and CLOSE_CHANNEL
+ */
+static void
+dsp_setup_print(struct seq_file *m, const char *name,
+		struct dsp_setup_stat *st)
+{
+	seq_printf(m, "%s %u %u %llu %llu\n", name, st->count, st->pooled,
+		   st->count ? div_u64(st->total_ns, st->count) : 0,
+		   st->max_ns);
+}
+
+static int
+dsp_setup_show(struct seq_file *m, void *v)
+{
+	struct dsp_setup_stat create, release;
+	u_long flags;
+	int free;
+
+	spin_lock_irqsave(&dsp_pool_lock, flags);
+	create = dsp_stat_create;
+	release = dsp_stat_release;
+	free = dsp_pool_count;
+	spin_unlock_irqrestore(&dsp_pool_lock, flags);
+	seq_printf(m, "# pool %d of %d free\n", free, pool);
+	seq_puts(m, "# op count pooled avg max (ns)\n");
+	dsp_setup_print(m, "create", &create);
+	dsp_setup_print(m, "release", &release);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(dsp_setup);
+
+/*
+ * ticks done and skipped while no dsp needed them, for debugfs
+ * mISDN_dsp/tick and netlink
+ */
+static void
+dsp_get_tick(struct mISDN_dsptick *t)
+{
+	u_long flags;
+
+	spin_lock_irqsave(&dsp_lock, flags);
+	t->running = dsp_tick_running;
+	t->ticks = dsp_tick_count;
+	t->skipped = dsp_tick_skipped;
+	if (!t->running)
+		t->skipped += (jiffies - dsp_tick_stopped) / dsp_tics;
+	spin_unlock_irqrestore(&dsp_lock, flags);
+}
+
+static int
+dsp_tick_show(struct seq_file *m, void *v)
+{
+	struct mISDN_dsptick t;
+
+	dsp_get_tick(&t);
+	seq_printf(m, "running %u\nticks %llu\nskipped %llu\n", t.running,
+		   t.ticks, t.skipped);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(dsp_tick);
+
+/* latency and idle statistics of the index'th dsp for netlink */
+static int
+dsp_get_stats(u_int index, struct mISDN_dspstats *st)
+{
+	struct dsp *dsp;
+	u_long flags;
+	int ret = -ENOENT;
+
+	spin_lock_irqsave(&dsp_lock, flags);
+	list_for_each_entry(dsp, &dsp_ilist, list) {
+		if (index--)
+			continue;
+		memcpy(st->name, dsp->name, sizeof(st->name));
+		st->rx_samples = dsp->rx_samples;
+		st->rx_idle_samples = dsp->rx_idle_samples;
+		st->latency_count = dsp->latency.count;
+		st->latency_lost = dsp->latency.lost;
+		st->latency_last = dsp->latency.last;
+		st->latency_min = dsp->latency.min;
+		st->latency_max = dsp->latency.max;
+		st->latency_cmx = dsp->latency.cmx;
+		ret = 0;
+		break;
+	}
+	spin_unlock_irqrestore(&dsp_lock, flags);
+	return ret;
+}
+
+static const struct mISDN_nl_dsp_ops dsp_nl_ops = {
+	.tick = dsp_get_tick,
+	.stats = dsp_get_stats,
+};
+
 static int __init dsp_init(void)
 {
 	int err;
@@ -1174,6 +1650,10 @@ static int __init dsp_init(void)
 	INIT_LIST_HEAD(&dsp_ilist);
 	INIT_LIST_HEAD(&conf_ilist);
 
+	/* patch out the features disabled by options */
+	dsp_set_features(options);
+	dsp_running = 1;
+
 	/* init conversion tables */
 	dsp_audio_generate_law_tables();
 	dsp_silence = (dsp_options & DSP_OPT_ULAW) ? 0xff : 0x2a;
@@ -1193,16 +1673,39 @@ static int __init dsp_init(void)
 		return err;
 	}
 
+	/* fill the pool */
+	while (dsp_pool_count < pool) {
+		struct dsp *dsp = vzalloc(sizeof(struct dsp));
+
+		if (!dsp) {
+			printk(KERN_WARNING "mISDN_dsp: dsp pool has only %d "
+			       "of %d instances\n", dsp_pool_count, pool);
+			break;
+		}
+		list_add(&dsp->list, &dsp_pool);
+		dsp_pool_count++;
+	}
+
 	err = mISDN_register_Bprotocol(&DSP);
 	if (err) {
 		printk(KERN_ERR "Can't register %s error(%d)\n", DSP.name, err);
+		dsp_pool_release();
 		return err;
 	}
 
+	dsp_debugfs = debugfs_create_dir("mISDN_dsp", NULL);
+	dsp_latency_init();
+	debugfs_create_file("idle", 0444, dsp_debugfs, NULL, &dsp_idle_fops);
+	debugfs_create_file("setup", 0444, dsp_debugfs, NULL,
+			    &dsp_setup_fops);
+	debugfs_create_file("tick", 0444, dsp_debugfs, NULL, &dsp_tick_fops);
+	mISDN_nl_register_dsp(&dsp_nl_ops);
+
 	/* set sample timer */
 	timer_setup(&dsp_spl_tl, (void *)dsp_cmx_send, 0);
 	dsp_spl_tl.expires = jiffies + dsp_tics;
 	dsp_spl_jiffies = dsp_spl_tl.expires;
+	dsp_tick_running = 1;
 	add_timer(&dsp_spl_tl);
 
 	return 0;
@@ -1211,10 +1714,13 @@ static int __init dsp_init(void)
 
 static void __exit dsp_cleanup(void)
 {
+	mISDN_nl_unregister_dsp();
 	mISDN_unregister_Bprotocol(&DSP);
 
 	del_timer_sync(&dsp_spl_tl);
 
+	debugfs_remove_recursive(dsp_debugfs);
+
 	if (!list_empty(&dsp_ilist)) {
 		printk(KERN_ERR "mISDN_dsp: Audio DSP object inst list not "
 		       "empty.\n");
@@ -1225,6 +1731,7 @@ static void __exit dsp_cleanup(void)
 	}
 
 	dsp_pipeline_module_exit();
+	dsp_pool_release();
 }
 
 module_init(dsp_init);
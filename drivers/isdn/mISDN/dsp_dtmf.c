@@ -45,6 +45,21 @@ void dsp_dtmf_goertzel_init(struct dsp *dsp)
 	dsp->dtmf.count = 0;
 }
 
+/* tell the card whether it must do DTMF detection on this channel, so it
+ * only reads the coefficients of channels that use them
+ */
+void dsp_dtmf_hw_message(struct dsp *dsp, int on)
+{
+	struct mISDN_ctrl_req cq;
+
+	if (!dsp->ch.peer || !dsp->features.hfc_dtmf)
+		return;
+	memset(&cq, 0, sizeof(cq));
+	cq.op = on ? MISDN_CTRL_HFC_DTMF_ON : MISDN_CTRL_HFC_DTMF_OFF;
+	cq.p1 = dsp->dtmf.treshold;
+	dsp->ch.peer->ctrl(dsp->ch.peer, CONTROL_CHANNEL, &cq);
+}
+
 /* check for hardware or software features
  */
 void dsp_dtmf_hardware(struct dsp *dsp)
@@ -57,15 +72,15 @@ void dsp_dtmf_hardware(struct dsp *dsp)
 	if (!dsp->features.hfc_dtmf)
 		hardware = 0;
 
-	/* check for volume change */
-	if (dsp->tx_volume) {
+	/* check for volume change, unless done by hardware */
+	if (dsp->tx_volume && !dsp->hw_gain) {
 		if (dsp_debug & DEBUG_DSP_DTMF)
 			printk(KERN_DEBUG "%s dsp %s cannot do hardware DTMF, "
 			       "because tx_volume is changed\n",
 			       __func__, dsp->name);
 		hardware = 0;
 	}
-	if (dsp->rx_volume) {
+	if (dsp->rx_volume && !dsp->hw_gain) {
 		if (dsp_debug & DEBUG_DSP_DTMF)
 			printk(KERN_DEBUG "%s dsp %s cannot do hardware DTMF, "
 			       "because rx_volume is changed\n",
@@ -89,6 +104,8 @@ void dsp_dtmf_hardware(struct dsp *dsp)
 		hardware = 0;
 	}
 
+	if (hardware || dsp->dtmf.hardware)
+		dsp_dtmf_hw_message(dsp, hardware);
 	dsp->dtmf.hardware = hardware;
 	dsp->dtmf.software = !hardware;
 }
@@ -0,0 +1,279 @@
+/*
+ * dsp_eccore.h: FIR and coefficient update core shared by the mark2
+ * family of echo cancellers (mec2, kb1ec and mg2ec)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ */
+
+#ifndef _DSP_ECCORE_H
+#define _DSP_ECCORE_H
+
+/* Get optimized routines for math */
+#include "dsp_arith.h"
+
+#ifdef CONFIG_MISDN_DSP_EC_SIMD
+#include <linux/random.h>
+#ifdef CONFIG_X86_64
+#include <asm/cpufeature.h>
+#include <asm/fpu/api.h>
+#endif
+#ifdef CONFIG_ARM64
+#include <asm/cpufeature.h>
+#include <asm/neon.h>
+#endif
+#endif
+
+/*
+ * Mirrored history buffer: every sample is stored at idx_d and at
+ * idx_d + size_d, so buf_d + idx_d always points to size_d contiguous
+ * samples, newest first, and the kernels never have to wrap.
+ */
+struct echo_can_cb_s {
+	/* Pointer to the relative 'start' of the buffer */
+	int idx_d;
+	/* The absolute size of the buffer */
+	int size_d;
+	/* The actual samples - twice as large as size_d */
+	short *buf_d;
+};
+
+static inline void init_cb_s(struct echo_can_cb_s *cb, int len, void *where)
+{
+	cb->buf_d = (short *)where;
+	cb->idx_d = 0;
+	cb->size_d = len;
+}
+
+static inline void add_cc_s(struct echo_can_cb_s *cb, short newval)
+{
+	/* Can't use modulus because N+M isn't a power of two (generally) */
+	cb->idx_d--;
+	if (cb->idx_d < (int)0)
+		cb->idx_d += cb->size_d;
+
+	/* Load two copies into memory */
+	cb->buf_d[cb->idx_d] = newval;
+	cb->buf_d[cb->idx_d + cb->size_d] = newval;
+}
+
+static inline short get_cc_s(struct echo_can_cb_s *cb, int pos)
+{
+	return cb->buf_d[cb->idx_d + pos];
+}
+
+/* Linear view of the history, newest sample first */
+static inline short *hist_cc_s(struct echo_can_cb_s *cb)
+{
+	return cb->buf_d + cb->idx_d;
+}
+
+/*
+ * Vector kernels.  ec_core_init() picks the best one of the CPU when the
+ * canceller module is loaded and checks it against the C version.  The
+ * DSP claims the FPU for the element before it takes dsp_lock, see
+ * dsp_pipeline_fpu_begin(), and dsp_cancel_rx() hands the kernel of each
+ * frame to the canceller with ec_core_select().
+ */
+#define EC_CORE_C	0
+#define EC_CORE_SSE2	1
+#define EC_CORE_AVX2	2
+#define EC_CORE_NEON	3
+
+#ifdef CONFIG_MISDN_DSP_EC_SIMD
+static const char *ec_core_name[] = { "C", "SSE2", "AVX2", "NEON" };
+
+static int ec_core_isa;			/* EC_CORE_*, selected at load */
+
+static inline void ec_core_fpu_begin(void)
+{
+#ifdef CONFIG_X86_64
+	kernel_fpu_begin();
+#else
+	kernel_neon_begin();
+#endif
+}
+
+static inline void ec_core_fpu_end(void)
+{
+#ifdef CONFIG_X86_64
+	kernel_fpu_end();
+#else
+	kernel_neon_end();
+#endif
+}
+
+static inline int
+ec_core_conv(int isa, const short *a, const short *b, int len)
+{
+	switch (isa) {
+#ifdef CONFIG_X86_64
+	case EC_CORE_AVX2:
+		return CONVOLVE2_AVX2(a, b, len);
+	case EC_CORE_SSE2:
+		return CONVOLVE2_SSE2(a, b, len);
+#endif
+#ifdef CONFIG_ARM64
+	case EC_CORE_NEON:
+		return CONVOLVE2_NEON(a, b, len);
+#endif
+	}
+	return CONVOLVE2(a, b, len);
+}
+
+/* UPDATE_NLMS2 with one vector correlation per tap */
+static inline void
+ec_core_update_vec(int isa, int *taps, short *taps_short, const short *err,
+	const short *history, int len, int ntaps, int div)
+{
+	int k;
+
+	for (k = 0; k < ntaps; k++) {
+		taps[k] += ec_core_conv(isa, err, history + k, len) / div;
+		taps_short[k] = taps[k] >> 16;
+	}
+}
+
+/* kernel for a frame, 'fpu' is set if the FPU was claimed for it */
+static inline int ec_core_select(int fpu)
+{
+	return fpu ? ec_core_isa : EC_CORE_C;
+}
+
+#define EC_CORE_TEST_N	256	/* taps */
+#define EC_CORE_TEST_M	16	/* error samples */
+
+/*
+ * Regression check of a vector kernel against the C version, with random
+ * and full scale data, all lengths and unaligned buffers.
+ * Returns 0 if the results are identical.
+ */
+static inline int ec_core_selftest(int isa)
+{
+	int size = 2 * EC_CORE_TEST_N + 16;
+	short *a, *b, *ts_c, *ts_v;
+	int *t_c, *t_v;
+	int len, off, k, err = -ENOMEM;
+
+	a = kmalloc_array(size, sizeof(short), GFP_KERNEL);
+	b = kmalloc_array(size, sizeof(short), GFP_KERNEL);
+	ts_c = kmalloc_array(EC_CORE_TEST_N, sizeof(short), GFP_KERNEL);
+	ts_v = kmalloc_array(EC_CORE_TEST_N, sizeof(short), GFP_KERNEL);
+	t_c = kmalloc_array(EC_CORE_TEST_N, sizeof(int), GFP_KERNEL);
+	t_v = kmalloc_array(EC_CORE_TEST_N, sizeof(int), GFP_KERNEL);
+	if (!a || !b || !ts_c || !ts_v || !t_c || !t_v)
+		goto out;
+	get_random_bytes(a, size * sizeof(short));
+	get_random_bytes(b, size * sizeof(short));
+	get_random_bytes(t_c, EC_CORE_TEST_N * sizeof(int));
+	memcpy(t_v, t_c, EC_CORE_TEST_N * sizeof(int));
+	/* full scale products must wrap the same way */
+	for (k = 0; k < 32; k++)
+		a[k] = b[k] = -32768;
+
+	err = 0;
+	ec_core_fpu_begin();
+	for (off = 0; off < 8 && !err; off++)
+		for (len = 0; len <= EC_CORE_TEST_N && !err; len++)
+			if (ec_core_conv(isa, a + off, b, len) !=
+			    CONVOLVE2(a + off, b, len))
+				err = -EIO;
+	if (!err) {
+		UPDATE_NLMS2(t_c, ts_c, a, b + 1, EC_CORE_TEST_M,
+			EC_CORE_TEST_N, 1 << 12);
+		ec_core_update_vec(isa, t_v, ts_v, a, b + 1, EC_CORE_TEST_M,
+			EC_CORE_TEST_N, 1 << 12);
+		if (memcmp(t_c, t_v, EC_CORE_TEST_N * sizeof(int)) ||
+		    memcmp(ts_c, ts_v, EC_CORE_TEST_N * sizeof(short)))
+			err = -EIO;
+	}
+	ec_core_fpu_end();
+out:
+	kfree(t_v);
+	kfree(t_c);
+	kfree(ts_v);
+	kfree(ts_c);
+	kfree(b);
+	kfree(a);
+	return err;
+}
+
+/*
+ * select the vector kernel, call once from the module init
+ * Returns the selected EC_CORE_* kernel.
+ */
+static inline int ec_core_init(const char *name)
+{
+	int isa = EC_CORE_C;
+
+#ifdef CONFIG_X86_64
+	if (boot_cpu_has(X86_FEATURE_AVX2) &&
+	    cpu_has_xfeatures(XFEATURE_MASK_SSE | XFEATURE_MASK_YMM, NULL))
+		isa = EC_CORE_AVX2;
+	else
+		isa = EC_CORE_SSE2;	/* always there on x86_64 */
+#endif
+#ifdef CONFIG_ARM64
+	if (cpu_have_named_feature(ASIMD))
+		isa = EC_CORE_NEON;
+#endif
+	if (isa != EC_CORE_C && ec_core_selftest(isa)) {
+		printk(KERN_WARNING "%s: %s: %s kernel failed the self test, "
+			"using C\n", __func__, name, ec_core_name[isa]);
+		isa = EC_CORE_C;
+	}
+	ec_core_isa = isa;
+	printk(KERN_DEBUG "%s: %s uses the %s kernel\n", __func__, name,
+		ec_core_name[isa]);
+	return isa;
+}
+#else
+static inline int ec_core_select(int fpu)
+{
+	return EC_CORE_C;
+}
+
+static inline int ec_core_init(const char *name)
+{
+	return EC_CORE_C;
+}
+#endif	/* CONFIG_MISDN_DSP_EC_SIMD */
+
+/* eq. (2): echo estimate of the N taps over the far-end history y */
+static inline int
+ec_core_fir(int isa, const short *a_s, struct echo_can_cb_s *y, int N)
+{
+#ifdef CONFIG_MISDN_DSP_EC_SIMD
+	if (isa != EC_CORE_C)
+		return ec_core_conv(isa, a_s, hist_cc_s(y), N);
+#endif
+	return CONVOLVE2(a_s, hist_cc_s(y), N);
+}
+
+/*
+ * eq. (7): update all N coefficients with the expectation over the last
+ * M error samples u against the far-end history y
+ */
+static inline void
+ec_core_update(int isa, int *a_i, short *a_s, struct echo_can_cb_s *u,
+	struct echo_can_cb_s *y, int N, int M, int two_beta_i)
+{
+#ifdef CONFIG_MISDN_DSP_EC_SIMD
+	if (isa != EC_CORE_C) {
+		ec_core_update_vec(isa, a_i, a_s, hist_cc_s(u), hist_cc_s(y),
+			M, N, two_beta_i);
+		return;
+	}
+#endif
+	UPDATE_NLMS2(a_i, a_s, hist_cc_s(u), hist_cc_s(y), M, N, two_beta_i);
+}
+
+#endif
@@ -54,8 +54,8 @@
    system performance and audio quality */
 /* #define MEC2_STATS_DETAILED */
 
-/* Get optimized routines for math */
-#include "dsp_arith.h"
+/* Get the shared FIR core and optimized routines for math */
+#include "dsp_eccore.h"
 
 /* Bring in definitions for the various constants and thresholds */
 #include "dsp_kb1ec_const.h"
@@ -70,17 +70,6 @@
 #define TRUE (!FALSE)
 #endif
 
-/* Generic circular buffer definition */
-struct echo_can_cb_s {
-	/* Pointer to the relative 'start' of the buffer */
-	int idx_d;
-	/* The absolute size of the buffer */
-	int size_d;
-	/* The actual sample -  twice as large as we need, however we do store
-	   values at idx_d and idx_d+size_d */
-	short *buf_d;
-};
-
 /* Echo canceller definition */
 struct echo_can_state {
 	/* an arbitrary ID for this echo can - this really should be settable
@@ -119,6 +108,12 @@ struct echo_can_state {
 	   remaining, in samples */
 	int HCNTR_d;
 
+	/* Coefficient update decimation, 1 means every DEFAULT_M samples */
+	int decim;
+
+	/* EC_CORE_* kernel of the current frame, see dsp_cancel_rx() */
+	int isa;
+
 	/* Circular buffers and coefficients */
 	/* --------------------------------- */
 	/* ... */
@@ -156,33 +151,6 @@ struct echo_can_state {
 
 };
 
-static inline void init_cb_s(struct echo_can_cb_s *cb, int len, void *where)
-{
-	cb->buf_d = (short *)where;
-	cb->idx_d = 0;
-	cb->size_d = len;
-}
-
-static inline void add_cc_s(struct echo_can_cb_s *cb, short newval)
-{
-	/* Can't use modulus because N+M isn't a power of two (generally) */
-	cb->idx_d--;
-	if (cb->idx_d < (int)0)
-		/* Whoops - the pointer to the 'start' wrapped around so reset
-		   it to the top of the buffer */
-		cb->idx_d += cb->size_d;
-
-	/* Load two copies into memory */
-	cb->buf_d[cb->idx_d] = newval;
-	cb->buf_d[cb->idx_d + cb->size_d] = newval;
-}
-
-static inline short get_cc_s(struct echo_can_cb_s *cb, int pos)
-{
-	/* Load two copies into memory */
-	return cb->buf_d[cb->idx_d + pos];
-}
-
 static inline void init_cc(struct echo_can_state *ec, int N, int maxy, int maxu)
 {
 
@@ -246,6 +214,8 @@ static inline void init_cc(struct echo_can_state *ec, int N, int maxy, int maxu)
 	ec->y_tilde_i = (int)0;
 	ec->HCNTR_d = (int)0;
 
+	/* Adapt at full rate */
+	ec->decim = 1;
 }
 
 static inline void echo_can_free(struct echo_can_state *ec)
@@ -294,9 +264,7 @@ echo_can_update(struct echo_can_state *ec, short iref, short isig)
 
 
 	/* eq. (2): compute r in fixed-point */
-	rs = CONVOLVE2(ec->a_s,
-			ec->y_s.buf_d + ec->y_s.idx_d,
-			ec->N_d);
+	rs = ec_core_fir(ec->isa, ec->a_s, &ec->y_s, ec->N_d);
 	rs >>= 15;
 
 	/* eq. (3): compute the output value (see figure 3) and the error
@@ -425,7 +393,7 @@ echo_can_update(struct echo_can_state *ec, short iref, short isig)
 	 * --------------------------------------------------------
 	 */
 	if (!ec->HCNTR_d && 		/* no near-end speech present */
-		!(ec->i_d % DEFAULT_M)) {	/* we only update on every
+		!(ec->i_d % (DEFAULT_M * ec->decim))) {	/* we only update on every
 						   DEFAULM_M'th sample from
 						   the stream */
 			if (ec->Lu_i > MIN_UPDATE_THRESH_I) {
@@ -440,19 +408,11 @@ echo_can_update(struct echo_can_state *ec, short iref, short isig)
 				ec->avg_Lu_i_ok = ec->avg_Lu_i_ok + ec->Lu_i;
 				++ec->cntr_coeff_updates;
 #endif
-				for (k = 0; k < ec->N_d; k++) {
-					/* eq. (7): compute an expectation
-					 over M_d samples */
-					int grad2;
-					grad2 = CONVOLVE2(ec->u_s.buf_d
-						+ ec->u_s.idx_d,
-						ec->y_s.buf_d
-						+ ec->y_s.idx_d + k,
-						DEFAULT_M);
-					/* eq. (7): update the coefficient */
-					ec->a_i[k] += grad2 / two_beta_i;
-					ec->a_s[k] = ec->a_i[k] >> 16;
-				}
+				/* eq. (7): compute an expectation over M_d
+				   samples and update all coefficients */
+				ec_core_update(ec->isa, ec->a_i, ec->a_s,
+					&ec->u_s, &ec->y_s, ec->N_d,
+					DEFAULT_M, two_beta_i);
 			} else {
 #ifdef MEC2_STATS_DETAILED
 				printk(KERN_INFO "insufficient signal to "
@@ -618,4 +578,12 @@ echo_can_traintap(struct echo_can_state *ec, int pos, short val)
 	return 0;
 }
 
+static inline void
+echo_can_decimate(struct echo_can_state *ec, int decim)
+{
+	/* Only update the coefficients every decim'th block of DEFAULT_M
+	 * samples, the filter itself still runs on every sample */
+	ec->decim = decim > 1 ? decim : 1;
+}
+
 #endif
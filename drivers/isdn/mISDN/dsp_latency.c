@@ -0,0 +1,175 @@
+/*
+ * Loopback latency measurement.
+ *
+ * A short pseudo random marker is written into the tx frame of a channel.
+ * The rx path of the same channel correlates the received samples against
+ * the marker. The time between sending and detecting it is measured with
+ * the mISDN sample clock, so it includes the card's FIFOs, the stack and
+ * the CMX tx buffering. The rx jitter buffer depth at detection time is
+ * reported separately.
+ *
+ * This only works if the audio comes back on the same channel, e.g. with
+ * l1loop, a far end loop, or DSP_ECHO_ON at the far end. Echo cancelers
+ * must be off, they would remove the marker.
+ *
+ * This software may be used and distributed according to the terms
+ * of the GNU General Public License, incorporated herein by reference.
+ *
+ */
+
+#include <linux/mISDNif.h>
+#include <linux/mISDNdsp.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include "core.h"
+#include "dsp.h"
+
+#define LAT_MARK_AMP	8000	/* about -12 dBm0 */
+#define LAT_MARK_BITS	0xb4e1c5a3 /* sign of each marker sample */
+#define LAT_NOISE	(LAT_MARK_LEN * 500 * 500) /* minimum energy */
+#define LAT_TIMEOUT	8000	/* give up after one second */
+
+/*
+ * start a measurement, a running one is restarted
+ */
+void
+dsp_latency_start(struct dsp *dsp)
+{
+	memset(dsp->latency.hist, 0, sizeof(dsp->latency.hist));
+	dsp->latency.pos = 0;
+	dsp->latency.state = DSP_LAT_ARMED;
+}
+
+/*
+ * put the marker into a tx frame, called with the final frame data
+ */
+void
+dsp_latency_tx(struct dsp *dsp, u8 *data, int len)
+{
+	u8 plus, minus;
+	int i;
+
+	if (len < LAT_MARK_LEN)
+		return; /* try next frame */
+	plus = dsp_audio_s16_to_law[LAT_MARK_AMP];
+	minus = dsp_audio_s16_to_law[(-LAT_MARK_AMP) & 0xffff];
+	for (i = 0; i < LAT_MARK_LEN; i++)
+		data[i] = ((LAT_MARK_BITS >> i) & 1) ? plus : minus;
+	dsp->latency.t_tx = mISDN_clock_get();
+	dsp->latency.state = DSP_LAT_WAIT;
+}
+
+/*
+ * search the marker in received data
+ * returns 1 if a result (or timeout) must be reported to the upper layer
+ */
+int
+dsp_latency_rx(struct dsp *dsp, u8 *data, int len)
+{
+	struct dsp_latency *lat = &dsp->latency;
+	s64 corr, energy;
+	s32 s;
+	u16 now;
+	int i, k, p, delay;
+
+	now = mISDN_clock_get();
+	for (i = 0; i < len; i++) {
+		lat->hist[lat->pos] = dsp_audio_law_to_s32[data[i]];
+		lat->pos = (lat->pos + 1) & (LAT_MARK_LEN - 1);
+		/* hist[pos] is the oldest sample now */
+		corr = 0;
+		energy = 0;
+		p = lat->pos;
+		for (k = 0; k < LAT_MARK_LEN; k++) {
+			s = lat->hist[p];
+			corr += ((LAT_MARK_BITS >> k) & 1) ? s : -s;
+			energy += (s64)s * s;
+			p = (p + 1) & (LAT_MARK_LEN - 1);
+		}
+		/* normalized correlation above 0.7 */
+		if (corr <= 0 || energy < LAT_NOISE ||
+		    corr * corr * 2 < energy * LAT_MARK_LEN)
+			continue;
+		/* first marker sample, counted back from the end of data */
+		delay = (u16)(now - (len - 1 - i) - (LAT_MARK_LEN - 1) -
+			      lat->t_tx);
+		lat->last = delay;
+		if (!lat->count || delay < lat->min)
+			lat->min = delay;
+		if (delay > lat->max)
+			lat->max = delay;
+		lat->count++;
+		lat->cmx = 0;
+		if (dsp->conf && dsp->conf->software)
+			lat->cmx = (dsp->rx_W - dsp->rx_R) & CMX_BUFF_MASK;
+		lat->state = DSP_LAT_IDLE;
+		return 1;
+	}
+	if ((u16)(now - lat->t_tx) > LAT_TIMEOUT) {
+		lat->last = -1;
+		lat->cmx = 0;
+		lat->lost++;
+		lat->state = DSP_LAT_IDLE;
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * report the last result: DSP_LATENCY_RESULT, delay (-1 = timeout) and
+ * rx jitter buffer depth, all in samples
+ */
+void
+dsp_latency_report(struct dsp *dsp)
+{
+	struct sk_buff *nskb;
+	int res[3];
+
+	res[0] = DSP_LATENCY_RESULT;
+	res[1] = dsp->latency.last;
+	res[2] = dsp->latency.cmx;
+	if (dsp_debug & DEBUG_DSP_CORE)
+		printk(KERN_DEBUG "%s: %s latency %d samples, cmx %d\n",
+		       __func__, dsp->name, res[1], res[2]);
+	nskb = _alloc_mISDN_skb(PH_CONTROL_IND, MISDN_ID_ANY, sizeof(res),
+				res, GFP_ATOMIC);
+	if (nskb) {
+		if (dsp->up) {
+			if (dsp->up->send(dsp->up, nskb))
+				dev_kfree_skb(nskb);
+		} else
+			dev_kfree_skb(nskb);
+	}
+}
+
+static int
+dsp_latency_show(struct seq_file *m, void *v)
+{
+	struct dsp *dsp;
+	u_long flags;
+
+	seq_puts(m, "# name count lost last min max cmx (samples)\n");
+	spin_lock_irqsave(&dsp_lock, flags);
+	list_for_each_entry(dsp, &dsp_ilist, list) {
+		if (!dsp->latency.count && !dsp->latency.lost)
+			continue;
+		seq_printf(m, "%s %u %u %d %d %d %d\n", dsp->name,
+			   dsp->latency.count, dsp->latency.lost,
+			   dsp->latency.last, dsp->latency.min,
+			   dsp->latency.max, dsp->latency.cmx);
+	}
+	spin_unlock_irqrestore(&dsp_lock, flags);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(dsp_latency);
+
+/*
+ * called by dsp_init() after it created the mISDN_dsp directory, the file
+ * is removed with the directory
+ */
+void
+dsp_latency_init(void)
+{
+	debugfs_create_file("latency", 0444, dsp_debugfs, NULL,
+			    &dsp_latency_fops);
+}
@@ -30,8 +30,8 @@
 #define FREE(a) free(a)
 #endif
 
-/* Get optimized routines for math */
-#include "dsp_arith.h"
+/* Get the shared FIR core and optimized routines for math */
+#include "dsp_eccore.h"
 
 #ifndef NULL
 #define NULL 0
@@ -45,13 +45,6 @@
 
 #include "dsp_mec2_const.h"
 
-/* Circular buffer definition */
-struct echo_can_cb_s {
-	int idx_d;
-	int size_d;
-	short *buf_d;	/* Twice as large as we need */
-};
-
 /* class definition */
 struct echo_can_state {
 	/* Echo canceller definition */
@@ -72,6 +65,12 @@ struct echo_can_state {
 	int s_tilde_i;
 	int HCNTR_d;
 
+	/* coefficient update decimation */
+	int decim;
+
+	/* EC_CORE_* kernel of the current frame, see dsp_cancel_rx() */
+	int isa;
+
 	/* circular buffers and coefficients */
 	int *a_i;
 	short *a_s;
@@ -87,30 +86,6 @@ struct echo_can_state {
 
 };
 
-static inline void init_cb_s(struct echo_can_cb_s *cb, int len, void *where)
-{
-	cb->buf_d = (short *)where;
-	cb->idx_d = 0;
-	cb->size_d = len;
-}
-
-static inline void add_cc_s(struct echo_can_cb_s *cb, short newval)
-{
-	/* Can't use modulus because N+M isn't a power of two (generally) */
-	cb->idx_d--;
-	if (cb->idx_d < (int)0)
-		cb->idx_d += cb->size_d;
-	/* Load two copies into memory */
-	cb->buf_d[cb->idx_d] = newval;
-	cb->buf_d[cb->idx_d + cb->size_d] = newval;
-}
-
-static inline short get_cc_s(struct echo_can_cb_s *cb, int pos)
-{
-	/* Load two copies into memory */
-	return cb->buf_d[cb->idx_d + pos];
-}
-
 static inline void
 init_cc(struct echo_can_state *ec, int N, int maxy, int maxu)
 {
@@ -160,6 +135,9 @@ init_cc(struct echo_can_state *ec, int N, int maxy, int maxu)
 	ec->y_tilde_i = 0;
 	ec->HCNTR_d = (int)0;
 
+	/* adapt at full rate */
+	ec->decim = 1;
+
 	/* exit gracefully */
 }
 
@@ -173,7 +151,6 @@ echo_can_update(struct echo_can_state *ec, short iref, short isig)
 {
 
 	/* declare local variables that are used more than once */
-	int k;
 	int rs;
 	short u;
 	int Py_i;
@@ -201,7 +178,7 @@ echo_can_update(struct echo_can_state *ec, short iref, short isig)
 	add_cc_s(&ec->y_s, iref);
 
 	/* eq. (2): compute r in fixed-point */
-	rs = CONVOLVE2(ec->a_s, ec->y_s.buf_d + ec->y_s.idx_d, ec->N_d);
+	rs = ec_core_fir(ec->isa, ec->a_s, &ec->y_s, ec->N_d);
 	rs >>= 15;
 
 	/* eq. (3): compute the output value (see figure 3) and the error
@@ -305,18 +282,11 @@ echo_can_update(struct echo_can_state *ec, short iref, short isig)
   /* update coefficients if no near-end speech and we have enough signal
    * to bother trying to update.
   */
-	if (!ec->HCNTR_d && !(ec->i_d % DEFAULT_M) &&
+	if (!ec->HCNTR_d && !(ec->i_d % (DEFAULT_M * ec->decim)) &&
 		(ec->Lu_i > MIN_UPDATE_THRESH_I)) {
-		/* loop over all filter coefficients */
-		for (k = 0; k < ec->N_d; k++) {
-			/* eq. (7): compute an expectation over M_d samples */
-			int grad2;
-			grad2 = CONVOLVE2(ec->u_s.buf_d + ec->u_s.idx_d,
-			ec->y_s.buf_d + ec->y_s.idx_d + k, DEFAULT_M);
-			/* eq. (7): update the coefficient */
-			ec->a_i[k] += grad2 / two_beta_i;
-			ec->a_s[k] = ec->a_i[k] >> 16;
-		}
+		/* eq. (7): update all filter coefficients */
+		ec_core_update(ec->isa, ec->a_i, ec->a_s, &ec->u_s, &ec->y_s,
+			ec->N_d, DEFAULT_M, two_beta_i);
 	}
 
   /* paragraph below eq. (15): if no near-end speech,
@@ -410,4 +380,12 @@ echo_can_traintap(struct echo_can_state *ec, int pos, short val)
 	return 0;
 }
 
+static inline void
+echo_can_decimate(struct echo_can_state *ec, int decim)
+{
+	/* Only update the coefficients every decim'th block of DEFAULT_M
+	 * samples, the filter itself still runs on every sample */
+	ec->decim = decim > 1 ? decim : 1;
+}
+
 #endif
@@ -36,6 +36,7 @@ static void *new(const char *arg)
 {
 	int deftaps = 128,
 		training = 0,
+		throttle = 0,
 		len;
 
 	if (!arg)
@@ -68,14 +69,17 @@ static void *new(const char *arg)
 			} else if (!strcmp(name, "training")) {
 				if (sscanf(val, "%d", &tmp) == 1)
 					training = tmp;
+			} else {
+				dsp_cancel_arg_throttle(name, val, &throttle);
 			}
 		}
 	}
 
 _out:
-	printk(KERN_DEBUG "%s: creating %s with deftaps=%d and training=%d\n",
-		__func__, EC_TYPE, deftaps, training);
-	return dsp_cancel_new(deftaps, training);
+	printk(KERN_DEBUG "%s: creating %s with deftaps=%d, training=%d "
+		"and throttle=%d\n", __func__, EC_TYPE, deftaps, training,
+		throttle);
+	return dsp_cancel_new(deftaps, training, throttle);
 }
 
 static void free(void *p)
@@ -88,14 +92,16 @@ static void process_tx(void *p, u8 *data, int len)
 	dsp_cancel_tx(p, data, len);
 }
 
-static void process_rx(void *p, u8 *data, int len, unsigned int txlen)
+static void process_rx(void *p, u8 *data, int len, unsigned int txlen,
+	int fpu)
 {
-	dsp_cancel_rx(p, data, len, txlen);
+	dsp_cancel_rx(p, data, len, txlen, fpu);
 }
 
 static struct mISDN_dsp_element_arg args[] = {
 	{ "deftaps", "128", "Set the number of taps of cancellation." },
 	{ "training", "0", "Enable echotraining (0: disabled, 1: enabled)." },
+	DSP_CANCEL_ARG_THROTTLE,
 };
 
 static struct mISDN_dsp_element dsp_mg2ec = {
@@ -111,13 +117,17 @@ static struct mISDN_dsp_element dsp_mg2ec = {
 #ifdef MODULE
 static int __init dsp_mg2ec_init(void)
 {
+	if (ec_core_init(dsp_mg2ec.name) != EC_CORE_C)
+		dsp_mg2ec.flags |= MISDN_DSP_ELEM_FPU;
 	mISDN_dsp_element_register(&dsp_mg2ec);
+	dsp_cancel_debugfs_init(dsp_mg2ec.name);
 
 	return 0;
 }
 
 static void __exit dsp_mg2ec_exit(void)
 {
+	dsp_cancel_debugfs_exit();
 	mISDN_dsp_element_unregister(&dsp_mg2ec);
 }
 
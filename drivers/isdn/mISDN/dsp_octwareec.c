@@ -75,7 +75,7 @@ static void *new(const char *arg)
 _out:
 	printk(KERN_DEBUG "%s: creating %s with deftaps=%d and training=%d\n",
 		__func__, EC_TYPE, deftaps, training);
-	return dsp_cancel_new(deftaps, training);
+	return dsp_cancel_new(deftaps, training, 0);
 }
 
 static void free(void *p)
@@ -88,9 +88,10 @@ static void process_tx(void *p, u8 *data, int len)
 	dsp_cancel_tx(p, data, len);
 }
 
-static void process_rx(void *p, u8 *data, int len, unsigned int txlen)
+static void process_rx(void *p, u8 *data, int len, unsigned int txlen,
+	int fpu)
 {
-	dsp_cancel_rx(p, data, len, txlen);
+	dsp_cancel_rx(p, data, len, txlen, fpu);
 }
 
 static struct mISDN_dsp_element_arg args[] = {
@@ -112,12 +113,14 @@ static struct mISDN_dsp_element dsp_octwareec = {
 static int __init dsp_octwareec_init(void)
 {
 	mISDN_dsp_element_register(&dsp_octwareec);
+	dsp_cancel_debugfs_init(dsp_octwareec.name);
 
 	return 0;
 }
 
 static void __exit dsp_octwareec_exit(void)
 {
+	dsp_cancel_debugfs_exit();
 	mISDN_dsp_element_unregister(&dsp_octwareec);
 }
 
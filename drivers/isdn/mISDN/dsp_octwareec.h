@@ -101,4 +101,10 @@ echo_can_traintap(struct echo_can_state *ec, int pos, short val)
 	    pos, val);
 }
 
+static inline void
+echo_can_decimate(struct echo_can_state *ec, int decim)
+{
+	/* adaptation is done inside the OCTVQE module */
+}
+
 #endif /* __OCTWARE_EC_H__ */
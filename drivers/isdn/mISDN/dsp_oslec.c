@@ -36,6 +36,7 @@
 #define echo_can_free oslec_echo_can_free
 #define echo_can_update oslec_echo_can_update
 #define echo_can_traintap oslec_echo_can_traintap
+#define echo_can_decimate oslec_echo_can_decimate
 #include "dsp_cancel.h"
 
 /*#define DEBUG */
@@ -44,6 +45,7 @@ static void *new(const char *arg)
 {
 	int deftaps = 128,
 		training = 0,
+		throttle = 0,
 		len;
 
 	if (!arg)
@@ -76,16 +78,19 @@ static void *new(const char *arg)
 			} else if (!strcmp(name, "training")) {
 				if (sscanf(val, "%d", &tmp) == 1)
 					training = tmp;
+			} else {
+				dsp_cancel_arg_throttle(name, val, &throttle);
 			}
 		}
 	}
 
 _out:
 #ifdef DEBUG
-	printk(KERN_DEBUG "%s: creating %s with deftaps=%d and training=%d\n",
-		__func__, EC_TYPE, deftaps, training);
+	printk(KERN_DEBUG "%s: creating %s with deftaps=%d, training=%d "
+		"and throttle=%d\n", __func__, EC_TYPE, deftaps, training,
+		throttle);
 #endif
-	return dsp_cancel_new(deftaps, training);
+	return dsp_cancel_new(deftaps, training, throttle);
 }
 
 static void free(void *p)
@@ -98,14 +103,16 @@ static void process_tx(void *p, u8 *data, int len)
 	dsp_cancel_tx(p, data, len);
 }
 
-static void process_rx(void *p, u8 *data, int len, unsigned int txlen)
+static void process_rx(void *p, u8 *data, int len, unsigned int txlen,
+	int fpu)
 {
-	dsp_cancel_rx(p, data, len, txlen);
+	dsp_cancel_rx(p, data, len, txlen, fpu);
 }
 
 static struct mISDN_dsp_element_arg args[] = {
 	{ "deftaps", "128", "Set the number of taps of cancellation." },
 	{ "training", "0", "Enable echotraining (0: disabled, 1: enabled)." },
+	DSP_CANCEL_ARG_THROTTLE,
 };
 
 static struct mISDN_dsp_element dsp_oslec = {
@@ -122,12 +129,14 @@ static struct mISDN_dsp_element dsp_oslec = {
 static int __init dsp_oslec_init(void)
 {
 	mISDN_dsp_element_register(&dsp_oslec);
+	dsp_cancel_debugfs_init(dsp_oslec.name);
 
 	return 0;
 }
 
 static void __exit dsp_oslec_exit(void)
 {
+	dsp_cancel_debugfs_exit();
 	mISDN_dsp_element_unregister(&dsp_oslec);
 }
 
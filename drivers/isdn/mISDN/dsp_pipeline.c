@@ -14,6 +14,14 @@
 #include <linux/mISDNif.h>
 #include <linux/mISDNdsp.h>
 #include <linux/export.h>
+#ifdef CONFIG_MISDN_DSP_EC_SIMD
+#include <asm/simd.h>
+#ifdef CONFIG_X86_64
+#include <asm/fpu/api.h>
+#else
+#include <asm/neon.h>
+#endif
+#endif
 #include "dsp.h"
 #include "dsp_hwec.h"
 
@@ -218,7 +226,7 @@ void dsp_pipeline_destroy(struct dsp_pipeline *pipeline)
 
 int dsp_pipeline_build(struct dsp_pipeline *pipeline, const char *cfg)
 {
-	int incomplete = 0, found = 0;
+	int incomplete = 0, found = 0, fpu = 0;
 	char *dup, *tok, *name, *args;
 	struct dsp_element_entry *entry, *n;
 	struct dsp_pipeline_entry *pipeline_entry;
@@ -302,6 +310,10 @@ _out:
 		pipeline->inuse = 1;
 	else
 		pipeline->inuse = 0;
+	list_for_each_entry(pipeline_entry, &pipeline->list, list)
+		if (pipeline_entry->elem->flags & MISDN_DSP_ELEM_FPU)
+			fpu = 1;
+	WRITE_ONCE(pipeline->fpu, fpu);
 
 #ifdef PIPELINE_DEBUG
 	printk(KERN_DEBUG "%s: dsp pipeline built%s: %s\n",
@@ -324,7 +336,7 @@ void dsp_pipeline_process_tx(struct dsp_pipeline *pipeline, u8 *data, int len)
 }
 
 void dsp_pipeline_process_rx(struct dsp_pipeline *pipeline, u8 *data, int len,
-			     unsigned int txlen)
+			     unsigned int txlen, int fpu)
 {
 	struct dsp_pipeline_entry *entry;
 
@@ -333,5 +345,42 @@ void dsp_pipeline_process_rx(struct dsp_pipeline *pipeline, u8 *data, int len,
 
 	list_for_each_entry_reverse(entry, &pipeline->list, list)
 		if (entry->elem->process_rx)
-			entry->elem->process_rx(entry->p, data, len, txlen);
+			entry->elem->process_rx(entry->p, data, len, txlen,
+						fpu);
+}
+
+/*
+ * Claim the FPU for the elements that want it. This must be done before
+ * dsp_lock is taken, because releasing the FPU enables bottom halves
+ * again. The flag is read without the lock: if the pipeline changes
+ * meanwhile, the elements just get the C version for one frame.
+ * Returns the 'fpu' argument for dsp_pipeline_process_rx().
+ */
+int dsp_pipeline_fpu_begin(struct dsp_pipeline *pipeline)
+{
+#ifdef CONFIG_MISDN_DSP_EC_SIMD
+	if (!READ_ONCE(pipeline->fpu) || irqs_disabled() || !may_use_simd())
+		return 0;
+#ifdef CONFIG_X86_64
+	kernel_fpu_begin();
+#else
+	kernel_neon_begin();
+#endif
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+void dsp_pipeline_fpu_end(int fpu)
+{
+#ifdef CONFIG_MISDN_DSP_EC_SIMD
+	if (!fpu)
+		return;
+#ifdef CONFIG_X86_64
+	kernel_fpu_end();
+#else
+	kernel_neon_end();
+#endif
+#endif
 }
@@ -33,24 +33,45 @@ dchannel_bh(struct work_struct *ws)
 	}
 }
 
-static void
-bchannel_bh(struct work_struct *ws)
+/*
+ * deliver the receive queue to the peer, returns the number of frames
+ * only one caller delivers at a time, so frames are never reordered
+ * must not be called with a driver lock held, the peer may send back
+ */
+int
+bchannel_rx_drain(struct bchannel *bch)
 {
-	struct bchannel	*bch  = container_of(ws, struct bchannel, workq);
 	struct sk_buff	*skb;
-	int		err;
+	int		err, cnt = 0;
 
-	if (test_and_clear_bit(FLG_RECVQUEUE, &bch->Flags)) {
-		while ((skb = skb_dequeue(&bch->rqueue))) {
-			bch->rcount--;
-			if (likely(bch->ch.peer)) {
-				err = bch->ch.recv(bch->ch.peer, skb);
-				if (err)
-					dev_kfree_skb(skb);
-			} else
+	if (test_and_set_bit(FLG_RX_DRAIN, &bch->Flags))
+		return 0;
+	while ((skb = skb_dequeue(&bch->rqueue))) {
+		bch->rcount--;
+		cnt++;
+		if (likely(bch->ch.peer)) {
+			err = bch->ch.recv(bch->ch.peer, skb);
+			if (err)
 				dev_kfree_skb(skb);
-		}
+		} else
+			dev_kfree_skb(skb);
 	}
+	clear_bit(FLG_RX_DRAIN, &bch->Flags);
+	smp_mb__after_atomic();
+	/* the work may have skipped frames queued meanwhile */
+	if (!skb_queue_empty(&bch->rqueue))
+		schedule_event(bch, FLG_RECVQUEUE);
+	return cnt;
+}
+EXPORT_SYMBOL(bchannel_rx_drain);
+
+static void
+bchannel_bh(struct work_struct *ws)
+{
+	struct bchannel	*bch  = container_of(ws, struct bchannel, workq);
+
+	if (test_and_clear_bit(FLG_RECVQUEUE, &bch->Flags))
+		bchannel_rx_drain(bch);
 }
 
 int
@@ -89,6 +110,8 @@ mISDN_initbchannel(struct bchannel *ch, unsigned short maxlen,
 	skb_queue_head_init(&ch->rqueue);
 	ch->rcount = 0;
 	ch->next_skb = NULL;
+	memset(&ch->stats, 0, sizeof(ch->stats));
+	u64_stats_init(&ch->stats.syncp);
 	INIT_WORK(&ch->workq, bchannel_bh);
 	return 0;
 }
@@ -267,11 +290,20 @@ recv_Bchannel(struct bchannel *bch, unsigned int id, bool force)
 		hh->prim = PH_DATA_IND;
 		hh->id = id;
 		if (bch->rcount >= 64) {
-			printk(KERN_WARNING
-			       "B%d receive queue overflow - flushing!\n",
-			       bch->nr);
+			if (bch->debug & DEBUG_HW_BCHANNEL)
+				printk(KERN_DEBUG
+				       "B%d receive queue overflow - flushing!\n",
+				       bch->nr);
+			bch_stats_add(bch, queue_drop,
+				      skb_queue_len(&bch->rqueue));
+			if (bch->ch.st)
+				mISDN_nl_event(bch->ch.st->dev,
+					       MISDN_EVENT_FIFO_ERROR, bch->nr,
+					       -1, skb_queue_len(&bch->rqueue));
 			skb_queue_purge(&bch->rqueue);
 		}
+		bch_stats_inc(bch, rx_frames);
+		bch_stats_add(bch, rx_bytes, bch->rx_skb->len);
 		bch->rcount++;
 		skb_queue_tail(&bch->rqueue, bch->rx_skb);
 		bch->rx_skb = NULL;
@@ -292,11 +324,17 @@ void
 recv_Bchannel_skb(struct bchannel *bch, struct sk_buff *skb)
 {
 	if (bch->rcount >= 64) {
-		printk(KERN_WARNING "B-channel %p receive queue overflow, "
-		       "flushing!\n", bch);
+		if (bch->debug & DEBUG_HW_BCHANNEL)
+			printk(KERN_DEBUG "B-channel %p receive queue "
+			       "overflow, flushing!\n", bch);
+		bch_stats_add(bch, queue_drop, skb_queue_len(&bch->rqueue));
 		skb_queue_purge(&bch->rqueue);
 		bch->rcount = 0;
 	}
+	if (mISDN_HEAD_PRIM(skb) == PH_DATA_IND) {
+		bch_stats_inc(bch, rx_frames);
+		bch_stats_add(bch, rx_bytes, skb->len);
+	}
 	bch->rcount++;
 	skb_queue_tail(&bch->rqueue, skb);
 	schedule_event(bch, FLG_RECVQUEUE);
@@ -340,8 +378,10 @@ confirm_Bsend(struct bchannel *bch)
 	struct sk_buff	*skb;
 
 	if (bch->rcount >= 64) {
-		printk(KERN_WARNING "B-channel %p receive queue overflow, "
-		       "flushing!\n", bch);
+		if (bch->debug & DEBUG_HW_BCHANNEL)
+			printk(KERN_DEBUG "B-channel %p receive queue "
+			       "overflow, flushing!\n", bch);
+		bch_stats_add(bch, queue_drop, skb_queue_len(&bch->rqueue));
 		skb_queue_purge(&bch->rqueue);
 		bch->rcount = 0;
 	}
@@ -448,6 +488,8 @@ bchannel_senddata(struct bchannel *ch, struct sk_buff *skb)
 		       __func__, skb->len, ch->next_skb->len);
 		return -EBUSY;
 	}
+	bch_stats_inc(ch, tx_frames);
+	bch_stats_add(ch, tx_bytes, skb->len);
 	if (test_and_set_bit(FLG_TX_BUSY, &ch->Flags)) {
 		test_and_set_bit(FLG_TX_NEXT, &ch->Flags);
 		ch->next_skb = skb;
@@ -474,8 +516,10 @@ bchannel_get_rxbuf(struct bchannel *bch, int reqlen)
 	if (bch->rx_skb) {
 		len = skb_tailroom(bch->rx_skb);
 		if (len < reqlen) {
-			pr_warn("B%d no space for %d (only %d) bytes\n",
-				bch->nr, reqlen, len);
+			if (bch->debug & DEBUG_HW_BFIFO)
+				pr_debug("B%d no space for %d (only %d) bytes\n",
+					 bch->nr, reqlen, len);
+			bch_stats_inc(bch, rx_overrun);
 			if (test_bit(FLG_TRANSPARENT, &bch->Flags)) {
 				/* send what we have now and try a new buffer */
 				recv_Bchannel(bch, 0, true);
@@ -514,3 +558,43 @@ bchannel_get_rxbuf(struct bchannel *bch, int reqlen)
 	return len;
 }
 EXPORT_SYMBOL(bchannel_get_rxbuf);
+
+/*
+ * copy the statistics of all B-channels of a device, returns the number of
+ * B-channels, but fills at most max entries
+ */
+int
+get_bchannel_stats(struct mISDNdevice *dev, struct mISDN_bchstats *st,
+		   u_int max)
+{
+	struct mISDNchannel *ch;
+	struct bchannel *bch;
+	struct bchannel_stats *s;
+	unsigned int start;
+	int cnt = 0;
+
+	list_for_each_entry(ch, &dev->bchannels, list) {
+		if (cnt >= max) {
+			cnt++;
+			continue;
+		}
+		bch = container_of(ch, struct bchannel, ch);
+		s = &bch->stats;
+		st->channel = bch->nr;
+		do {
+			start = u64_stats_fetch_begin(&s->syncp);
+			st->rx_frames = u64_stats_read(&s->rx_frames);
+			st->rx_bytes = u64_stats_read(&s->rx_bytes);
+			st->tx_frames = u64_stats_read(&s->tx_frames);
+			st->tx_bytes = u64_stats_read(&s->tx_bytes);
+			st->rx_overrun = u64_stats_read(&s->rx_overrun);
+			st->tx_underrun = u64_stats_read(&s->tx_underrun);
+			st->crc_err = u64_stats_read(&s->crc_err);
+			st->frame_err = u64_stats_read(&s->frame_err);
+			st->queue_drop = u64_stats_read(&s->queue_drop);
+		} while (u64_stats_fetch_retry(&s->syncp, start));
+		st++;
+		cnt++;
+	}
+	return cnt;
+}
@@ -8,6 +8,7 @@
 #define DEBUG_L1OIP_SOCKET	0x00020000
 #define DEBUG_L1OIP_MGR		0x00040000
 #define DEBUG_L1OIP_MSG		0x00080000
+#define DEBUG_L1OIP_CODEC	0x00100000	/* G.726 self test on load */
 
 /* enable to disorder received bchannels by sequence 2143658798... */
 /*
@@ -24,8 +25,50 @@
 #define L1OIP_TIMEOUT		65
 
 
+/* silence suppression */
+#define L1OIP_CODEC_CN		15	/* coding of comfort noise descriptor */
+#define L1OIP_VAD_HANGOVER	1600	/* samples to send after voice ends */
+#define L1OIP_CN_INTERVAL	8000	/* samples between CN descriptors */
+#define L1OIP_CN_FRAME		20	/* ms between regenerated frames */
+
+
 /* socket */
 #define L1OIP_DEFAULTPORT	931
+#define L1OIP_MAX_WORKERS	8		/* receive workers on shared port */
+/*
+ * encap type of the tunnel socket: the UDP stack only checks for non-zero.
+ * The UDP_ENCAP_* values name ESP, L2TP, GTP and RxRPC, which the stack
+ * may treat specially, so use 1 like vxlan and geneve do.
+ */
+#define L1OIP_UDP_ENCAP		1
+
+
+/* codecs */
+#define L1OIP_CODEC_G726_32	4	/* G.726 ADPCM 32 kbit/s */
+#define L1OIP_CODEC_G726_24	5	/* G.726 ADPCM 24 kbit/s */
+
+
+/* G.726 ADPCM state of one direction */
+struct l1oip_g726 {
+	int			yl;	/* locked quantizer scale factor */
+	short			yu;	/* unlocked quantizer scale factor */
+	short			dms;	/* short term average of F(I) */
+	short			dml;	/* long term average of F(I) */
+	short			ap;	/* linear weighting coefficient */
+	short			a[2];	/* pole predictor coefficients */
+	short			b[6];	/* zero predictor coefficients */
+	short			pk[2];	/* signs of previous partial sig. */
+	short			dq[6];	/* previous quantized differences */
+	short			sr[2];	/* previous reconstructed signals */
+	int			td;	/* tone detect */
+};
+
+struct l1oip_adpcm {
+	struct l1oip_g726	enc;
+	struct l1oip_g726	dec;
+	u8			pend[8];	/* samples not yet encoded */
+	int			pend_len;
+};
 
 
 /* channel structure */
@@ -35,6 +78,23 @@ struct l1oip_chan {
 	u32			tx_counter;	/* counts xmit bytes/packets */
 	u32			rx_counter;	/* counts recv bytes/packets */
 	u32			codecstate;	/* used by codec to save data */
+	struct l1oip_adpcm	adpcm;		/* used by ADPCM codec */
+	/* silence suppression, send side */
+	int			vad_hang;	/* samples left to send */
+	int			vad_level;	/* noise level estimation */
+	int			cn_sent;	/* if in suppression */
+	u32			cn_tx_counter;	/* last CN descriptor sent */
+	/* comfort noise, receive side */
+	int			cn_active;	/* if regenerating */
+	int			cn_level;	/* received noise level */
+	u32			cn_seed;
+	u32			cn_counter;	/* timebase of next frame */
+	unsigned long		cn_jiffies;	/* time of last frame */
+	/* statistics */
+	u64			vad_frames;	/* suppressed frames */
+	u64			vad_saved;	/* saved bytes */
+	u64			cn_rx;		/* received CN descriptors */
+	u64			cn_frames;	/* regenerated frames */
 #ifdef REORDER_DEBUG
 	int			disorder_flag;
 	struct sk_buff		*disorder_skb;
@@ -43,9 +103,33 @@ struct l1oip_chan {
 };
 
 
+/* per interface statistics, updated by workers and senders concurrently */
+struct l1oip_stats {
+	atomic_long_t		tx_frames;
+	atomic_long_t		tx_bytes;
+	atomic_long_t		tx_dropped;	/* socket busy or not open */
+	atomic_long_t		rx_frames;
+	atomic_long_t		rx_bytes;
+	atomic_long_t		rx_errors;	/* malformed frames */
+};
+
+
+/* shared socket, used if all interfaces listen on one port */
+struct l1oip_share {
+	u16			port;		/* local port, 0 = not shared */
+	int			workers;	/* number of receive workers */
+	int			given;	/* socket is given to interfaces */
+	struct socket		*socket[L1OIP_MAX_WORKERS];
+	struct task_struct	*thread[L1OIP_MAX_WORKERS];
+	struct completion	complete[L1OIP_MAX_WORKERS];
+	atomic_long_t		unknown;	/* frames with unknown ID */
+};
+
+
 /* card structure */
 struct l1oip {
 	struct list_head        list;
+	struct hlist_node	id_node;	/* id lookup on shared port */
 
 	/* card */
 	int			registered;	/* if registered with mISDN */
@@ -59,17 +143,20 @@ struct l1oip {
 	int			bundle;		/* bundle channels in one frm */
 	int			codec;		/* codec to use for transmis. */
 	int			limit;		/* limit number of bchannels */
+	int			vad;		/* silence level, 0 = off */
 
 	/* timer */
 	struct timer_list	keep_tl;
 	struct timer_list	timeout_tl;
 	int			timeout_on;
 	struct work_struct	workq;
+	struct timer_list	cn_tl;		/* comfort noise generation */
 
 	/* socket */
 	struct socket		*socket;	/* if set, socket is created */
 	struct completion	socket_complete;/* completion of sock thread */
 	struct task_struct	*socket_thread;
+	struct socket		*rx_socket;	/* socket with encap callback */
 	spinlock_t		socket_lock;	/* access sock outside thread */
 	u32			remoteip;	/* if all set, ip is assigned */
 	u16			localport;	/* must always be set */
@@ -78,6 +165,12 @@ struct l1oip {
 	struct sockaddr_in	sin_remote;	/* remote socket name */
 	struct msghdr		sendmsg;	/* ip message to send */
 	struct kvec		sendiov;	/* iov for message */
+	int			shared;	/* if socket is the shared one */
+	spinlock_t		rx_lock;	/* serialize receive workers */
+
+	/* statistics */
+	struct l1oip_stats	stats;
+	struct dentry		*debugfs;
 
 	/* frame */
 	struct l1oip_chan	chan[128];	/* channel instances */
@@ -89,3 +182,14 @@ extern int l1oip_alaw_to_ulaw(u8 *data, int len, u8 *result);
 extern int l1oip_ulaw_to_alaw(u8 *data, int len, u8 *result);
 extern void l1oip_4bit_free(void);
 extern int l1oip_4bit_alloc(int ulaw);
+extern void l1oip_law_init(int ulaw);
+extern void l1oip_adpcm_init(struct l1oip_adpcm *st);
+extern int l1oip_law_to_adpcm(u8 *data, int len, u8 *result,
+			      struct l1oip_adpcm *st, int bits);
+extern int l1oip_adpcm_to_law(u8 *data, int len, u8 *result,
+			      struct l1oip_adpcm *st, int bits);
+extern int l1oip_g726_selftest(void);
+extern u8 l1oip_linear_to_law(int sample);
+extern s16 l1oip_law_to_linear(u8 law);
+extern int l1oip_law_level(u8 *data, int len);
+extern void l1oip_law_noise(u8 *result, int len, int level, u32 *seed);
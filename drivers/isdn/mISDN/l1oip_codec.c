@@ -5,8 +5,10 @@
  *  -> conversion from a-Law to u-Law
  *  -> conversion from u-Law to a-Law
  *  -> compression by reducing the number of sample resolution to 4
+ *  -> level detection and noise generation for silence suppression
+ *  -> G.726 ADPCM at 32 and 24 kbit/s
  *
- * NOTE: It is not compatible with any standard codec like ADPCM.
+ * NOTE: The 4 bit compression is not compatible with any standard codec.
  *
  * Author	Andreas Eversberg (jolly@eversberg.eu)
  *
@@ -37,6 +39,9 @@
 #include <linux/vmalloc.h>
 #include <linux/mISDNif.h>
 #include <linux/in.h>
+#include <linux/bitrev.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
 #include "core.h"
 #include "l1oip.h"
 
@@ -45,6 +50,10 @@
 static u8 *table_com;
 static u16 *table_dec;
 
+/* law -> linear, law samples are bit reversed like on the B-channel */
+static s16 law_to_linear[256];
+static int law_is_ulaw;
+
 
 /* alaw -> ulaw */
 static u8 alaw_to_ulaw[256] =
@@ -294,6 +303,664 @@ l1oip_ulaw_to_alaw(u8 *data, int len, u8 *result)
 }
 
 
+/*
+ * linear conversion
+ */
+static s16
+alaw2linear(u8 alaw)
+{
+	int i, seg;
+
+	alaw ^= 0x55;
+	i = ((alaw & 0x0f) << 4) + 8;
+	seg = (alaw & 0x70) >> 4;
+	if (seg)
+		i = (i + 0x100) << (seg - 1);
+	return (alaw & 0x80) ? i : -i;
+}
+
+static s16
+ulaw2linear(u8 ulaw)
+{
+	int t;
+
+	ulaw = ~ulaw;
+	t = (((ulaw & 0x0f) << 3) + 0x84) << ((ulaw & 0x70) >> 4);
+	return (ulaw & 0x80) ? (0x84 - t) : (t - 0x84);
+}
+
+static u8
+linear2alaw(int pcm)
+{
+	int mask = 0xd5, seg;
+
+	if (pcm < 0) {
+		mask = 0x55;
+		pcm = -pcm;
+	}
+	if (pcm > 0x7fff)
+		pcm = 0x7fff;
+	seg = fls(pcm >> 8);
+	return ((seg << 4) | ((pcm >> (seg ? seg + 3 : 4)) & 0x0f)) ^ mask;
+}
+
+static u8
+linear2ulaw(int pcm)
+{
+	int sign = 0, exponent;
+
+	if (pcm < 0) {
+		sign = 0x80;
+		pcm = -pcm;
+	}
+	if (pcm > 32635)
+		pcm = 32635;
+	pcm += 0x84;
+	exponent = fls(pcm) - 8;
+	return ~(sign | (exponent << 4) | ((pcm >> (exponent + 3)) & 0x0f));
+}
+
+u8
+l1oip_linear_to_law(int sample)
+{
+	if (law_is_ulaw)
+		return bitrev8(linear2ulaw(sample));
+	return bitrev8(linear2alaw(sample));
+}
+
+s16
+l1oip_law_to_linear(u8 law)
+{
+	return law_to_linear[law];
+}
+
+void
+l1oip_law_init(int ulaw)
+{
+	int i;
+
+	law_is_ulaw = ulaw;
+	for (i = 0; i < 256; i++) {
+		if (ulaw)
+			law_to_linear[i] = ulaw2linear(bitrev8((u8)i));
+		else
+			law_to_linear[i] = alaw2linear(bitrev8((u8)i));
+	}
+}
+
+
+/*
+ * level detection and comfort noise
+ */
+
+/* returns the mean absolute amplitude of the given law samples */
+int
+l1oip_law_level(u8 *data, int len)
+{
+	u32 sum = 0;
+	int i;
+
+	if (!len)
+		return 0;
+	for (i = 0; i < len; i++)
+		sum += abs(law_to_linear[data[i]]);
+	return sum / len;
+}
+
+/* generates white noise with the given mean absolute amplitude */
+void
+l1oip_law_noise(u8 *result, int len, int level, u32 *seed)
+{
+	u8 silence = l1oip_linear_to_law(0);
+	s32 r;
+	int i;
+
+	if (!level) {
+		memset(result, silence, len);
+		return;
+	}
+	for (i = 0; i < len; i++) {
+		*seed = *seed * 1103515245 + 12345;
+		/* uniform noise in -2*level..2*level has mean level */
+		r = (s32)((*seed >> 16) & 0xffff) - 32768;
+		result[i] = l1oip_linear_to_law((r * level) >> 14);
+	}
+}
+
+
+/*
+ * G.726 ADPCM
+ *
+ * The algorithm follows the ITU-T G.726 reference (formerly G.721 and
+ * G.723) in integer arithmetic. Samples are converted from/to law through
+ * the linear tables, so no synchronous coding adjustment is done.
+ *
+ * 32 kbit/s: two 4 bit codes per byte, first sample in upper bits.
+ * 24 kbit/s: eight 3 bit codes in three bytes, first sample in upper bits.
+ *
+ * The encoder keeps samples that do not fill a complete byte (group) and
+ * sends them with the next frame, as the 4 bit codec does.
+ */
+
+static short power2[15] = {
+	1, 2, 4, 8, 0x10, 0x20, 0x40, 0x80,
+	0x100, 0x200, 0x400, 0x800, 0x1000, 0x2000, 0x4000
+};
+
+/* 32 kbit/s tables */
+static short qtab_32[7] = {-124, 80, 178, 246, 300, 349, 400};
+static short dqlntab_32[16] = {
+	-2048, 4, 135, 213, 273, 323, 373, 425,
+	425, 373, 323, 273, 213, 135, 4, -2048
+};
+static int witab_32[16] = {
+	-384, 576, 1312, 2048, 3584, 6336, 11360, 35904,
+	35904, 11360, 6336, 3584, 2048, 1312, 576, -384
+};
+static short fitab_32[16] = {
+	0, 0, 0, 0x200, 0x200, 0x200, 0x600, 0xe00,
+	0xe00, 0x600, 0x200, 0x200, 0x200, 0, 0, 0
+};
+
+/* 24 kbit/s tables */
+static short qtab_24[3] = {8, 218, 331};
+static short dqlntab_24[8] = {-2048, 135, 273, 373, 373, 273, 135, -2048};
+static int witab_24[8] = {-128, 960, 4384, 18624, 18624, 4384, 960, -128};
+static short fitab_24[8] = {0, 0x200, 0x400, 0xe00, 0xe00, 0x400, 0x200, 0};
+
+static inline int
+g726_quan(int val, short *table, int size)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		if (val < table[i])
+			break;
+	return i;
+}
+
+/* multiply predictor coefficient with signal in floating format */
+static int
+g726_fmult(int an, int srn)
+{
+	short anmag, anexp, anmant;
+	short wanexp, wanmant;
+	short retval;
+
+	anmag = (an > 0) ? an : ((-an) & 0x1fff);
+	anexp = g726_quan(anmag, power2, 15) - 6;
+	anmant = (anmag == 0) ? 32 :
+		(anexp >= 0) ? anmag >> anexp : anmag << -anexp;
+	wanexp = anexp + ((srn >> 6) & 0xf) - 13;
+	wanmant = (anmant * (srn & 0x3f) + 0x30) >> 4;
+	retval = (wanexp >= 0) ? ((wanmant << wanexp) & 0x7fff) :
+		(wanmant >> -wanexp);
+
+	return ((an ^ srn) < 0) ? -retval : retval;
+}
+
+static void
+g726_init(struct l1oip_g726 *st)
+{
+	int i;
+
+	st->yl = 34816;
+	st->yu = 544;
+	st->dms = 0;
+	st->dml = 0;
+	st->ap = 0;
+	st->td = 0;
+	for (i = 0; i < 2; i++) {
+		st->a[i] = 0;
+		st->pk[i] = 0;
+		st->sr[i] = 32;
+	}
+	for (i = 0; i < 6; i++) {
+		st->b[i] = 0;
+		st->dq[i] = 32;
+	}
+}
+
+static int
+g726_predictor_zero(struct l1oip_g726 *st)
+{
+	int i, sezi;
+
+	sezi = g726_fmult(st->b[0] >> 2, st->dq[0]);
+	for (i = 1; i < 6; i++)
+		sezi += g726_fmult(st->b[i] >> 2, st->dq[i]);
+	return sezi;
+}
+
+static int
+g726_predictor_pole(struct l1oip_g726 *st)
+{
+	return g726_fmult(st->a[1] >> 2, st->sr[1]) +
+		g726_fmult(st->a[0] >> 2, st->sr[0]);
+}
+
+static int
+g726_step_size(struct l1oip_g726 *st)
+{
+	int y, dif, al;
+
+	if (st->ap >= 256)
+		return st->yu;
+	y = st->yl >> 6;
+	dif = st->yu - y;
+	al = st->ap >> 2;
+	if (dif > 0)
+		y += (dif * al) >> 6;
+	else if (dif < 0)
+		y += (dif * al + 0x3f) >> 6;
+	return y;
+}
+
+static int
+g726_quantize(int d, int y, short *table, int size)
+{
+	short dqm, exp, mant, dl, dln;
+	int i;
+
+	dqm = abs(d);
+	exp = g726_quan(dqm >> 1, power2, 15);
+	mant = ((dqm << 7) >> exp) & 0x7f;
+	dl = (exp << 7) + mant;
+	dln = dl - (y >> 2);
+	i = g726_quan(dln, table, size);
+	if (d < 0)
+		return (size << 1) + 1 - i;
+	if (i == 0)
+		return (size << 1) + 1;
+	return i;
+}
+
+static int
+g726_reconstruct(int sign, int dqln, int y)
+{
+	short dql, dex, dqt, dq;
+
+	dql = dqln + (y >> 2);
+	if (dql < 0)
+		return sign ? -0x8000 : 0;
+	dex = (dql >> 7) & 15;
+	dqt = 128 + (dql & 127);
+	dq = (dqt << 7) >> (14 - dex);
+	return sign ? (dq - 0x8000) : dq;
+}
+
+static void
+g726_update(int y, int wi, int fi, int dq, int sr, int dqsez,
+	    struct l1oip_g726 *st)
+{
+	short mag, exp, a2p = 0, a1ul, pks1, fa1;
+	short ylint, thr1, thr2, dqthr, ylfrac;
+	int i, tr, pk0;
+
+	pk0 = (dqsez < 0) ? 1 : 0;
+	mag = dq & 0x7fff;
+
+	/* transition detector */
+	ylint = st->yl >> 15;
+	ylfrac = (st->yl >> 10) & 0x1f;
+	thr1 = (32 + ylfrac) << ylint;
+	thr2 = (ylint > 9) ? 31 << 10 : thr1;
+	dqthr = (thr2 + (thr2 >> 1)) >> 1;
+	tr = (st->td && mag > dqthr) ? 1 : 0;
+
+	/* quantizer scale factor adaptation */
+	st->yu = y + ((wi - y) >> 5);
+	if (st->yu < 544)
+		st->yu = 544;
+	else if (st->yu > 5120)
+		st->yu = 5120;
+	st->yl += st->yu + ((-st->yl) >> 6);
+
+	/* adaptive predictor coefficients */
+	if (tr) {
+		st->a[0] = 0;
+		st->a[1] = 0;
+		for (i = 0; i < 6; i++)
+			st->b[i] = 0;
+	} else {
+		pks1 = pk0 ^ st->pk[0];
+		a2p = st->a[1] - (st->a[1] >> 7);
+		if (dqsez != 0) {
+			fa1 = pks1 ? st->a[0] : -st->a[0];
+			if (fa1 < -8191)
+				a2p -= 0x100;
+			else if (fa1 > 8191)
+				a2p += 0xff;
+			else
+				a2p += fa1 >> 5;
+
+			if (pk0 ^ st->pk[1]) {
+				if (a2p <= -12160)
+					a2p = -12288;
+				else if (a2p >= 12416)
+					a2p = 12288;
+				else
+					a2p -= 0x80;
+			} else if (a2p <= -12416)
+				a2p = -12288;
+			else if (a2p >= 12160)
+				a2p = 12288;
+			else
+				a2p += 0x80;
+		}
+		st->a[1] = a2p;
+
+		st->a[0] -= st->a[0] >> 8;
+		if (dqsez != 0) {
+			if (pks1 == 0)
+				st->a[0] += 192;
+			else
+				st->a[0] -= 192;
+		}
+		a1ul = 15360 - a2p;
+		if (st->a[0] < -a1ul)
+			st->a[0] = -a1ul;
+		else if (st->a[0] > a1ul)
+			st->a[0] = a1ul;
+
+		for (i = 0; i < 6; i++) {
+			st->b[i] -= st->b[i] >> 8;
+			if (dq & 0x7fff) {
+				if ((dq ^ st->dq[i]) >= 0)
+					st->b[i] += 128;
+				else
+					st->b[i] -= 128;
+			}
+		}
+	}
+
+	for (i = 5; i > 0; i--)
+		st->dq[i] = st->dq[i - 1];
+	if (mag == 0) {
+		st->dq[0] = (dq >= 0) ? 0x20 : (short)0xfc20;
+	} else {
+		exp = g726_quan(mag, power2, 15);
+		st->dq[0] = (dq >= 0) ?
+			(exp << 6) + ((mag << 6) >> exp) :
+			(exp << 6) + ((mag << 6) >> exp) - 0x400;
+	}
+
+	st->sr[1] = st->sr[0];
+	if (sr == 0) {
+		st->sr[0] = 0x20;
+	} else if (sr > 0) {
+		exp = g726_quan(sr, power2, 15);
+		st->sr[0] = (exp << 6) + ((sr << 6) >> exp);
+	} else if (sr > -32768) {
+		mag = -sr;
+		exp = g726_quan(mag, power2, 15);
+		st->sr[0] = (exp << 6) + ((mag << 6) >> exp) - 0x400;
+	} else
+		st->sr[0] = (short)0xfc20;
+
+	st->pk[1] = st->pk[0];
+	st->pk[0] = pk0;
+
+	/* tone detector */
+	if (tr)
+		st->td = 0;
+	else if (a2p < -11776)
+		st->td = 1;
+	else
+		st->td = 0;
+
+	/* adaptation speed control */
+	st->dms += (fi - st->dms) >> 5;
+	st->dml += (((fi << 2) - st->dml) >> 7);
+	if (tr)
+		st->ap = 256;
+	else if (y < 1536)
+		st->ap += (0x200 - st->ap) >> 4;
+	else if (st->td)
+		st->ap += (0x200 - st->ap) >> 4;
+	else if (abs((st->dms << 2) - st->dml) >= (st->dml >> 3))
+		st->ap += (0x200 - st->ap) >> 4;
+	else
+		st->ap += (-st->ap) >> 4;
+}
+
+/* encode one linear sample (14 bit range) to a code of given bits */
+static int
+g726_encode(struct l1oip_g726 *st, int sl, int bits)
+{
+	int sezi, sez, se, d, y, i, dq, sr, dqsez;
+
+	sezi = g726_predictor_zero(st);
+	sez = sezi >> 1;
+	se = (sezi + g726_predictor_pole(st)) >> 1;
+	d = sl - se;
+	y = g726_step_size(st);
+	if (bits == 4) {
+		i = g726_quantize(d, y, qtab_32, 7);
+		dq = g726_reconstruct(i & 8, dqlntab_32[i], y);
+	} else {
+		i = g726_quantize(d, y, qtab_24, 3);
+		dq = g726_reconstruct(i & 4, dqlntab_24[i], y);
+	}
+	sr = (dq < 0) ? se - (dq & 0x3fff) : se + dq;
+	dqsez = sr + sez - se;
+	if (bits == 4)
+		g726_update(y, witab_32[i], fitab_32[i], dq, sr, dqsez, st);
+	else
+		g726_update(y, witab_24[i], fitab_24[i], dq, sr, dqsez, st);
+	return i;
+}
+
+/* decode a code of given bits to one linear sample (14 bit range) */
+static int
+g726_decode(struct l1oip_g726 *st, int i, int bits)
+{
+	int sezi, sez, se, y, dq, sr, dqsez;
+
+	sezi = g726_predictor_zero(st);
+	sez = sezi >> 1;
+	se = (sezi + g726_predictor_pole(st)) >> 1;
+	y = g726_step_size(st);
+	if (bits == 4)
+		dq = g726_reconstruct(i & 8, dqlntab_32[i], y);
+	else
+		dq = g726_reconstruct(i & 4, dqlntab_24[i], y);
+	sr = (dq < 0) ? se - (dq & 0x3fff) : se + dq;
+	dqsez = sr - se + sez;
+	if (bits == 4)
+		g726_update(y, witab_32[i], fitab_32[i], dq, sr, dqsez, st);
+	else
+		g726_update(y, witab_24[i], fitab_24[i], dq, sr, dqsez, st);
+	return sr;
+}
+
+void
+l1oip_adpcm_init(struct l1oip_adpcm *st)
+{
+	g726_init(&st->enc);
+	g726_init(&st->dec);
+	st->pend_len = 0;
+}
+
+/* encodes one group of samples (2 or 8) into 1 or 3 bytes */
+static inline int
+g726_encode_group(struct l1oip_g726 *st, u8 *data, u8 *result, int bits)
+{
+	u32 w = 0;
+	int i;
+
+	if (bits == 4) {
+		w = g726_encode(st, law_to_linear[data[0]] >> 2, 4) << 4;
+		w |= g726_encode(st, law_to_linear[data[1]] >> 2, 4);
+		result[0] = w;
+		return 1;
+	}
+	for (i = 0; i < 8; i++)
+		w = (w << 3) | g726_encode(st, law_to_linear[data[i]] >> 2, 3);
+	result[0] = w >> 16;
+	result[1] = w >> 8;
+	result[2] = w;
+	return 3;
+}
+
+/*
+ * Compresses data to the result buffer
+ * The result size must be at least half of the input buffer.
+ */
+int
+l1oip_law_to_adpcm(u8 *data, int len, u8 *result, struct l1oip_adpcm *st,
+		   int bits)
+{
+	int group = (bits == 4) ? 2 : 8;
+	int l, o = 0;
+
+	/* complete pending group first */
+	if (st->pend_len) {
+		l = min(group - st->pend_len, len);
+		memcpy(st->pend + st->pend_len, data, l);
+		st->pend_len += l;
+		data += l;
+		len -= l;
+		if (st->pend_len < group)
+			return 0;
+		o += g726_encode_group(&st->enc, st->pend, result, bits);
+		st->pend_len = 0;
+	}
+
+	while (len >= group) {
+		o += g726_encode_group(&st->enc, data, result + o, bits);
+		data += group;
+		len -= group;
+	}
+
+	/* save remaining samples for next call */
+	memcpy(st->pend, data, len);
+	st->pend_len = len;
+
+	return o;
+}
+
+/*
+ * Decompress data to the result buffer
+ * The result size must be 2 (32 kbit/s) or 8/3 (24 kbit/s) times the input.
+ */
+int
+l1oip_adpcm_to_law(u8 *data, int len, u8 *result, struct l1oip_adpcm *st,
+		   int bits)
+{
+	u32 w;
+	int i, o = 0;
+
+	if (bits == 4) {
+		while (len--) {
+			result[o++] = l1oip_linear_to_law(
+				g726_decode(&st->dec, *data >> 4, 4) << 2);
+			result[o++] = l1oip_linear_to_law(
+				g726_decode(&st->dec, *data & 0xf, 4) << 2);
+			data++;
+		}
+		return o;
+	}
+
+	while (len >= 3) {
+		w = data[0] << 16 | data[1] << 8 | data[2];
+		for (i = 21; i >= 0; i -= 3)
+			result[o++] = l1oip_linear_to_law(
+				g726_decode(&st->dec, (w >> i) & 7, 3) << 2);
+		data += 3;
+		len -= 3;
+	}
+	return o;
+}
+
+/*
+ * G.726 known answer test
+ *
+ * A 1 kHz tone followed by noise is encoded and decoded at both rates.
+ * The decoder state must track the encoder state after every sample, and
+ * a hash of the codes and decoded samples must match the known answer.
+ * The known answers were taken from this implementation, so the test
+ * catches changes of the coder, not deviations from the ITU vectors.
+ */
+#define G726_TEST_LEN	800
+
+static const short g726_test_tone[8] = {
+	0, 2828, 4000, 2828, 0, -2828, -4000, -2828
+};
+
+static const struct {
+	int	bits;
+	u32	hash;
+	int	min_snr;	/* dB */
+} g726_test[] = {
+	{ 4, 0x635dfa7b, 12 },
+	{ 3, 0xefe82b03, 9 },
+};
+
+static int
+g726_selftest_one(int bits, u32 *hash, int *snr)
+{
+	struct l1oip_g726 enc, dec;
+	u64 sig = 0, err = 0;
+	u32 seed = 1;
+	int i, sl, code, sr;
+
+	g726_init(&enc);
+	g726_init(&dec);
+	*hash = 0;
+	for (i = 0; i < G726_TEST_LEN; i++) {
+		if (i < G726_TEST_LEN / 2) {
+			sl = g726_test_tone[i & 7];
+		} else {
+			seed = seed * 1103515245 + 12345;
+			sl = ((s32)((seed >> 16) & 0xffff) - 32768) >> 5;
+		}
+		code = g726_encode(&enc, sl, bits);
+		sr = g726_decode(&dec, code, bits);
+		if (memcmp(&enc, &dec, sizeof(enc)))
+			return i + 1;
+		*hash = (*hash * 33) ^ (code << 16) ^ (u16)sr;
+		sig += sl * sl;
+		err += (sl - sr) * (sl - sr);
+	}
+	/* about 3 dB per bit */
+	*snr = 3 * (ilog2(sig) - ilog2(err ? err : 1));
+	return 0;
+}
+
+int
+l1oip_g726_selftest(void)
+{
+	u64 start, ns;
+	u32 hash;
+	int i, ret, snr;
+
+	for (i = 0; i < ARRAY_SIZE(g726_test); i++) {
+		start = ktime_get_ns();
+		ret = g726_selftest_one(g726_test[i].bits, &hash, &snr);
+		ns = ktime_get_ns() - start;
+		if (ret) {
+			printk(KERN_ERR "%s: %d kbit/s decoder lost track at "
+			       "sample %d\n", __func__,
+			       g726_test[i].bits * 8, ret - 1);
+			return -EIO;
+		}
+		if (hash != g726_test[i].hash || snr < g726_test[i].min_snr) {
+			printk(KERN_ERR "%s: %d kbit/s hash %08x (expected "
+			       "%08x), snr %d dB\n", __func__,
+			       g726_test[i].bits * 8, hash, g726_test[i].hash,
+			       snr);
+			return -EIO;
+		}
+		printk(KERN_DEBUG "%s: %d kbit/s ok, snr %d dB, %llu ns per "
+		       "sample (encode and decode)\n", __func__,
+		       g726_test[i].bits * 8, snr,
+		       div_u64(ns, G726_TEST_LEN));
+	}
+	return 0;
+}
+
+
 /*
  * generate/free compression and decompression table
  */
@@ -23,6 +23,8 @@
  Value 1 = transfer ALAW
  Value 2 = transfer ULAW
  Value 3 = transfer generic 4 bit compression.
+ Value 4 = transfer G.726 ADPCM 32 kbit/s
+ Value 5 = transfer G.726 ADPCM 24 kbit/s
 
  * ulaw:
  0 = we use a-Law (default)
@@ -61,6 +63,31 @@
  optional value to identify frames. This value must be equal on both
  peers and should be random. If omitted or 0, no ID is transmitted.
 
+ * vad:
+ 0 = off (default)
+ 1...255 = suppress silent B-channel frames (transparent data only). Frames
+ with a mean absolute amplitude below the given value are not transmitted
+ after a hangover of 200 ms. Instead a comfort noise descriptor is sent when
+ suppression starts and once per second. The remote side regenerates comfort
+ noise until audio is received again. Both peers must support coding 15.
+
+ * shareport:
+ If given, all interfaces share one local UDP port instead of opening one
+ socket and thread per interface. Received frames are assigned to their
+ interface by the ID field, so every interface must have a unique ID != 0.
+ The port parameter is ignored, the remote port defaults to shareport.
+
+ * workers:
+ Number of receive workers on the shared port (1...8, default 2). Each worker
+ owns a socket bound to the shared port with SO_REUSEPORT, so frames of one
+ peer are always received by the same worker and stay in order.
+
+ * encap:
+ 0 = receive frames with a thread per socket (default)
+ 1 = receive frames with an UDP encapsulation callback. Frames are parsed in
+ softirq context as they arrive, no receive thread is created. On the shared
+ port only one socket is used and the workers parameter is ignored.
+
  * debug:
  NOTE: only one debug value must be given for all cards
  enable debugging (see l1oip.h for debug options)
@@ -143,6 +170,13 @@
  Must be 0 for no transcoding. Also for D-channel and other HDLC frames.
  1 and 2 are reserved for explicitly use of a-LAW or u-LAW codec.
  3 is used for generic table compressor.
+ 4 is used for G.726 ADPCM 32 kbit/s (two codes per byte, first code in upper
+ bits).
+ 5 is used for G.726 ADPCM 24 kbit/s (eight codes in three bytes, first code
+ in upper bits).
+ 15 is used for comfort noise descriptor. The data is a single byte with the
+ noise level (mean absolute linear amplitude, 255 max). The time base is the
+ first suppressed sample.
 
  - M = More channels to come. If this flag is 1, the following byte contains
  the length of the channel data. After the data block, the next channel will
@@ -205,6 +239,15 @@
  To change the socket, a recall of l1oip_socket_open() will safely kill the
  socket process and create a new one.
 
+ In encap mode, no thread is used. The socket is created by
+ l1oip_socket_open() and frames are received by l1oip_encap_rcv().
+
+ In shared port mode, the sockets and threads are created once for all
+ interfaces by l1oip_share_open(). hc->socket then refers to the first shared
+ socket and is only taken away from the interfaces when the module unloads.
+ Setting a new peer only changes the remote address of the interface.
+ Statistics of each interface are available in debugfs at l1oip/<name>.
+
 */
 
 #define L1OIP_VERSION	0	/* 0...3 */
@@ -221,8 +264,12 @@
 #include <linux/kthread.h>
 #include <linux/slab.h>
 #include <linux/sched/signal.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/hashtable.h>
 
 #include <net/sock.h>
+#include <net/udp_tunnel.h>
 #include "core.h"
 #include "l1oip.h"
 
@@ -231,8 +278,11 @@ static const char *l1oip_revision = "2.00";
 static int l1oip_cnt;
 static spinlock_t l1oip_lock;
 static struct list_head l1oip_ilist;
+static struct l1oip_share l1oip_share;
+static DEFINE_HASHTABLE(l1oip_idhash, 6);
+static struct dentry *l1oip_debugfs;
 
-#define MAX_CARDS	16
+#define MAX_CARDS	64
 static u_int type[MAX_CARDS];
 static u_int codec[MAX_CARDS];
 static u_int ip[MAX_CARDS * 4];
@@ -241,8 +291,12 @@ static u_int remoteport[MAX_CARDS];
 static u_int ondemand[MAX_CARDS];
 static u_int limit[MAX_CARDS];
 static u_int id[MAX_CARDS];
+static u_int vad[MAX_CARDS];
 static int debug;
 static int ulaw;
+static u_int shareport;
+static u_int workers = 2;
+static u_int encap;
 
 MODULE_AUTHOR("Andreas Eversberg");
 MODULE_LICENSE("GPL");
@@ -254,8 +308,12 @@ module_param_array(remoteport, uint, NULL, S_IRUGO | S_IWUSR);
 module_param_array(ondemand, uint, NULL, S_IRUGO | S_IWUSR);
 module_param_array(limit, uint, NULL, S_IRUGO | S_IWUSR);
 module_param_array(id, uint, NULL, S_IRUGO | S_IWUSR);
+module_param_array(vad, uint, NULL, S_IRUGO | S_IWUSR);
 module_param(ulaw, uint, S_IRUGO | S_IWUSR);
 module_param(debug, uint, S_IRUGO | S_IWUSR);
+module_param(shareport, uint, S_IRUGO);
+module_param(workers, uint, S_IRUGO);
+module_param(encap, uint, S_IRUGO);
 
 /*
  * send a frame via socket, if open and restart timer
@@ -288,6 +346,7 @@ l1oip_socket_send(struct l1oip *hc, u8 localcodec, u8 channel, u32 chanmask,
 		if (debug & DEBUG_L1OIP_MSG)
 			printk(KERN_DEBUG "%s: dropping frame, because remote "
 			       "IP is not set.\n", __func__);
+		atomic_long_inc(&hc->stats.tx_dropped);
 		return len;
 	}
 
@@ -314,6 +373,12 @@ l1oip_socket_send(struct l1oip *hc, u8 localcodec, u8 channel, u32 chanmask,
 		else if (localcodec == 3)
 			len = l1oip_law_to_4bit(buf, len, p,
 						&hc->chan[channel].codecstate);
+		else if (localcodec == L1OIP_CODEC_G726_32)
+			len = l1oip_law_to_adpcm(buf, len, p,
+						 &hc->chan[channel].adpcm, 4);
+		else if (localcodec == L1OIP_CODEC_G726_24)
+			len = l1oip_law_to_adpcm(buf, len, p,
+						 &hc->chan[channel].adpcm, 3);
 		else
 			memcpy(p, buf, len);
 	}
@@ -323,6 +388,7 @@ l1oip_socket_send(struct l1oip *hc, u8 localcodec, u8 channel, u32 chanmask,
 	spin_lock(&hc->socket_lock);
 	if (!hc->socket) {
 		spin_unlock(&hc->socket_lock);
+		atomic_long_inc(&hc->stats.tx_dropped);
 		return 0;
 	}
 	/* seize socket */
@@ -336,6 +402,11 @@ l1oip_socket_send(struct l1oip *hc, u8 localcodec, u8 channel, u32 chanmask,
 	hc->sendiov.iov_base = frame;
 	hc->sendiov.iov_len  = len;
 	len = kernel_sendmsg(socket, &hc->sendmsg, &hc->sendiov, 1, len);
+	if (len > 0) {
+		atomic_long_inc(&hc->stats.tx_frames);
+		atomic_long_add(len, &hc->stats.tx_bytes);
+	} else
+		atomic_long_inc(&hc->stats.tx_dropped);
 	/* give socket back */
 	hc->socket = socket; /* no locking required */
 
@@ -343,6 +414,146 @@ l1oip_socket_send(struct l1oip *hc, u8 localcodec, u8 channel, u32 chanmask,
 }
 
 
+/*
+ * voice activity detection, returns 1 if frame is suppressed
+ */
+static int
+l1oip_vad_suppress(struct l1oip *hc, u8 channel, u8 *buf, int len)
+{
+	struct l1oip_chan *chan = &hc->chan[channel];
+	int level = l1oip_law_level(buf, len);
+	u8 cn;
+
+	if (level >= hc->vad) {
+		chan->vad_hang = L1OIP_VAD_HANGOVER;
+		chan->cn_sent = 0;
+		return 0;
+	}
+
+	/* track the background noise */
+	chan->vad_level = (chan->vad_level * 7 + level) >> 3;
+	if (chan->vad_hang > 0) {
+		chan->vad_hang -= len;
+		return 0;
+	}
+
+	chan->vad_frames++;
+	chan->vad_saved += len;
+	if (!chan->cn_sent ||
+	    chan->tx_counter - chan->cn_tx_counter >= L1OIP_CN_INTERVAL) {
+		cn = min(chan->vad_level, 255);
+		l1oip_socket_send(hc, L1OIP_CODEC_CN, channel, 0,
+				  chan->tx_counter, &cn, 1);
+		chan->vad_saved--;
+		chan->cn_sent = 1;
+		chan->cn_tx_counter = chan->tx_counter;
+	}
+	chan->tx_counter += len;
+	return 1;
+}
+
+
+/*
+ * expand 16 bit sequence number to 32 bit sequence number
+ */
+static u32
+l1oip_expand_timebase(struct l1oip_chan *chan, u16 timebase)
+{
+	u32 rx_counter = chan->rx_counter;
+
+	if (((s16)(timebase - rx_counter)) >= 0) {
+		/* time has changed forward */
+		if (timebase >= (rx_counter & 0xffff))
+			rx_counter =
+				(rx_counter & 0xffff0000) | timebase;
+		else
+			rx_counter = ((rx_counter & 0xffff0000) + 0x10000)
+				| timebase;
+	} else {
+		/* time has changed backwards */
+		if (timebase < (rx_counter & 0xffff))
+			rx_counter =
+				(rx_counter & 0xffff0000) | timebase;
+		else
+			rx_counter = ((rx_counter & 0xffff0000) - 0x10000)
+				| timebase;
+	}
+	chan->rx_counter = rx_counter;
+	return rx_counter;
+}
+
+
+/*
+ * comfort noise
+ */
+static void
+l1oip_cn_start(struct l1oip *hc, u8 channel, u16 timebase, u8 level)
+{
+	struct l1oip_chan *chan = &hc->chan[channel];
+	u32 rx_counter = l1oip_expand_timebase(chan, timebase);
+
+	chan->cn_rx++;
+	chan->cn_level = level;
+	if (!chan->cn_active) {
+		if (debug & DEBUG_L1OIP_MSG)
+			printk(KERN_DEBUG "%s: channel %d starts comfort noise "
+			       "(level %d)\n", __func__, channel, level);
+		chan->cn_active = 1;
+		chan->cn_counter = rx_counter;
+		chan->cn_jiffies = jiffies;
+	} else if ((s32)(rx_counter - chan->cn_counter) > 0)
+		chan->cn_counter = rx_counter; /* sender is ahead, resync */
+	if (!timer_pending(&hc->cn_tl))
+		mod_timer(&hc->cn_tl,
+			  jiffies + msecs_to_jiffies(L1OIP_CN_FRAME));
+}
+
+static void
+l1oip_cn_timer(struct timer_list *t)
+{
+	struct l1oip *hc = from_timer(hc, t, cn_tl);
+	struct l1oip_chan *chan;
+	struct sk_buff *nskb;
+	int ch, len, active = 0;
+
+	spin_lock(&hc->rx_lock);
+	for (ch = 1; ch < 128; ch++) {
+		chan = &hc->chan[ch];
+		if (!chan->cn_active || !chan->bch)
+			continue;
+		if (!test_bit(FLG_ACTIVE, &chan->bch->Flags)) {
+			chan->cn_active = 0;
+			continue;
+		}
+		active = 1;
+		/* generate the samples of the elapsed time */
+		len = jiffies_to_usecs(jiffies - chan->cn_jiffies) / 125;
+		if (!len)
+			continue;
+		if (len > L1OIP_MAX_PERFRAME)
+			len = L1OIP_MAX_PERFRAME;
+		chan->cn_jiffies = jiffies;
+		nskb = mI_alloc_skb(len, GFP_ATOMIC);
+		if (!nskb) {
+			printk(KERN_ERR "%s: No mem for skb.\n", __func__);
+			continue;
+		}
+		l1oip_law_noise(skb_put(nskb, len), len, chan->cn_level,
+				&chan->cn_seed);
+		queue_ch_frame(&chan->bch->ch, PH_DATA_IND, chan->cn_counter,
+			       nskb);
+		chan->cn_counter += len;
+		chan->rx_counter = chan->cn_counter;
+		chan->cn_frames++;
+	}
+	spin_unlock(&hc->rx_lock);
+
+	if (active)
+		mod_timer(&hc->cn_tl,
+			  jiffies + msecs_to_jiffies(L1OIP_CN_FRAME));
+}
+
+
 /*
  * receive channel data from socket
  */
@@ -355,6 +566,7 @@ l1oip_socket_recv(struct l1oip *hc, u8 remotecodec, u8 channel, u16 timebase,
 	struct dchannel *dch;
 	u8 *p;
 	u32 rx_counter;
+	int slen;
 
 	if (len == 0) {
 		if (debug & DEBUG_L1OIP_MSG)
@@ -380,13 +592,33 @@ l1oip_socket_recv(struct l1oip *hc, u8 remotecodec, u8 channel, u16 timebase,
 		return;
 	}
 
+	/* silence is suppressed, regenerate noise until data arrives */
+	if (remotecodec == L1OIP_CODEC_CN) {
+		if (bch)
+			l1oip_cn_start(hc, channel, timebase, buf[0]);
+		return;
+	}
+
 	/* prepare message */
-	nskb = mI_alloc_skb((remotecodec == 3) ? (len << 1) : len, GFP_ATOMIC);
+	switch (remotecodec) {
+	case 3:
+	case L1OIP_CODEC_G726_32:
+		slen = len << 1;
+		break;
+	case L1OIP_CODEC_G726_24:
+		slen = (len / 3) << 3;
+		break;
+	default:
+		slen = len;
+	}
+	if (!slen)
+		return;
+	nskb = mI_alloc_skb(slen, GFP_ATOMIC);
 	if (!nskb) {
 		printk(KERN_ERR "%s: No mem for skb.\n", __func__);
 		return;
 	}
-	p = skb_put(nskb, (remotecodec == 3) ? (len << 1) : len);
+	p = skb_put(nskb, slen);
 
 	if (remotecodec == 1 && ulaw)
 		l1oip_alaw_to_ulaw(buf, len, p);
@@ -394,6 +626,12 @@ l1oip_socket_recv(struct l1oip *hc, u8 remotecodec, u8 channel, u16 timebase,
 		l1oip_ulaw_to_alaw(buf, len, p);
 	else if (remotecodec == 3)
 		len = l1oip_4bit_to_law(buf, len, p);
+	else if (remotecodec == L1OIP_CODEC_G726_32)
+		len = l1oip_adpcm_to_law(buf, len, p,
+					 &hc->chan[channel].adpcm, 4);
+	else if (remotecodec == L1OIP_CODEC_G726_24)
+		len = l1oip_adpcm_to_law(buf, len, p,
+					 &hc->chan[channel].adpcm, 3);
 	else
 		memcpy(p, buf, len);
 
@@ -403,26 +641,9 @@ l1oip_socket_recv(struct l1oip *hc, u8 remotecodec, u8 channel, u16 timebase,
 		recv_Dchannel(dch);
 	}
 	if (bch) {
-		/* expand 16 bit sequence number to 32 bit sequence number */
-		rx_counter = hc->chan[channel].rx_counter;
-		if (((s16)(timebase - rx_counter)) >= 0) {
-			/* time has changed forward */
-			if (timebase >= (rx_counter & 0xffff))
-				rx_counter =
-					(rx_counter & 0xffff0000) | timebase;
-			else
-				rx_counter = ((rx_counter & 0xffff0000) + 0x10000)
-					| timebase;
-		} else {
-			/* time has changed backwards */
-			if (timebase < (rx_counter & 0xffff))
-				rx_counter =
-					(rx_counter & 0xffff0000) | timebase;
-			else
-				rx_counter = ((rx_counter & 0xffff0000) - 0x10000)
-					| timebase;
-		}
-		hc->chan[channel].rx_counter = rx_counter;
+		rx_counter = l1oip_expand_timebase(&hc->chan[channel],
+						   timebase);
+		hc->chan[channel].cn_active = 0;
 
 #ifdef REORDER_DEBUG
 		if (hc->chan[channel].disorder_flag) {
@@ -440,7 +661,7 @@ l1oip_socket_recv(struct l1oip *hc, u8 remotecodec, u8 channel, u16 timebase,
 /*
  * parse frame and extract channel data
  */
-static void
+static int
 l1oip_socket_parse(struct l1oip *hc, struct sockaddr_in *sin, u8 *buf, int len)
 {
 	u32			packet_id;
@@ -459,26 +680,26 @@ l1oip_socket_parse(struct l1oip *hc, struct sockaddr_in *sin, u8 *buf, int len)
 	if (len < 1 + 1 + 2) {
 		printk(KERN_WARNING "%s: packet error - length %d below "
 		       "4 bytes\n", __func__, len);
-		return;
+		return -EINVAL;
 	}
 
 	/* check version */
 	if (((*buf) >> 6) != L1OIP_VERSION) {
 		printk(KERN_WARNING "%s: packet error - unknown version %d\n",
 		       __func__, buf[0]>>6);
-		return;
+		return -EINVAL;
 	}
 
 	/* check type */
 	if (((*buf) & 0x20) && !hc->pri) {
 		printk(KERN_WARNING "%s: packet error - received E1 packet "
 		       "on S0 interface\n", __func__);
-		return;
+		return -EINVAL;
 	}
 	if (!((*buf) & 0x20) && hc->pri) {
 		printk(KERN_WARNING "%s: packet error - received S0 packet "
 		       "on E1 interface\n", __func__);
-		return;
+		return -EINVAL;
 	}
 
 	/* get id flag */
@@ -486,10 +707,11 @@ l1oip_socket_parse(struct l1oip *hc, struct sockaddr_in *sin, u8 *buf, int len)
 
 	/* check coding */
 	remotecodec = (*buf) & 0x0f;
-	if (remotecodec > 3) {
+	if (remotecodec > L1OIP_CODEC_G726_24 &&
+	    remotecodec != L1OIP_CODEC_CN) {
 		printk(KERN_WARNING "%s: packet error - remotecodec %d "
 		       "unsupported\n", __func__, remotecodec);
-		return;
+		return -EINVAL;
 	}
 	buf++;
 	len--;
@@ -499,12 +721,12 @@ l1oip_socket_parse(struct l1oip *hc, struct sockaddr_in *sin, u8 *buf, int len)
 		if (!hc->id) {
 			printk(KERN_WARNING "%s: packet error - packet has id "
 			       "0x%x, but we have not\n", __func__, packet_id);
-			return;
+			return -EINVAL;
 		}
 		if (len < 4) {
 			printk(KERN_WARNING "%s: packet error - packet too "
 			       "short for ID value\n", __func__);
-			return;
+			return -EINVAL;
 		}
 		packet_id = (*buf++) << 24;
 		packet_id += (*buf++) << 16;
@@ -516,13 +738,13 @@ l1oip_socket_parse(struct l1oip *hc, struct sockaddr_in *sin, u8 *buf, int len)
 			printk(KERN_WARNING "%s: packet error - ID mismatch, "
 			       "got 0x%x, we 0x%x\n",
 			       __func__, packet_id, hc->id);
-			return;
+			return -EINVAL;
 		}
 	} else {
 		if (hc->id) {
 			printk(KERN_WARNING "%s: packet error - packet has no "
 			       "ID, but we have\n", __func__);
-			return;
+			return -EINVAL;
 		}
 	}
 
@@ -531,7 +753,7 @@ multiframe:
 		printk(KERN_WARNING "%s: packet error - packet too short, "
 		       "channel expected at position %d.\n",
 		       __func__, len-len_start + 1);
-		return;
+		return -EINVAL;
 	}
 
 	/* get channel and multiframe flag */
@@ -546,7 +768,7 @@ multiframe:
 			printk(KERN_WARNING "%s: packet error - packet too "
 			       "short, length expected at position %d.\n",
 			       __func__, len_start - len - 1);
-			return;
+			return -EINVAL;
 		}
 
 		mlen = *buf++;
@@ -557,14 +779,14 @@ multiframe:
 			printk(KERN_WARNING "%s: packet error - length %d at "
 			       "position %d exceeds total length %d.\n",
 			       __func__, mlen, len_start-len - 1, len_start);
-			return;
+			return -EINVAL;
 		}
 		if (len == mlen + 3) {
 			printk(KERN_WARNING "%s: packet error - length %d at "
 			       "position %d will not allow additional "
 			       "packet.\n",
 			       __func__, mlen, len_start-len + 1);
-			return;
+			return -EINVAL;
 		}
 	} else
 		mlen = len - 2; /* single frame, subtract timebase */
@@ -573,7 +795,7 @@ multiframe:
 		printk(KERN_WARNING "%s: packet error - packet too short, time "
 		       "base expected at position %d.\n",
 		       __func__, len-len_start + 1);
-		return;
+		return -EINVAL;
 	}
 
 	/* get time base */
@@ -620,6 +842,187 @@ multiframe:
 		hc->sin_remote.sin_addr.s_addr = sin->sin_addr.s_addr;
 		hc->sin_remote.sin_port = sin->sin_port;
 	}
+	return 0;
+}
+
+
+/*
+ * pass received frame to the parser and count it
+ */
+static void
+l1oip_socket_rx(struct l1oip *hc, struct sockaddr_in *sin, u8 *buf, int len)
+{
+	spin_lock_bh(&hc->rx_lock);
+	if (l1oip_socket_parse(hc, sin, buf, len))
+		atomic_long_inc(&hc->stats.rx_errors);
+	else {
+		atomic_long_inc(&hc->stats.rx_frames);
+		atomic_long_add(len, &hc->stats.rx_bytes);
+	}
+	spin_unlock_bh(&hc->rx_lock);
+}
+
+
+/*
+ * set remote address and message header for sending
+ */
+static void
+l1oip_set_remote(struct l1oip *hc)
+{
+	hc->sin_remote.sin_family = AF_INET;
+	hc->sin_remote.sin_addr.s_addr = htonl(hc->remoteip);
+	hc->sin_remote.sin_port = htons((unsigned short)hc->remoteport);
+
+	hc->sendmsg.msg_name = &hc->sin_remote;
+	hc->sendmsg.msg_namelen = sizeof(hc->sin_remote);
+	hc->sendmsg.msg_control = NULL;
+	hc->sendmsg.msg_controllen = 0;
+}
+
+
+/*
+ * take socket away from interface, wait until the send function is done
+ */
+static void
+l1oip_socket_unset(struct l1oip *hc)
+{
+	spin_lock(&hc->socket_lock);
+	/* if hc->socket is NULL, it is in use until it is given back */
+	while (!hc->socket) {
+		spin_unlock(&hc->socket_lock);
+		schedule_timeout(HZ / 10);
+		spin_lock(&hc->socket_lock);
+	}
+	hc->socket = NULL;
+	spin_unlock(&hc->socket_lock);
+}
+
+
+/*
+ * shared port lookup
+ */
+static struct l1oip *
+l1oip_find_id(u32 frame_id)
+{
+	struct l1oip *hc;
+
+	hash_for_each_possible(l1oip_idhash, hc, id_node, frame_id)
+		if (hc->id == frame_id)
+			return hc;
+	return NULL;
+}
+
+/* demultiplex by ID, it is mandatory on shared port */
+static struct l1oip *
+l1oip_share_demux(u8 *buf, int len)
+{
+	struct l1oip *hc;
+	u32 frame_id;
+
+	if (len < 5 || !(buf[0] & 0x10)) {
+		atomic_long_inc(&l1oip_share.unknown);
+		return NULL;
+	}
+	frame_id = buf[1] << 24 | buf[2] << 16 | buf[3] << 8 | buf[4];
+	hc = l1oip_find_id(frame_id);
+	if (!hc) {
+		if (debug & DEBUG_L1OIP_SOCKET)
+			printk(KERN_DEBUG "%s: no interface with id 0x%x\n",
+			       __func__, frame_id);
+		atomic_long_inc(&l1oip_share.unknown);
+	}
+	return hc;
+}
+
+
+/*
+ * UDP encapsulation receive, called in softirq context
+ *
+ * sk_user_data is the interface, or &l1oip_share for the shared port.
+ */
+static int
+l1oip_encap_rcv(struct sock *sk, struct sk_buff *skb)
+{
+	void *data = rcu_dereference_sk_user_data(sk);
+	struct l1oip *hc = data;
+	struct sockaddr_in sin_rx;
+	u8 *buf;
+	int len;
+
+	if (!data || skb_linearize(skb))
+		goto drop;
+	buf = skb->data + sizeof(struct udphdr);
+	len = skb->len - sizeof(struct udphdr);
+	if (data == &l1oip_share) {
+		hc = l1oip_share_demux(buf, len);
+		if (!hc)
+			goto drop;
+	}
+	sin_rx.sin_family = AF_INET;
+	sin_rx.sin_addr.s_addr = ip_hdr(skb)->saddr;
+	sin_rx.sin_port = udp_hdr(skb)->source;
+	l1oip_socket_rx(hc, &sin_rx, buf, len);
+	consume_skb(skb);
+	return 0;
+
+drop:
+	kfree_skb(skb);
+	return 0;
+}
+
+static int
+l1oip_encap_sock(u16 port, void *data, struct socket **sockp)
+{
+	struct udp_port_cfg udp_conf = {
+		.family = AF_INET,
+		.local_ip.s_addr = htonl(INADDR_ANY),
+		.local_udp_port = htons(port),
+	};
+	struct udp_tunnel_sock_cfg tunnel_cfg = {
+		.sk_user_data = data,
+		.encap_type = L1OIP_UDP_ENCAP,
+		.encap_rcv = l1oip_encap_rcv,
+	};
+	int err;
+
+	err = udp_sock_create(&init_net, &udp_conf, sockp);
+	if (err) {
+		printk(KERN_ERR "%s: Failed (%d) to bind socket to port %d.\n",
+		       __func__, err, port);
+		*sockp = NULL;
+		return err;
+	}
+	setup_udp_tunnel_sock(&init_net, *sockp, &tunnel_cfg);
+	return 0;
+}
+
+static int
+l1oip_encap_open(struct l1oip *hc)
+{
+	struct socket *socket;
+	int err;
+
+	hc->sin_local.sin_family = AF_INET;
+	hc->sin_local.sin_addr.s_addr = INADDR_ANY;
+	hc->sin_local.sin_port = htons((unsigned short)hc->localport);
+
+	err = l1oip_encap_sock(hc->localport, hc, &socket);
+	if (err)
+		return err;
+	hc->rx_socket = socket;
+
+	/* set outgoing address and build send message */
+	l1oip_set_remote(hc);
+
+	/* give away socket */
+	spin_lock(&hc->socket_lock);
+	hc->socket = socket;
+	spin_unlock(&hc->socket_lock);
+
+	if (debug & DEBUG_L1OIP_SOCKET)
+		printk(KERN_DEBUG "%s: socket created with encap callback\n",
+		       __func__);
+	return 0;
 }
 
 
@@ -667,11 +1070,6 @@ l1oip_socket_thread(void *data)
 	hc->sin_local.sin_addr.s_addr = INADDR_ANY;
 	hc->sin_local.sin_port = htons((unsigned short)hc->localport);
 
-	/* set outgoing address */
-	hc->sin_remote.sin_family = AF_INET;
-	hc->sin_remote.sin_addr.s_addr = htonl(hc->remoteip);
-	hc->sin_remote.sin_port = htons((unsigned short)hc->remoteport);
-
 	/* bind to incoming port */
 	if (socket->ops->bind(socket, (struct sockaddr *)&hc->sin_local,
 			      sizeof(hc->sin_local))) {
@@ -688,11 +1086,8 @@ l1oip_socket_thread(void *data)
 		goto fail;
 	}
 
-	/* build send message */
-	hc->sendmsg.msg_name = &hc->sin_remote;
-	hc->sendmsg.msg_namelen = sizeof(hc->sin_remote);
-	hc->sendmsg.msg_control = NULL;
-	hc->sendmsg.msg_controllen = 0;
+	/* set outgoing address and build send message */
+	l1oip_set_remote(hc);
 
 	/* give away socket */
 	spin_lock(&hc->socket_lock);
@@ -707,7 +1102,7 @@ l1oip_socket_thread(void *data)
 		iov_iter_kvec(&msg.msg_iter, READ, &iov, 1, recvbuf_size);
 		recvlen = sock_recvmsg(socket, &msg, 0);
 		if (recvlen > 0) {
-			l1oip_socket_parse(hc, &sin_rx, recvbuf, recvlen);
+			l1oip_socket_rx(hc, &sin_rx, recvbuf, recvlen);
 		} else {
 			if (debug & DEBUG_L1OIP_SOCKET)
 				printk(KERN_WARNING
@@ -716,15 +1111,7 @@ l1oip_socket_thread(void *data)
 	}
 
 	/* get socket back, check first if in use, maybe by send function */
-	spin_lock(&hc->socket_lock);
-	/* if hc->socket is NULL, it is in use until it is given back */
-	while (!hc->socket) {
-		spin_unlock(&hc->socket_lock);
-		schedule_timeout(HZ / 10);
-		spin_lock(&hc->socket_lock);
-	}
-	hc->socket = NULL;
-	spin_unlock(&hc->socket_lock);
+	l1oip_socket_unset(hc);
 
 	if (debug & DEBUG_L1OIP_SOCKET)
 		printk(KERN_DEBUG "%s: socket thread terminating\n",
@@ -762,6 +1149,20 @@ l1oip_socket_close(struct l1oip *hc)
 		wait_for_completion(&hc->socket_complete);
 	}
 
+	/* release encap socket */
+	if (hc->rx_socket) {
+		l1oip_socket_unset(hc);
+		udp_tunnel_sock_release(hc->rx_socket);
+		hc->rx_socket = NULL;
+		/*
+		 * udp_tunnel_sock_release() only clears sk_user_data. A
+		 * l1oip_encap_rcv() that fetched hc before is still running
+		 * in its RCU read side and uses hc, which release_card()
+		 * frees right after closing the socket.
+		 */
+		synchronize_rcu();
+	}
+
 	/* if active, we send up a PH_DEACTIVATE and deactivate */
 	if (test_bit(FLG_ACTIVE, &dch->Flags)) {
 		if (debug & (DEBUG_L1OIP_MSG | DEBUG_L1OIP_SOCKET))
@@ -776,9 +1177,18 @@ l1oip_socket_close(struct l1oip *hc)
 static int
 l1oip_socket_open(struct l1oip *hc)
 {
+	/* on shared port, only the remote address changes */
+	if (hc->shared) {
+		l1oip_set_remote(hc);
+		return 0;
+	}
+
 	/* in case of reopen, we need to close first */
 	l1oip_socket_close(hc);
 
+	if (encap)
+		return l1oip_encap_open(hc);
+
 	init_completion(&hc->socket_complete);
 
 	/* create receive process */
@@ -799,6 +1209,212 @@ l1oip_socket_open(struct l1oip *hc)
 }
 
 
+/*
+ * shared port stuff
+ */
+static int
+l1oip_share_thread(void *data)
+{
+	int worker = (long)data;
+	struct socket *socket = l1oip_share.socket[worker];
+	struct l1oip *hc;
+	struct sockaddr_in sin_rx;
+	struct kvec iov;
+	struct msghdr msg = {.msg_name = &sin_rx,
+			     .msg_namelen = sizeof(sin_rx)};
+	unsigned char *recvbuf;
+	size_t recvbuf_size = 1500;
+	int recvlen;
+
+	/* allocate buffer memory */
+	recvbuf = kmalloc(recvbuf_size, GFP_KERNEL);
+	if (!recvbuf) {
+		printk(KERN_ERR "%s: Failed to alloc recvbuf.\n", __func__);
+		goto fail;
+	}
+
+	iov.iov_base = recvbuf;
+	iov.iov_len = recvbuf_size;
+
+	/* make daemon */
+	allow_signal(SIGTERM);
+
+	/* read loop */
+	while (!signal_pending(current)) {
+		iov_iter_kvec(&msg.msg_iter, READ, &iov, 1, recvbuf_size);
+		recvlen = sock_recvmsg(socket, &msg, 0);
+		if (recvlen <= 0) {
+			if (debug & DEBUG_L1OIP_SOCKET)
+				printk(KERN_WARNING
+				       "%s: broken pipe on socket\n", __func__);
+			continue;
+		}
+		hc = l1oip_share_demux(recvbuf, recvlen);
+		if (hc)
+			l1oip_socket_rx(hc, &sin_rx, recvbuf, recvlen);
+	}
+
+	if (debug & DEBUG_L1OIP_SOCKET)
+		printk(KERN_DEBUG "%s: worker %d terminating\n",
+		       __func__, worker);
+
+fail:
+	kfree(recvbuf);
+	complete(&l1oip_share.complete[worker]);
+	return 0;
+}
+
+static void
+l1oip_share_close(void)
+{
+	struct l1oip *hc;
+	int i;
+
+	/* take socket away from all interfaces */
+	if (l1oip_share.given) {
+		list_for_each_entry(hc, &l1oip_ilist, list)
+			if (hc->shared)
+				l1oip_socket_unset(hc);
+		l1oip_share.given = 0;
+	}
+
+	for (i = 0; i < L1OIP_MAX_WORKERS; i++) {
+		if (l1oip_share.thread[i]) {
+			send_sig(SIGTERM, l1oip_share.thread[i], 0);
+			wait_for_completion(&l1oip_share.complete[i]);
+			l1oip_share.thread[i] = NULL;
+		}
+		if (l1oip_share.socket[i]) {
+			if (encap)
+				udp_tunnel_sock_release(l1oip_share.socket[i]);
+			else
+				sock_release(l1oip_share.socket[i]);
+			l1oip_share.socket[i] = NULL;
+		}
+	}
+	/*
+	 * a l1oip_encap_rcv() still in its RCU read side may have fetched
+	 * &l1oip_share before the release and demuxes to an interface, wait
+	 * for it before the interfaces are freed
+	 */
+	if (encap)
+		synchronize_rcu();
+}
+
+static int
+l1oip_share_open(void)
+{
+	struct sockaddr_in sin_local;
+	struct task_struct *thread;
+	struct socket *socket;
+	struct l1oip *hc;
+	int i, err;
+
+	sin_local.sin_family = AF_INET;
+	sin_local.sin_addr.s_addr = INADDR_ANY;
+	sin_local.sin_port = htons(l1oip_share.port);
+
+	/* in encap mode, one socket receives by callback */
+	if (encap) {
+		err = l1oip_encap_sock(l1oip_share.port, &l1oip_share,
+				       &l1oip_share.socket[0]);
+		if (err)
+			return err;
+	}
+
+	/* one socket per worker, the kernel keeps each peer on one socket */
+	for (i = 0; !encap && i < l1oip_share.workers; i++) {
+		if (sock_create(PF_INET, SOCK_DGRAM, IPPROTO_UDP, &socket)) {
+			printk(KERN_ERR "%s: Failed to create socket.\n",
+			       __func__);
+			return -EIO;
+		}
+		l1oip_share.socket[i] = socket;
+		sock_set_reuseport(socket->sk);
+		if (socket->ops->bind(socket, (struct sockaddr *)&sin_local,
+				      sizeof(sin_local))) {
+			printk(KERN_ERR "%s: Failed to bind socket to port "
+			       "%d.\n", __func__, l1oip_share.port);
+			return -EINVAL;
+		}
+	}
+
+	/* give away socket for sending */
+	list_for_each_entry(hc, &l1oip_ilist, list) {
+		if (!hc->shared)
+			continue;
+		spin_lock(&hc->socket_lock);
+		hc->socket = l1oip_share.socket[0];
+		spin_unlock(&hc->socket_lock);
+	}
+	l1oip_share.given = 1;
+
+	for (i = 0; !encap && i < l1oip_share.workers; i++) {
+		init_completion(&l1oip_share.complete[i]);
+		thread = kthread_run(l1oip_share_thread, (void *)(long)i,
+				     "l1oip_share/%d", i);
+		if (IS_ERR(thread)) {
+			printk(KERN_ERR "%s: Failed (%ld) to create worker.\n",
+			       __func__, PTR_ERR(thread));
+			return PTR_ERR(thread);
+		}
+		l1oip_share.thread[i] = thread;
+	}
+
+	if (debug & DEBUG_L1OIP_SOCKET)
+		printk(KERN_DEBUG "%s: shared port %d open with %d workers\n",
+		       __func__, l1oip_share.port, l1oip_share.workers);
+	return 0;
+}
+
+
+/*
+ * statistics
+ */
+static int
+l1oip_stats_show(struct seq_file *m, void *unused)
+{
+	struct l1oip *hc = m->private;
+	struct l1oip_chan *chan;
+	int ch;
+
+	seq_printf(m, "port:       %d%s\n", hc->localport,
+		   hc->shared ? " (shared)" : "");
+	seq_printf(m, "tx_frames:  %lu\n",
+		   atomic_long_read(&hc->stats.tx_frames));
+	seq_printf(m, "tx_bytes:   %lu\n",
+		   atomic_long_read(&hc->stats.tx_bytes));
+	seq_printf(m, "tx_dropped: %lu\n",
+		   atomic_long_read(&hc->stats.tx_dropped));
+	seq_printf(m, "rx_frames:  %lu\n",
+		   atomic_long_read(&hc->stats.rx_frames));
+	seq_printf(m, "rx_bytes:   %lu\n",
+		   atomic_long_read(&hc->stats.rx_bytes));
+	seq_printf(m, "rx_errors:  %lu\n",
+		   atomic_long_read(&hc->stats.rx_errors));
+	for (ch = 1; ch < 128; ch++) {
+		chan = &hc->chan[ch];
+		if (!chan->bch || !(chan->vad_frames || chan->cn_rx))
+			continue;
+		seq_printf(m, "channel %d: suppressed %llu frames %llu bytes, "
+			   "cn received %llu generated %llu frames\n", ch,
+			   chan->vad_frames, chan->vad_saved, chan->cn_rx,
+			   chan->cn_frames);
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(l1oip_stats);
+
+static int
+l1oip_unknown_get(void *data, u64 *val)
+{
+	*val = atomic_long_read(&l1oip_share.unknown);
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(l1oip_unknown_fops, l1oip_unknown_get, NULL,
+			 "%llu\n");
+
+
 static void
 l1oip_send_bh(struct work_struct *work)
 {
@@ -941,7 +1557,8 @@ channel_dctrl(struct dchannel *dch, struct mISDN_ctrl_req *cq)
 	case MISDN_CTRL_SETPEER:
 		hc->remoteip = (u32)cq->p1;
 		hc->remoteport = cq->p2 & 0xffff;
-		hc->localport = cq->p2 >> 16;
+		if (!hc->shared) /* shared port cannot be changed */
+			hc->localport = cq->p2 >> 16;
 		if (!hc->remoteport)
 			hc->remoteport = hc->localport;
 		if (debug & DEBUG_L1OIP_SOCKET)
@@ -1124,6 +1741,13 @@ handle_bmsg(struct mISDNchannel *ch, struct sk_buff *skb)
 			queue_ch_frame(ch, PH_DATA_CNF, hh->id, skb);
 			return 0;
 		}
+		/* check for voice activity */
+		if (hc->vad && ch->protocol == ISDN_P_B_RAW &&
+		    l1oip_vad_suppress(hc, bch->slot, skb->data, skb->len)) {
+			skb_trim(skb, 0);
+			queue_ch_frame(ch, PH_DATA_CNF, hh->id, skb);
+			return 0;
+		}
 
 		/* send frame */
 		p = skb->data;
@@ -1148,6 +1772,10 @@ handle_bmsg(struct mISDNchannel *ch, struct sk_buff *skb)
 			printk(KERN_DEBUG "%s: PH_ACTIVATE channel %d (1..%d)\n"
 			       , __func__, bch->slot, hc->b_num + 1);
 		hc->chan[bch->slot].codecstate = 0;
+		l1oip_adpcm_init(&hc->chan[bch->slot].adpcm);
+		hc->chan[bch->slot].vad_hang = 0;
+		hc->chan[bch->slot].cn_sent = 0;
+		hc->chan[bch->slot].cn_active = 0;
 		test_and_set_bit(FLG_ACTIVE, &bch->Flags);
 		skb_trim(skb, 0);
 		queue_ch_frame(ch, PH_ACTIVATE_IND, hh->id, skb);
@@ -1240,9 +1868,13 @@ release_card(struct l1oip *hc)
 
 	cancel_work_sync(&hc->workq);
 
-	if (hc->socket_thread)
+	if (hc->socket_thread || hc->rx_socket)
 		l1oip_socket_close(hc);
 
+	del_timer_sync(&hc->cn_tl);
+
+	debugfs_remove(hc->debugfs);
+
 	if (hc->registered && hc->chan[hc->d_idx].dch)
 		mISDN_unregister_device(&hc->chan[hc->d_idx].dch->dev);
 	for (ch = 0; ch < 128; ch++) {
@@ -1261,6 +1893,8 @@ release_card(struct l1oip *hc)
 
 	spin_lock(&l1oip_lock);
 	list_del(&hc->list);
+	if (hc->shared)
+		hash_del(&hc->id_node);
 	spin_unlock(&l1oip_lock);
 
 	kfree(hc);
@@ -1271,9 +1905,14 @@ l1oip_cleanup(void)
 {
 	struct l1oip *hc, *next;
 
+	/* stop shared workers first, they may access any interface */
+	l1oip_share_close();
+
 	list_for_each_entry_safe(hc, next, &l1oip_ilist, list)
 		release_card(hc);
 
+	debugfs_remove_recursive(l1oip_debugfs);
+
 	l1oip_4bit_free();
 }
 
@@ -1290,6 +1929,8 @@ init_card(struct l1oip *hc, int pri, int bundle)
 	int		i, ch;
 
 	spin_lock_init(&hc->socket_lock);
+	spin_lock_init(&hc->rx_lock);
+	timer_setup(&hc->cn_tl, l1oip_cn_timer, 0);
 	hc->idx = l1oip_cnt;
 	hc->pri = pri;
 	hc->d_idx = pri ? 16 : 3;
@@ -1305,6 +1946,8 @@ init_card(struct l1oip *hc, int pri, int bundle)
 	case 1: /* alaw */
 	case 2: /* ulaw */
 	case 3: /* 4bit */
+	case L1OIP_CODEC_G726_32:
+	case L1OIP_CODEC_G726_24:
 		break;
 	default:
 		printk(KERN_ERR "Codec(%d) not supported.\n",
@@ -1325,6 +1968,25 @@ init_card(struct l1oip *hc, int pri, int bundle)
 	if (debug & DEBUG_L1OIP_INIT)
 		printk(KERN_DEBUG "%s: using id 0x%x\n", __func__, hc->id);
 
+	if (shareport) {
+		if (!hc->id) {
+			printk(KERN_ERR "%s: shareport option requires a non 0 "
+			       "ID for every interface\n", __func__);
+			return -EINVAL;
+		}
+		if (l1oip_find_id(hc->id)) {
+			printk(KERN_ERR "%s: ID 0x%x is already used by other "
+			       "interface on shared port\n", __func__, hc->id);
+			return -EINVAL;
+		}
+		hc->shared = 1;
+	}
+
+	hc->vad = vad[l1oip_cnt];
+	if (debug & DEBUG_L1OIP_INIT)
+		printk(KERN_DEBUG "%s: using silence suppression level %d\n",
+		       __func__, hc->vad);
+
 	hc->ondemand = ondemand[l1oip_cnt];
 	if (hc->ondemand && !hc->id) {
 		printk(KERN_ERR "%s: ondemand option only allowed in "
@@ -1355,7 +2017,10 @@ init_card(struct l1oip *hc, int pri, int bundle)
 		| ip[(l1oip_cnt << 2) + 1] << 16
 		| ip[(l1oip_cnt << 2) + 2] << 8
 		| ip[(l1oip_cnt << 2) + 3];
-	hc->localport = port[l1oip_cnt]?:(L1OIP_DEFAULTPORT + l1oip_cnt);
+	if (hc->shared)
+		hc->localport = shareport;
+	else
+		hc->localport = port[l1oip_cnt]?:(L1OIP_DEFAULTPORT + l1oip_cnt);
 	if (remoteport[l1oip_cnt])
 		hc->remoteport = remoteport[l1oip_cnt];
 	else
@@ -1405,6 +2070,7 @@ init_card(struct l1oip *hc, int pri, int bundle)
 		bch->ch.nr = i + ch;
 		list_add(&bch->ch.list, &dch->dev.bchannels);
 		hc->chan[i + ch].bch = bch;
+		l1oip_adpcm_init(&hc->chan[i + ch].adpcm);
 		set_channelmap(bch->nr, dch->dev.channelmap);
 	}
 	/* TODO: create a parent device for this driver */
@@ -1416,10 +2082,18 @@ init_card(struct l1oip *hc, int pri, int bundle)
 	if (debug & DEBUG_L1OIP_INIT)
 		printk(KERN_DEBUG "%s: Setting up network card(%d)\n",
 		       __func__, l1oip_cnt + 1);
+	if (hc->shared) {
+		spin_lock(&l1oip_lock);
+		hash_add(l1oip_idhash, &hc->id_node, hc->id);
+		spin_unlock(&l1oip_lock);
+	}
 	ret = l1oip_socket_open(hc);
 	if (ret)
 		return ret;
 
+	hc->debugfs = debugfs_create_file(hc->name, 0444, l1oip_debugfs, hc,
+					  &l1oip_stats_fops);
+
 	timer_setup(&hc->keep_tl, l1oip_keepalive, 0);
 	hc->keep_tl.expires = jiffies + 2 * HZ; /* two seconds first time */
 	add_timer(&hc->keep_tl);
@@ -1445,6 +2119,31 @@ l1oip_init(void)
 
 	if (l1oip_4bit_alloc(ulaw))
 		return -ENOMEM;
+	l1oip_law_init(ulaw);
+
+	if ((debug & DEBUG_L1OIP_CODEC) && l1oip_g726_selftest()) {
+		l1oip_4bit_free();
+		return -EIO;
+	}
+
+	if (shareport) {
+		if (shareport > 0xffff || !workers ||
+		    workers > L1OIP_MAX_WORKERS) {
+			printk(KERN_ERR "%s: invalid shareport %d or workers "
+			       "%d (1..%d)\n", __func__, shareport, workers,
+			       L1OIP_MAX_WORKERS);
+			l1oip_4bit_free();
+			return -EINVAL;
+		}
+		l1oip_share.port = shareport;
+		l1oip_share.workers = encap ? 1 : workers;
+	}
+
+	l1oip_debugfs = debugfs_create_dir("l1oip", NULL);
+	if (l1oip_share.port)
+		debugfs_create_file_unsafe("shared_unknown_id", 0444,
+					   l1oip_debugfs, NULL,
+					   &l1oip_unknown_fops);
 
 	l1oip_cnt = 0;
 	while (l1oip_cnt < MAX_CARDS && type[l1oip_cnt]) {
@@ -1498,6 +2197,13 @@ l1oip_init(void)
 
 		l1oip_cnt++;
 	}
+	if (l1oip_share.port) {
+		ret = l1oip_share_open();
+		if (ret) {
+			l1oip_cleanup();
+			return ret;
+		}
+	}
 	printk(KERN_INFO "%d virtual devices registered\n", l1oip_cnt);
 	return 0;
 }
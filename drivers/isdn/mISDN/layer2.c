@@ -51,6 +51,8 @@ enum {
 	EV_L2_T203,
 	EV_L2_T200I,
 	EV_L2_T203I,
+	EV_L2_TACK,
+	EV_L2_TACKI,
 	EV_L2_SET_OWN_BUSY,
 	EV_L2_CLEAR_OWN_BUSY,
 	EV_L2_FRAME_ERROR,
@@ -81,6 +83,8 @@ static char *strL2Event[] =
 	"EV_L2_T203",
 	"EV_L2_T200I",
 	"EV_L2_T203I",
+	"EV_L2_TACK",
+	"EV_L2_TACKI",
 	"EV_L2_SET_OWN_BUSY",
 	"EV_L2_CLEAR_OWN_BUSY",
 	"EV_L2_FRAME_ERROR",
@@ -134,6 +138,24 @@ l2_newid(struct layer2 *l2)
 	return id;
 }
 
+static void
+l2_nl_event(struct layer2 *l2, u_int event, int tei)
+{
+	if (l2->ch.st)
+		mISDN_nl_event(l2->ch.st->dev, event, -1,
+			       (l2->sapi & 0xff) | ((tei & 0xff) << 8), 0);
+}
+
+static void
+l2up_event(struct layer2 *l2, u_int prim)
+{
+	if (prim == DL_ESTABLISH_IND || prim == DL_ESTABLISH_CNF) {
+		l2->established++;
+		l2_nl_event(l2, MISDN_EVENT_L2_ESTABLISH, l2->tei);
+	} else if (prim == DL_RELEASE_IND || prim == DL_RELEASE_CNF)
+		l2_nl_event(l2, MISDN_EVENT_L2_RELEASE, l2->tei);
+}
+
 static void
 l2up(struct layer2 *l2, u_int prim, struct sk_buff *skb)
 {
@@ -141,6 +163,7 @@ l2up(struct layer2 *l2, u_int prim, struct sk_buff *skb)
 
 	if (!l2->up)
 		return;
+	l2up_event(l2, prim);
 	mISDN_HEAD_PRIM(skb) = prim;
 	mISDN_HEAD_ID(skb) = (l2->ch.nr << 16) | l2->ch.addr;
 	err = l2->up->send(l2->up, skb);
@@ -160,6 +183,7 @@ l2up_create(struct layer2 *l2, u_int prim, int len, void *arg)
 
 	if (!l2->up)
 		return;
+	l2up_event(l2, prim);
 	skb = mI_alloc_skb(len, GFP_ATOMIC);
 	if (!skb)
 		return;
@@ -280,21 +304,38 @@ l2_timeout(struct FsmInst *fi, int event, void *arg)
 	struct layer2 *l2 = fi->userdata;
 	struct sk_buff *skb;
 	struct mISDNhead *hh;
-
+	char *name;
+	u_int prim;
+
+	switch (event) {
+	case EV_L2_T200:
+		name = "T200";
+		prim = DL_TIMER200_IND;
+		l2->t200_count++;
+		break;
+	case EV_L2_T203:
+		name = "T203";
+		prim = DL_TIMER203_IND;
+		break;
+	default:
+		name = "TACK";
+		prim = DL_TIMERACK_IND;
+		break;
+	}
 	skb = mI_alloc_skb(0, GFP_ATOMIC);
 	if (!skb) {
 		printk(KERN_WARNING "%s: L2(%d,%d) nr:%x timer %s no skb\n",
 		       mISDNDevName4ch(&l2->ch), l2->sapi, l2->tei,
-		       l2->ch.nr, event == EV_L2_T200 ? "T200" : "T203");
+		       l2->ch.nr, name);
 		return;
 	}
 	hh = mISDN_HEAD_P(skb);
-	hh->prim = event == EV_L2_T200 ? DL_TIMER200_IND : DL_TIMER203_IND;
+	hh->prim = prim;
 	hh->id = l2->ch.nr;
 	if (*debug & DEBUG_TIMER)
 		printk(KERN_DEBUG "%s: L2(%d,%d) nr:%x timer %s expired\n",
 		       mISDNDevName4ch(&l2->ch), l2->sapi, l2->tei,
-		       l2->ch.nr, event == EV_L2_T200 ? "T200" : "T203");
+		       l2->ch.nr, name);
 	if (l2->ch.st)
 		l2->ch.st->own.recv(&l2->ch.st->own, skb);
 }
@@ -305,6 +346,8 @@ l2mgr(struct layer2 *l2, u_int prim, void *arg) {
 
 	printk(KERN_WARNING "l2mgr: dev %s addr:%x prim %x %c\n",
 	       mISDNDevName4ch(&l2->ch), l2->id, prim, (char)c);
+	if (prim == MDL_ERROR_IND)
+		l2->mdl_error++;
 	if (test_bit(FLG_LAPD, &l2->flag) &&
 	    !test_bit(FLG_FIXED_TEI, &l2->flag)) {
 		switch (c) {
@@ -321,7 +364,8 @@ l2mgr(struct layer2 *l2, u_int prim, void *arg) {
 
 static void
 set_peer_busy(struct layer2 *l2) {
-	test_and_set_bit(FLG_PEER_BUSY, &l2->flag);
+	if (!test_and_set_bit(FLG_PEER_BUSY, &l2->flag))
+		l2->rnr_rx++;
 	if (skb_queue_len(&l2->i_queue) || skb_queue_len(&l2->ui_queue))
 		test_and_set_bit(FLG_L2BLOCK, &l2->flag);
 }
@@ -1116,6 +1160,9 @@ enquiry_cr(struct layer2 *l2, u_char typ, u_char cr, u_char pf)
 		return;
 	}
 	skb_put_data(skb, tmp, i);
+	l2->sframes++;
+	if (typ == REJ)
+		l2->rej_tx++;
 	enqueue_super(l2, skb);
 }
 
@@ -1167,9 +1214,10 @@ invoke_retransmission(struct layer2 *l2, unsigned int nr)
 				p1 = (l2->vs - l2->va) % 8;
 			}
 			p1 = (p1 + l2->sow) % l2->window;
-			if (l2->windowar[p1])
+			if (l2->windowar[p1]) {
 				skb_queue_head(&l2->i_queue, l2->windowar[p1]);
-			else
+				l2->retrans++;
+			} else
 				printk(KERN_WARNING
 				       "%s: windowar[%d] is NULL\n",
 				       mISDNDevName4ch(&l2->ch), p1);
@@ -1197,8 +1245,10 @@ l2_st7_got_super(struct FsmInst *fi, int event, void *arg)
 		typ = RNR;
 	} else
 		clear_peer_busy(l2);
-	if (IsREJ(skb->data, l2))
+	if (IsREJ(skb->data, l2)) {
 		typ = REJ;
+		l2->rej_rx++;
+	}
 
 	if (test_bit(FLG_MOD128, &l2->flag)) {
 		PollFlag = (skb->data[1] & 0x1) == 0x1;
@@ -1279,6 +1329,7 @@ l2_got_iframe(struct FsmInst *fi, int event, void *arg)
 	int		PollFlag, i;
 	u_int		ns, nr;
 
+	l2->rx_iframes++;
 	i = l2addrsize(l2);
 	if (test_bit(FLG_MOD128, &l2->flag)) {
 		PollFlag = ((skb->data[i + 1] & 0x1) == 0x1);
@@ -1336,6 +1387,22 @@ l2_got_iframe(struct FsmInst *fi, int event, void *arg)
 	}
 	if (skb_queue_len(&l2->i_queue) && (fi->state == ST_L2_7))
 		mISDN_FsmEvent(fi, EV_L2_ACK_PULL, NULL);
+	if (!test_bit(FLG_ACK_PEND, &l2->flag))
+		return;
+	if (l2->Tack) {
+		/* wait for more I-frames or an own I-frame to carry it */
+		if (!timer_pending(&l2->tack.tl))
+			mISDN_FsmAddTimer(&l2->tack, l2->Tack, EV_L2_TACK,
+					  NULL, 1);
+	} else if (test_and_clear_bit(FLG_ACK_PEND, &l2->flag))
+		enquiry_cr(l2, RR, RSP, 0);
+}
+
+static void
+l2_tout_ack(struct FsmInst *fi, int event, void *arg)
+{
+	struct layer2	*l2 = fi->userdata;
+
 	if (test_and_clear_bit(FLG_ACK_PEND, &l2->flag))
 		enquiry_cr(l2, RR, RSP, 0);
 }
@@ -1505,7 +1572,9 @@ l2_pull_iqueue(struct FsmInst *fi, int event, void *arg)
 	l2->windowar[p1] = skb;
 	memcpy(skb_push(nskb, i), header, i);
 	l2down(l2, PH_DATA_REQ, l2_newid(l2), nskb);
-	test_and_clear_bit(FLG_ACK_PEND, &l2->flag);
+	l2->tx_iframes++;
+	if (test_and_clear_bit(FLG_ACK_PEND, &l2->flag))
+		l2->piggyback++;
 	if (!test_and_set_bit(FLG_T200_RUN, &l2->flag)) {
 		mISDN_FsmDelTimer(&l2->t203, 13);
 		mISDN_FsmAddTimer(&l2->t200, l2->T200, EV_L2_T200, NULL, 11);
@@ -1531,6 +1600,8 @@ l2_st8_got_super(struct FsmInst *fi, int event, void *arg)
 		rnr = 1;
 	} else
 		clear_peer_busy(l2);
+	if (IsREJ(skb->data, l2))
+		l2->rej_rx++;
 
 	if (test_bit(FLG_MOD128, &l2->flag)) {
 		PollFlag = (skb->data[1] & 0x1) == 0x1;
@@ -1832,6 +1903,10 @@ static struct FsmNode L2FnList[] =
 	{ST_L2_7, EV_L2_T200I, l2_st7_tout_200},
 	{ST_L2_8, EV_L2_T200I, l2_st8_tout_200},
 	{ST_L2_7, EV_L2_T203I, l2_st7_tout_203},
+	{ST_L2_7, EV_L2_TACK, l2_timeout},
+	{ST_L2_8, EV_L2_TACK, l2_timeout},
+	{ST_L2_7, EV_L2_TACKI, l2_tout_ack},
+	{ST_L2_8, EV_L2_TACKI, l2_tout_ack},
 	{ST_L2_7, EV_L2_ACK_PULL, l2_pull_iqueue},
 	{ST_L2_7, EV_L2_SET_OWN_BUSY, l2_set_own_busy},
 	{ST_L2_8, EV_L2_SET_OWN_BUSY, l2_set_own_busy},
@@ -2018,6 +2093,9 @@ l2_send(struct mISDNchannel *ch, struct sk_buff *skb)
 	case DL_TIMER203_IND:
 		mISDN_FsmEvent(&l2->l2m, EV_L2_T203I, NULL);
 		break;
+	case DL_TIMERACK_IND:
+		mISDN_FsmEvent(&l2->l2m, EV_L2_TACKI, NULL);
+		break;
 	default:
 		if (*debug & DEBUG_L2)
 			l2m_debug(&l2->l2m, "l2 unknown pr %04x",
@@ -2040,9 +2118,11 @@ tei_l2(struct layer2 *l2, u_int cmd, u_long arg)
 		       mISDNDevName4ch(&l2->ch), cmd, __func__);
 	switch (cmd) {
 	case (MDL_ASSIGN_REQ):
+		l2_nl_event(l2, MISDN_EVENT_TEI_ASSIGN, arg);
 		ret = mISDN_FsmEvent(&l2->l2m, EV_L2_MDL_ASSIGN, (void *)arg);
 		break;
 	case (MDL_REMOVE_REQ):
+		l2_nl_event(l2, MISDN_EVENT_TEI_REMOVE, l2->tei);
 		ret = mISDN_FsmEvent(&l2->l2m, EV_L2_MDL_REMOVE, NULL);
 		break;
 	case (MDL_ERROR_IND):
@@ -2063,6 +2143,7 @@ release_l2(struct layer2 *l2)
 {
 	mISDN_FsmDelTimer(&l2->t200, 21);
 	mISDN_FsmDelTimer(&l2->t203, 16);
+	mISDN_FsmDelTimer(&l2->tack, 22);
 	skb_queue_purge(&l2->i_queue);
 	skb_queue_purge(&l2->ui_queue);
 	skb_queue_purge(&l2->down_queue);
@@ -2100,10 +2181,51 @@ l2_ctrl(struct mISDNchannel *ch, u_int cmd, void *arg)
 			l2->ch.peer->ctrl(l2->ch.peer, CLOSE_CHANNEL, NULL);
 		release_l2(l2);
 		break;
+	case CONTROL_CHANNEL:
+		/* X.75 sockets talk to us directly */
+		if (!arg || ((u_int *)arg)[0] != IML2ACK)
+			return -EINVAL;
+		l2_ack_ctrl(l2, arg);
+		break;
 	}
 	return 0;
 }
 
+/*
+ * IML2ACK: val[1] delay in ms (< 0 keeps it), returns the delay in val[1]
+ * and adds the counters to val[2] and val[3]
+ */
+void
+l2_ack_ctrl(struct layer2 *l2, u_int *val)
+{
+	int delay = val[1];
+
+	if (delay >= 0)
+		l2->Tack = min(delay, l2->T200 / 4);
+	val[1] = l2->Tack;
+	val[2] += l2->sframes;
+	val[3] += l2->piggyback;
+}
+
+void
+l2_get_stats(struct layer2 *l2, struct mISDN_l2stats *st)
+{
+	memset(st, 0, sizeof(*st));
+	st->sapi = l2->sapi;
+	st->tei = l2->tei;
+	st->tx_iframes = l2->tx_iframes;
+	st->rx_iframes = l2->rx_iframes;
+	st->retrans = l2->retrans;
+	st->rej_tx = l2->rej_tx;
+	st->rej_rx = l2->rej_rx;
+	st->rnr_rx = l2->rnr_rx;
+	st->t200 = l2->t200_count;
+	st->mdl_error = l2->mdl_error;
+	st->established = l2->established;
+	st->sframes = l2->sframes;
+	st->piggyback = l2->piggyback;
+}
+
 struct layer2 *
 create_l2(struct mISDNchannel *ch, u_int protocol, u_long options, int tei,
 	  int sapi)
@@ -2208,6 +2330,7 @@ create_l2(struct mISDNchannel *ch, u_int protocol, u_long options, int tei,
 
 	mISDN_FsmInitTimer(&l2->l2m, &l2->t200);
 	mISDN_FsmInitTimer(&l2->l2m, &l2->t203);
+	mISDN_FsmInitTimer(&l2->l2m, &l2->tack);
 	return l2;
 }
 
@@ -23,6 +23,7 @@ struct manager {
 	struct mISDNchannel	*up;
 	u_int			nextid;
 	u_int			lastid;
+	int			ack_delay; /* for new layer2 */
 };
 
 struct teimgr {
@@ -56,8 +57,13 @@ struct layer2 {
 	u_int			window;
 	u_int			sow;
 	struct FsmInst		l2m;
-	struct FsmTimer		t200, t203;
-	int			T200, N200, T203;
+	struct FsmTimer		t200, t203, tack;
+	int			T200, N200, T203, Tack;
+	u_int			sframes, piggyback; /* see IML2ACK */
+	/* for MISDN_CMD_GET_L2STATS, see l2_get_stats() */
+	u_int			tx_iframes, rx_iframes, retrans;
+	u_int			rej_tx, rej_rx, rnr_rx;
+	u_int			t200_count, mdl_error, established;
 	u_int			next_id;
 	u_int			down_id;
 	struct sk_buff		*windowar[MAX_WINDOW];
@@ -83,6 +89,8 @@ enum {
 extern struct layer2	*create_l2(struct mISDNchannel *, u_int,
 				   u_long, int, int);
 extern int		tei_l2(struct layer2 *, u_int, u_long arg);
+extern void		l2_ack_ctrl(struct layer2 *, u_int *);
+extern void		l2_get_stats(struct layer2 *, struct mISDN_l2stats *);
 
 
 /* from tei.c */
@@ -0,0 +1,334 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * generic netlink interface for monitoring
+ *
+ * Devices, B-channel, layer 2 and DSP statistics are read with dumps,
+ * events like
+ * layer 1 activation or layer 2 establishment are sent to the "events"
+ * multicast group. Events cost only a listener check if nobody listens.
+ */
+
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/mISDNif.h>
+#include <net/genetlink.h>
+#include "core.h"
+
+#define MISDN_NL_MAX_L2		128	/* TEI 0..127 */
+
+/* set while the dsp module is loaded */
+static const struct mISDN_nl_dsp_ops	*nl_dsp_ops;
+static DEFINE_MUTEX(nl_dsp_mutex);
+
+static const struct genl_multicast_group mISDN_nl_mcgrps[] = {
+	{ .name = MISDN_GENL_MCGRP_EVENTS, },
+};
+
+static struct genl_family mISDN_nl_family;
+
+static int
+mISDN_nl_put_dev(struct sk_buff *skb, struct netlink_callback *cb,
+		 struct mISDN_devinfo *di)
+{
+	void *hdr;
+
+	hdr = genlmsg_put(skb, NETLINK_CB(cb->skb).portid,
+			  cb->nlh->nlmsg_seq, &mISDN_nl_family, NLM_F_MULTI,
+			  MISDN_CMD_GET_DEVICE);
+	if (!hdr)
+		return -EMSGSIZE;
+	if (nla_put_u32(skb, MISDN_ATTR_DEV_ID, di->id) ||
+	    nla_put_string(skb, MISDN_ATTR_DEV_NAME, di->name) ||
+	    nla_put_u32(skb, MISDN_ATTR_DPROTOCOLS, di->Dprotocols) ||
+	    nla_put_u32(skb, MISDN_ATTR_BPROTOCOLS, di->Bprotocols) ||
+	    nla_put_u32(skb, MISDN_ATTR_PROTOCOL, di->protocol) ||
+	    nla_put_u32(skb, MISDN_ATTR_NRBCHAN, di->nrbchan) ||
+	    nla_put(skb, MISDN_ATTR_CHANNELMAP, sizeof(di->channelmap),
+		    di->channelmap)) {
+		genlmsg_cancel(skb, hdr);
+		return -EMSGSIZE;
+	}
+	genlmsg_end(skb, hdr);
+	return 0;
+}
+
+/* cb->args[0]: next index into the device list */
+static int
+mISDN_nl_dump_dev(struct sk_buff *skb, struct netlink_callback *cb)
+{
+	struct mISDN_devinfo *di;
+	int i, cnt;
+
+	di = kcalloc(MISDN_MAX_DEVICES, sizeof(*di), GFP_KERNEL);
+	if (!di)
+		return -ENOMEM;
+	cnt = get_mdevice_list(di, MISDN_MAX_DEVICES);
+	for (i = cb->args[0]; i < cnt; i++) {
+		if (mISDN_nl_put_dev(skb, cb, &di[i]))
+			break;
+	}
+	cb->args[0] = i;
+	kfree(di);
+	return skb->len;
+}
+
+static int
+mISDN_nl_put_bchstats(struct sk_buff *skb, struct netlink_callback *cb,
+		      struct mISDNdevice *dev, struct mISDN_bchstats *st)
+{
+	void *hdr;
+	int i, cnt;
+
+	cnt = get_bchannel_stats(dev, st, MISDN_MAX_CHANNEL);
+	if (cnt > MISDN_MAX_CHANNEL)
+		cnt = MISDN_MAX_CHANNEL;
+	hdr = genlmsg_put(skb, NETLINK_CB(cb->skb).portid,
+			  cb->nlh->nlmsg_seq, &mISDN_nl_family, NLM_F_MULTI,
+			  MISDN_CMD_GET_BCHSTATS);
+	if (!hdr)
+		return -EMSGSIZE;
+	if (nla_put_u32(skb, MISDN_ATTR_DEV_ID, dev->id))
+		goto nla_put_failure;
+	for (i = 0; i < cnt; i++) {
+		if (nla_put(skb, MISDN_ATTR_BCHSTATS, sizeof(*st), &st[i]))
+			goto nla_put_failure;
+	}
+	genlmsg_end(skb, hdr);
+	return 0;
+
+nla_put_failure:
+	genlmsg_cancel(skb, hdr);
+	return -EMSGSIZE;
+}
+
+/* cb->args[0]: next device id */
+static int
+mISDN_nl_dump_bchstats(struct sk_buff *skb, struct netlink_callback *cb)
+{
+	struct mISDN_bchstats *st;
+	struct mISDNdevice *dev;
+	u_int id;
+
+	st = kcalloc(MISDN_MAX_CHANNEL, sizeof(*st), GFP_KERNEL);
+	if (!st)
+		return -ENOMEM;
+	for (id = cb->args[0]; id < MISDN_MAX_DEVICES; id++) {
+		rcu_read_lock();
+		dev = get_mdevice(id);
+		if (dev && mISDN_nl_put_bchstats(skb, cb, dev, st)) {
+			rcu_read_unlock();
+			break;
+		}
+		rcu_read_unlock();
+	}
+	cb->args[0] = id;
+	kfree(st);
+	return skb->len;
+}
+
+static int
+mISDN_nl_put_l2stats(struct sk_buff *skb, struct netlink_callback *cb,
+		     struct mISDNdevice *dev, struct mISDN_l2stats *st)
+{
+	void *hdr;
+	int i, cnt;
+
+	cnt = get_l2_stats(dev, st, MISDN_NL_MAX_L2);
+	if (cnt > MISDN_NL_MAX_L2)
+		cnt = MISDN_NL_MAX_L2;
+	hdr = genlmsg_put(skb, NETLINK_CB(cb->skb).portid,
+			  cb->nlh->nlmsg_seq, &mISDN_nl_family, NLM_F_MULTI,
+			  MISDN_CMD_GET_L2STATS);
+	if (!hdr)
+		return -EMSGSIZE;
+	if (nla_put_u32(skb, MISDN_ATTR_DEV_ID, dev->id))
+		goto nla_put_failure;
+	for (i = 0; i < cnt; i++) {
+		if (nla_put(skb, MISDN_ATTR_L2STATS, sizeof(*st), &st[i]))
+			goto nla_put_failure;
+	}
+	genlmsg_end(skb, hdr);
+	return 0;
+
+nla_put_failure:
+	genlmsg_cancel(skb, hdr);
+	return -EMSGSIZE;
+}
+
+/* cb->args[0]: next device id */
+static int
+mISDN_nl_dump_l2stats(struct sk_buff *skb, struct netlink_callback *cb)
+{
+	struct mISDN_l2stats *st;
+	struct mISDNdevice *dev;
+	u_int id;
+
+	st = kcalloc(MISDN_NL_MAX_L2, sizeof(*st), GFP_KERNEL);
+	if (!st)
+		return -ENOMEM;
+	for (id = cb->args[0]; id < MISDN_MAX_DEVICES; id++) {
+		rcu_read_lock();
+		dev = get_mdevice(id);
+		if (dev && mISDN_nl_put_l2stats(skb, cb, dev, st)) {
+			rcu_read_unlock();
+			break;
+		}
+		rcu_read_unlock();
+	}
+	cb->args[0] = id;
+	kfree(st);
+	return skb->len;
+}
+
+static int
+mISDN_nl_put_dsp(struct sk_buff *skb, struct netlink_callback *cb,
+		 int attr, int len, void *data)
+{
+	void *hdr;
+
+	hdr = genlmsg_put(skb, NETLINK_CB(cb->skb).portid,
+			  cb->nlh->nlmsg_seq, &mISDN_nl_family, NLM_F_MULTI,
+			  MISDN_CMD_GET_DSPSTATS);
+	if (!hdr)
+		return -EMSGSIZE;
+	if (nla_put(skb, attr, len, data)) {
+		genlmsg_cancel(skb, hdr);
+		return -EMSGSIZE;
+	}
+	genlmsg_end(skb, hdr);
+	return 0;
+}
+
+/* cb->args[0]: 0 before the tick message, else next dsp index + 1 */
+static int
+mISDN_nl_dump_dspstats(struct sk_buff *skb, struct netlink_callback *cb)
+{
+	struct mISDN_dsptick tick;
+	struct mISDN_dspstats st;
+	u_int i = cb->args[0];
+
+	mutex_lock(&nl_dsp_mutex);
+	if (!nl_dsp_ops)
+		goto out;
+	if (!i) {
+		memset(&tick, 0, sizeof(tick));
+		nl_dsp_ops->tick(&tick);
+		if (mISDN_nl_put_dsp(skb, cb, MISDN_ATTR_DSPTICK,
+				     sizeof(tick), &tick))
+			goto out;
+		i++;
+	}
+	for (;; i++) {
+		memset(&st, 0, sizeof(st));
+		if (nl_dsp_ops->stats(i - 1, &st))
+			break;
+		if (mISDN_nl_put_dsp(skb, cb, MISDN_ATTR_DSPSTATS,
+				     sizeof(st), &st))
+			break;
+	}
+out:
+	mutex_unlock(&nl_dsp_mutex);
+	cb->args[0] = i;
+	return skb->len;
+}
+
+void
+mISDN_nl_register_dsp(const struct mISDN_nl_dsp_ops *ops)
+{
+	mutex_lock(&nl_dsp_mutex);
+	nl_dsp_ops = ops;
+	mutex_unlock(&nl_dsp_mutex);
+}
+EXPORT_SYMBOL(mISDN_nl_register_dsp);
+
+void
+mISDN_nl_unregister_dsp(void)
+{
+	mutex_lock(&nl_dsp_mutex);
+	nl_dsp_ops = NULL;
+	mutex_unlock(&nl_dsp_mutex);
+}
+EXPORT_SYMBOL(mISDN_nl_unregister_dsp);
+
+static const struct genl_small_ops mISDN_nl_ops[] = {
+	{
+		.cmd = MISDN_CMD_GET_DEVICE,
+		.dumpit = mISDN_nl_dump_dev,
+	},
+	{
+		.cmd = MISDN_CMD_GET_BCHSTATS,
+		.dumpit = mISDN_nl_dump_bchstats,
+	},
+	{
+		.cmd = MISDN_CMD_GET_L2STATS,
+		.dumpit = mISDN_nl_dump_l2stats,
+	},
+	{
+		.cmd = MISDN_CMD_GET_DSPSTATS,
+		.dumpit = mISDN_nl_dump_dspstats,
+	},
+};
+
+static struct genl_family mISDN_nl_family __ro_after_init = {
+	.name = MISDN_GENL_NAME,
+	.version = MISDN_GENL_VERSION,
+	.maxattr = MISDN_ATTR_MAX,
+	.module = THIS_MODULE,
+	.small_ops = mISDN_nl_ops,
+	.n_small_ops = ARRAY_SIZE(mISDN_nl_ops),
+	.resv_start_op = MISDN_CMD_EVENT + 1,
+	.mcgrps = mISDN_nl_mcgrps,
+	.n_mcgrps = ARRAY_SIZE(mISDN_nl_mcgrps),
+};
+
+/*
+ * send an event to the listeners, may be called in any context
+ * dev may be NULL, channel and addr (sapi | tei << 8) are left out if < 0
+ */
+void
+mISDN_nl_event(struct mISDNdevice *dev, u_int event, int channel, int addr,
+	       u_int value)
+{
+	struct sk_buff *skb;
+	void *hdr;
+
+	if (!genl_has_listeners(&mISDN_nl_family, &init_net, 0))
+		return;
+	skb = genlmsg_new(NLMSG_DEFAULT_SIZE, GFP_ATOMIC);
+	if (!skb)
+		return;
+	hdr = genlmsg_put(skb, 0, 0, &mISDN_nl_family, 0, MISDN_CMD_EVENT);
+	if (!hdr)
+		goto nla_put_failure;
+	if (nla_put_u32(skb, MISDN_ATTR_EVENT, event) ||
+	    nla_put_u32(skb, MISDN_ATTR_VALUE, value))
+		goto nla_put_failure;
+	if (dev && (nla_put_u32(skb, MISDN_ATTR_DEV_ID, dev->id) ||
+		    nla_put_string(skb, MISDN_ATTR_DEV_NAME,
+				   dev_name(&dev->dev))))
+		goto nla_put_failure;
+	if (channel >= 0 && nla_put_u32(skb, MISDN_ATTR_CHANNEL, channel))
+		goto nla_put_failure;
+	if (addr >= 0 && (nla_put_u32(skb, MISDN_ATTR_SAPI, addr & 0xff) ||
+			  nla_put_u32(skb, MISDN_ATTR_TEI, addr >> 8)))
+		goto nla_put_failure;
+	genlmsg_end(skb, hdr);
+	genlmsg_multicast(&mISDN_nl_family, skb, 0, 0, GFP_ATOMIC);
+	return;
+
+nla_put_failure:
+	nlmsg_free(skb);
+}
+EXPORT_SYMBOL(mISDN_nl_event);
+
+int
+mISDN_nl_init(void)
+{
+	return genl_register_family(&mISDN_nl_family);
+}
+
+void
+mISDN_nl_cleanup(void)
+{
+	genl_unregister_family(&mISDN_nl_family);
+}
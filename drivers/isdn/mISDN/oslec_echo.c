@@ -294,6 +294,7 @@ struct echo_can_state_s *echo_can_create(int len, int adaption_mode)
     }
 
     ec->cng_level = 1000;
+    ec->decim = 1;
     echo_can_adaption_mode(ec, adaption_mode);
 
     ec->snapshot = (int16_t *)malloc(ec->taps*sizeof(int16_t));
@@ -364,6 +365,7 @@ void echo_can_flush(struct echo_can_state_s *ec)
     ec->Lbgn_upper_acc = ec->Lbgn_upper << 13;
 
     ec->nonupdate_dwell = 0;
+    ec->decim_pos = 0;
 
     fir16_flush(&ec->fir_state);
     fir16_flush(&ec->fir_state_bg);
@@ -383,6 +385,13 @@ void echo_can_snapshot(struct echo_can_state_s *ec)
 }
 /*- End of function --------------------------------------------------------*/
 
+void echo_can_decimate(struct echo_can_state_s *ec, int decim)
+{
+    ec->decim = (decim > 1) ? decim : 1;
+    ec->decim_pos = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 /* Dual Path Echo Canceller ------------------------------------------------*/
 
 int16_t echo_can_update(struct echo_can_state_s *ec, int16_t tx, int16_t rx)
@@ -465,10 +474,14 @@ int16_t echo_can_update(struct echo_can_state_s *ec, int16_t tx, int16_t rx)
     /* Almost always adap bg filter, just simple DT and energy
        detection to minimise adaption in cases of strong double talk.
        However this is not critical for the dual path algorithm.
+
+       Once the caller found the canceller converged, it may ask to
+       adapt only on every decim'th sample.  The foreground and
+       background filters still run on every sample.
     */
     ec->factor = 0;
     ec->shift = 0;
-    if ((ec->nonupdate_dwell == 0)) {
+    if (ec->nonupdate_dwell == 0 && ++ec->decim_pos >= ec->decim) {
 	int   P, logP, shift;
 
 	/* Determine:
@@ -510,6 +523,7 @@ int16_t echo_can_update(struct echo_can_state_s *ec, int16_t tx, int16_t rx)
 	ec->shift = shift;
 
 	lms_adapt_bg(ec, clean_bg, shift);
+	ec->decim_pos = 0;
     }
 
     /* very simple DTD to make sure we dont try and adapt with strong
@@ -139,6 +139,8 @@ struct echo_can_state_s {
     int16_t clean_nlp;
 
     int nonupdate_dwell;
+    int decim;
+    int decim_pos;
     int curr_pos;
     int taps;
     int log2taps;
@@ -204,6 +206,11 @@ void echo_can_adaption_mode(struct echo_can_state_s *ec, int adaption_mode);
 
 void echo_can_snapshot(struct echo_can_state_s *ec);
 
+/*! Only adapt the background filter on every decim'th sample.
+    \param ec The echo canceller context.
+    \param decim The decimation factor, 1 adapts on every sample. */
+void echo_can_decimate(struct echo_can_state_s *ec, int decim);
+
 /*! Process a sample through a voice echo canceller.
     \param ec The echo canceller context.
     \param tx The transmitted audio sample.
@@ -102,3 +102,8 @@ int oslec_echo_can_traintap(struct echo_can_state *ec, int pos, short val)
 	return 0;
 }
 
+void oslec_echo_can_decimate(struct echo_can_state *ec, int decim)
+{
+	echo_can_decimate((struct echo_can_state_s *)(ec->ec), decim);
+}
+
@@ -7,7 +7,9 @@
  */
 
 #include <linux/mISDNif.h>
+#include <linux/mISDNhw.h>
 #include <linux/slab.h>
+#include <linux/rcupdate.h>
 #include <linux/export.h>
 #include "core.h"
 
@@ -105,6 +107,40 @@ mISDN_sock_cmsg(struct sock *sk, struct msghdr *msg, struct sk_buff *skb)
 	}
 }
 
+/*
+ * busy poll: spin for up to busy_poll usec and let the B-channel deliver
+ * its receive queue directly, instead of waiting for its work item
+ * only raw and HDLC B-channel sockets are connected to the channel itself
+ */
+static void
+mISDN_sock_busy_poll(struct sock *sk)
+{
+	struct mISDN_sock	*msk = _pms(sk);
+	struct mISDNchannel	*peer = msk->ch.peer;
+	struct bchannel		*bch;
+	u64			end;
+
+	if (!skb_queue_empty_lockless(&sk->sk_receive_queue))
+		return;
+	if (!peer || sk->sk_state != MISDN_BOUND ||
+	    (sk->sk_protocol != ISDN_P_B_RAW &&
+	     sk->sk_protocol != ISDN_P_B_HDLC))
+		return;
+	bch = container_of(peer, struct bchannel, ch);
+	end = ktime_get_ns() + (u64)msk->busy_poll * NSEC_PER_USEC;
+	do {
+		/* outside of any driver lock, the socket may send back */
+		bchannel_rx_drain(bch);
+		if (!skb_queue_empty_lockless(&sk->sk_receive_queue)) {
+			msk->pollstats.hits++;
+			return;
+		}
+		cpu_relax();
+	} while (!need_resched() && !signal_pending(current) &&
+		 ktime_get_ns() < end);
+	msk->pollstats.sleeps++;
+}
+
 static int
 mISDN_sock_recvmsg(struct socket *sock, struct msghdr *msg, size_t len,
 		   int flags)
@@ -124,6 +160,9 @@ mISDN_sock_recvmsg(struct socket *sock, struct msghdr *msg, size_t len,
 	if (sk->sk_state == MISDN_CLOSED)
 		return 0;
 
+	if (_pms(sk)->busy_poll && !(flags & MSG_DONTWAIT))
+		mISDN_sock_busy_poll(sk);
+
 	skb = skb_recv_datagram(sk, flags, flags & MSG_DONTWAIT, &err);
 	if (!skb)
 		return err;
@@ -282,7 +321,8 @@ static int
 data_sock_ioctl_bound(struct sock *sk, unsigned int cmd, void __user *p)
 {
 	struct mISDN_ctrl_req	cq;
-	int			err = -EINVAL, val[2];
+	struct mISDN_l2ack	ack;
+	int			err = -EINVAL, val[4];
 	struct mISDNchannel	*bchan, *next;
 
 	lock_sock(sk);
@@ -340,6 +380,30 @@ data_sock_ioctl_bound(struct sock *sk, unsigned int cmd, void __user *p)
 		err = _pms(sk)->dev->teimgr->ctrl(_pms(sk)->dev->teimgr,
 						  CONTROL_CHANNEL, val);
 		break;
+	case IML2ACK:
+		if (copy_from_user(&ack, p, sizeof(ack))) {
+			err = -EFAULT;
+			break;
+		}
+		val[0] = cmd;
+		val[1] = ack.delay;
+		val[2] = 0;
+		val[3] = 0;
+		if (sk->sk_protocol == ISDN_P_LAPD_NT ||
+		    sk->sk_protocol == ISDN_P_LAPD_TE)
+			err = _pms(sk)->dev->teimgr->ctrl(_pms(sk)->dev->teimgr,
+							  CONTROL_CHANNEL, val);
+		else if (sk->sk_protocol == ISDN_P_B_X75SLP)
+			err = _pms(sk)->ch.peer->ctrl(_pms(sk)->ch.peer,
+						      CONTROL_CHANNEL, val);
+		if (err)
+			break;
+		ack.delay = val[1];
+		ack.sframes = val[2];
+		ack.piggyback = val[3];
+		if (copy_to_user(p, &ack, sizeof(ack)))
+			err = -EFAULT;
+		break;
 	default:
 		err = -EINVAL;
 		break;
@@ -349,6 +413,60 @@ done:
 	return err;
 }
 
+/* all devices in one call, the count field tells the room in the buffer */
+static int
+get_devlist(void __user *arg)
+{
+	struct mISDN_devlist __user *ul = arg;
+	struct mISDN_devinfo *di;
+	u_int max;
+	int cnt, err = 0;
+
+	if (get_user(max, &ul->count))
+		return -EFAULT;
+	if (max > MISDN_MAX_DEVICES)
+		max = MISDN_MAX_DEVICES;
+	di = kcalloc(max ? max : 1, sizeof(*di), GFP_KERNEL);
+	if (!di)
+		return -ENOMEM;
+	cnt = get_mdevice_list(di, max);
+	if (put_user(cnt, &ul->count) ||
+	    copy_to_user(ul->info, di, min_t(u_int, cnt, max) * sizeof(*di)))
+		err = -EFAULT;
+	kfree(di);
+	return err;
+}
+
+static int
+get_bchstats(void __user *arg)
+{
+	struct mISDN_bchstatslist __user *ul = arg;
+	struct mISDN_bchstats *st;
+	struct mISDNdevice *dev;
+	u_int id, max;
+	int cnt = 0, err = 0;
+
+	if (get_user(id, &ul->id) || get_user(max, &ul->count))
+		return -EFAULT;
+	if (max > MISDN_MAX_CHANNEL)
+		max = MISDN_MAX_CHANNEL;
+	st = kcalloc(max ? max : 1, sizeof(*st), GFP_KERNEL);
+	if (!st)
+		return -ENOMEM;
+	rcu_read_lock();
+	dev = get_mdevice(id);
+	if (dev)
+		cnt = get_bchannel_stats(dev, st, max);
+	rcu_read_unlock();
+	if (!dev)
+		err = -ENODEV;
+	else if (put_user(cnt, &ul->count) ||
+	    copy_to_user(ul->st, st, min_t(u_int, cnt, max) * sizeof(*st)))
+		err = -EFAULT;
+	kfree(st);
+	return err;
+}
+
 static int
 data_sock_ioctl(struct socket *sock, unsigned int cmd, unsigned long arg)
 {
@@ -375,23 +493,25 @@ data_sock_ioctl(struct socket *sock, unsigned int cmd, unsigned long arg)
 			err = -EFAULT;
 			break;
 		}
+		rcu_read_lock();
 		dev = get_mdevice(id);
 		if (dev) {
 			struct mISDN_devinfo di;
 
-			memset(&di, 0, sizeof(di));
-			di.id = dev->id;
-			di.Dprotocols = dev->Dprotocols;
-			di.Bprotocols = dev->Bprotocols | get_all_Bprotocols();
-			di.protocol = dev->D.protocol;
-			memcpy(di.channelmap, dev->channelmap,
-			       sizeof(di.channelmap));
-			di.nrbchan = dev->nrbchan;
-			strscpy(di.name, dev_name(&dev->dev), sizeof(di.name));
+			get_mdevice_info(dev, &di);
+			rcu_read_unlock();
 			if (copy_to_user((void __user *)arg, &di, sizeof(di)))
 				err = -EFAULT;
-		} else
+		} else {
+			rcu_read_unlock();
 			err = -ENODEV;
+		}
+		break;
+	case IMGETDEVLIST:
+		err = get_devlist((void __user *)arg);
+		break;
+	case IMGETBCHSTATS:
+		err = get_bchstats((void __user *)arg);
 		break;
 	default:
 		if (sk->sk_state == MISDN_BOUND)
@@ -427,6 +547,17 @@ static int data_sock_setsockopt(struct socket *sock, int level, int optname,
 		else
 			_pms(sk)->cmask &= ~MISDN_TIME_STAMP;
 		break;
+	case MISDN_BUSY_POLL:
+		if (copy_from_sockptr(&opt, optval, sizeof(int))) {
+			err = -EFAULT;
+			break;
+		}
+		if (opt < 0) {
+			err = -EINVAL;
+			break;
+		}
+		_pms(sk)->busy_poll = opt;
+		break;
 	default:
 		err = -ENOPROTOOPT;
 		break;
@@ -444,11 +575,22 @@ static int data_sock_getsockopt(struct socket *sock, int level, int optname,
 	if (get_user(len, optlen))
 		return -EFAULT;
 
-	if (len != sizeof(char))
-		return -EINVAL;
-
 	switch (optname) {
+	case MISDN_BUSY_POLL:
+		if (len != sizeof(int))
+			return -EINVAL;
+		if (put_user(_pms(sk)->busy_poll, (int __user *)optval))
+			return -EFAULT;
+		break;
+	case MISDN_BUSY_POLL_STATS:
+		if (len != sizeof(struct mISDN_pollstats))
+			return -EINVAL;
+		if (copy_to_user(optval, &_pms(sk)->pollstats, len))
+			return -EFAULT;
+		break;
 	case MISDN_TIME_STAMP:
+		if (len != sizeof(char))
+			return -EINVAL;
 		if (_pms(sk)->cmask & MISDN_TIME_STAMP)
 			opt = 1;
 		else
@@ -480,6 +622,8 @@ data_sock_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 		return -EINVAL;
 
 	lock_sock(sk);
+	/* the device must not go away while the stack is connected */
+	mISDN_devtable_lock();
 
 	if (_pms(sk)->dev) {
 		err = -EALREADY;
@@ -547,6 +691,7 @@ data_sock_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 	_pms(sk)->ch.protocol = sk->sk_protocol;
 
 done:
+	mISDN_devtable_unlock();
 	release_sock(sk);
 	return err;
 }
@@ -572,6 +717,16 @@ data_sock_getname(struct socket *sock, struct sockaddr *addr,
 	return sizeof(*maddr);
 }
 
+static __poll_t
+data_sock_poll(struct file *file, struct socket *sock, poll_table *wait)
+{
+	struct sock *sk = sock->sk;
+
+	if (_pms(sk)->busy_poll)
+		mISDN_sock_busy_poll(sk);
+	return datagram_poll(file, sock, wait);
+}
+
 static const struct proto_ops data_sock_ops = {
 	.family		= PF_ISDN,
 	.owner		= THIS_MODULE,
@@ -581,7 +736,7 @@ static const struct proto_ops data_sock_ops = {
 	.getname	= data_sock_getname,
 	.sendmsg	= mISDN_sock_sendmsg,
 	.recvmsg	= mISDN_sock_recvmsg,
-	.poll		= datagram_poll,
+	.poll		= data_sock_poll,
 	.listen		= sock_no_listen,
 	.shutdown	= sock_no_shutdown,
 	.setsockopt	= data_sock_setsockopt,
@@ -658,23 +813,25 @@ base_sock_ioctl(struct socket *sock, unsigned int cmd, unsigned long arg)
 			err = -EFAULT;
 			break;
 		}
+		rcu_read_lock();
 		dev = get_mdevice(id);
 		if (dev) {
 			struct mISDN_devinfo di;
 
-			memset(&di, 0, sizeof(di));
-			di.id = dev->id;
-			di.Dprotocols = dev->Dprotocols;
-			di.Bprotocols = dev->Bprotocols | get_all_Bprotocols();
-			di.protocol = dev->D.protocol;
-			memcpy(di.channelmap, dev->channelmap,
-			       sizeof(di.channelmap));
-			di.nrbchan = dev->nrbchan;
-			strscpy(di.name, dev_name(&dev->dev), sizeof(di.name));
+			get_mdevice_info(dev, &di);
+			rcu_read_unlock();
 			if (copy_to_user((void __user *)arg, &di, sizeof(di)))
 				err = -EFAULT;
-		} else
+		} else {
+			rcu_read_unlock();
 			err = -ENODEV;
+		}
+		break;
+	case IMGETDEVLIST:
+		err = get_devlist((void __user *)arg);
+		break;
+	case IMGETBCHSTATS:
+		err = get_bchstats((void __user *)arg);
 		break;
 	case IMSETDEVNAME:
 	{
@@ -685,11 +842,13 @@ base_sock_ioctl(struct socket *sock, unsigned int cmd, unsigned long arg)
 			break;
 		}
 		dn.name[sizeof(dn.name) - 1] = '\0';
+		mISDN_devtable_lock();
 		dev = get_mdevice(dn.id);
 		if (dev)
 			err = device_rename(&dev->dev, dn.name);
 		else
 			err = -ENODEV;
+		mISDN_devtable_unlock();
 	}
 	break;
 	default:
@@ -712,6 +871,7 @@ base_sock_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 		return -EINVAL;
 
 	lock_sock(sk);
+	mISDN_devtable_lock();
 
 	if (_pms(sk)->dev) {
 		err = -EALREADY;
@@ -726,6 +886,7 @@ base_sock_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 	sk->sk_state = MISDN_BOUND;
 
 done:
+	mISDN_devtable_unlock();
 	release_sock(sk);
 	return err;
 }
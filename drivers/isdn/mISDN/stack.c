@@ -7,6 +7,7 @@
  */
 
 #include <linux/slab.h>
+#include <linux/module.h>
 #include <linux/mISDNif.h>
 #include <linux/kthread.h>
 #include <linux/sched.h>
@@ -17,10 +18,18 @@
 
 static u_int	*debug;
 
+/*
+ * stack threads are started on the first open or message and exit after
+ * stack_idle seconds without messages, 0 keeps them forever
+ */
+static uint	stack_idle = 60;
+module_param(stack_idle, uint, S_IRUGO | S_IWUSR);
+
 static inline void
 _queue_message(struct mISDNstack *st, struct sk_buff *skb)
 {
 	struct mISDNhead	*hh = mISDN_HEAD_P(skb);
+	u_long			flags;
 
 	if (*debug & DEBUG_QUEUE_FUNC)
 		printk(KERN_DEBUG "%s prim(%x) id(%x) %p\n",
@@ -28,7 +37,12 @@ _queue_message(struct mISDNstack *st, struct sk_buff *skb)
 	skb_queue_tail(&st->msgq, skb);
 	if (likely(!test_bit(mISDN_STACK_STOPPED, &st->status))) {
 		test_and_set_bit(mISDN_STACK_WORK, &st->status);
-		wake_up_interruptible(&st->workq);
+		spin_lock_irqsave(&st->tlock, flags);
+		if (st->thread)
+			wake_up_interruptible(&st->workq);
+		else
+			schedule_work(&st->start_work);
+		spin_unlock_irqrestore(&st->tlock, flags);
 	}
 }
 
@@ -190,10 +204,36 @@ do_clear_stack(struct mISDNstack *st)
 {
 }
 
+/*
+ * called by an idle thread, returns 1 if the thread may exit
+ * it must not touch the stack after that, it may be gone
+ */
+static int
+stack_idle_exit(struct mISDNstack *st)
+{
+	int	ret = 0;
+
+	spin_lock_irq(&st->tlock);
+	if (!test_bit(mISDN_STACK_ABORT, &st->status) &&
+	    !(st->status & mISDN_STACK_ACTION_MASK) &&
+	    skb_queue_empty(&st->msgq)) {
+		if (*debug & DEBUG_MSG_THREAD)
+			printk(KERN_DEBUG "mISDNStackd %s idle, exit\n",
+			       dev_name(&st->dev->dev));
+		test_and_clear_bit(mISDN_STACK_RUNNING, &st->status);
+		test_and_clear_bit(mISDN_STACK_ACTIVE, &st->status);
+		st->thread = NULL;
+		ret = 1;
+	}
+	spin_unlock_irq(&st->tlock);
+	return ret;
+}
+
 static int
 mISDNStackd(void *data)
 {
 	struct mISDNstack *st = data;
+	struct completion *done;
 #ifdef MISDN_MSG_STATS
 	u64 utime, stime;
 #endif
@@ -204,11 +244,7 @@ mISDNStackd(void *data)
 		printk(KERN_DEBUG "mISDNStackd %s started\n",
 		       dev_name(&st->dev->dev));
 
-	if (st->notify != NULL) {
-		complete(st->notify);
-		st->notify = NULL;
-	}
-
+	/* st->notify is only set by delete_stack(), completed on exit */
 	for (;;) {
 		struct sk_buff	*skb;
 
@@ -269,16 +305,17 @@ mISDNStackd(void *data)
 		}
 		if (test_bit(mISDN_STACK_ABORT, &st->status))
 			break;
-		if (st->notify != NULL) {
-			complete(st->notify);
-			st->notify = NULL;
-		}
 #ifdef MISDN_MSG_STATS
 		st->sleep_cnt++;
 #endif
 		test_and_clear_bit(mISDN_STACK_ACTIVE, &st->status);
-		wait_event_interruptible(st->workq, (st->status &
-						     mISDN_STACK_ACTION_MASK));
+		if (!stack_idle)
+			wait_event_interruptible(st->workq, (st->status &
+						 mISDN_STACK_ACTION_MASK));
+		else if (!wait_event_interruptible_timeout(st->workq,
+				(st->status & mISDN_STACK_ACTION_MASK),
+				stack_idle * HZ) && stack_idle_exit(st))
+			module_put_and_kthread_exit(0);
 		if (*debug & DEBUG_MSG_THREAD)
 			printk(KERN_DEBUG "%s: %s wake status %08lx\n",
 			       __func__, dev_name(&st->dev->dev), st->status);
@@ -311,14 +348,17 @@ mISDNStackd(void *data)
 	test_and_set_bit(mISDN_STACK_KILLED, &st->status);
 	test_and_clear_bit(mISDN_STACK_RUNNING, &st->status);
 	test_and_clear_bit(mISDN_STACK_ACTIVE, &st->status);
-	test_and_clear_bit(mISDN_STACK_ABORT, &st->status);
+	/* ABORT stays set, so stack_start_work() won't start a new thread */
 	skb_queue_purge(&st->msgq);
+	spin_lock_irq(&st->tlock);
 	st->thread = NULL;
-	if (st->notify != NULL) {
-		complete(st->notify);
-		st->notify = NULL;
-	}
-	return 0;
+	done = st->notify;
+	st->notify = NULL;
+	spin_unlock_irq(&st->tlock);
+	/* delete_stack() frees the stack once this is completed */
+	if (done)
+		complete(done);
+	module_put_and_kthread_exit(0);
 }
 
 static int
@@ -326,6 +366,11 @@ l1_receive(struct mISDNchannel *ch, struct sk_buff *skb)
 {
 	if (!ch->st)
 		return -ENODEV;
+	if (mISDN_HEAD_PRIM(skb) == PH_ACTIVATE_IND)
+		mISDN_nl_event(ch->st->dev, MISDN_EVENT_L1_ACTIVATE, -1, -1, 0);
+	else if (mISDN_HEAD_PRIM(skb) == PH_DEACTIVATE_IND)
+		mISDN_nl_event(ch->st->dev, MISDN_EVENT_L1_DEACTIVATE, -1, -1,
+			       0);
 	__net_timestamp(skb);
 	_queue_message(ch->st, skb);
 	return 0;
@@ -359,12 +404,56 @@ st_own_ctrl(struct mISDNchannel *ch, u_int cmd, void *arg)
 	return ch->st->layer1->ctrl(ch->st->layer1, cmd, arg);
 }
 
+/* all thread starts run here, so they are serialized */
+static void
+stack_start_work(struct work_struct *ws)
+{
+	struct mISDNstack	*st;
+	struct task_struct	*thread;
+
+	st = container_of(ws, struct mISDNstack, start_work);
+	if (st->thread || test_bit(mISDN_STACK_ABORT, &st->status))
+		return;
+	thread = kthread_create(mISDNStackd, (void *)st, "mISDN_%s",
+				dev_name(&st->dev->dev));
+	if (IS_ERR(thread)) {
+		printk(KERN_ERR
+		       "mISDN:cannot create kernel thread for %s (%ld)\n",
+		       dev_name(&st->dev->dev), PTR_ERR(thread));
+		return;
+	}
+	spin_lock_irq(&st->tlock);
+	/* delete_stack() may have started meanwhile, it won't see thread */
+	if (test_bit(mISDN_STACK_ABORT, &st->status)) {
+		spin_unlock_irq(&st->tlock);
+		kthread_stop(thread);
+		return;
+	}
+	st->thread = thread;
+	if (!skb_queue_empty(&st->msgq))
+		test_and_set_bit(mISDN_STACK_WORK, &st->status);
+	spin_unlock_irq(&st->tlock);
+	/* an idle thread exits on its own, keep the module until it did */
+	__module_get(THIS_MODULE);
+	wake_up_process(thread);
+}
+
+/* make sure the thread runs, called on open */
+static int
+stack_start(struct mISDNstack *st)
+{
+	if (st->thread)
+		return 0;
+	schedule_work(&st->start_work);
+	flush_work(&st->start_work);
+	return st->thread ? 0 : -ENOMEM;
+}
+
 int
 create_stack(struct mISDNdevice *dev)
 {
 	struct mISDNstack	*newst;
 	int			err;
-	DECLARE_COMPLETION_ONSTACK(done);
 
 	newst = kzalloc(sizeof(struct mISDNstack), GFP_KERNEL);
 	if (!newst) {
@@ -378,6 +467,8 @@ create_stack(struct mISDNdevice *dev)
 	init_waitqueue_head(&newst->workq);
 	skb_queue_head_init(&newst->msgq);
 	mutex_init(&newst->lmutex);
+	spin_lock_init(&newst->tlock);
+	INIT_WORK(&newst->start_work, stack_start_work);
 	dev->D.st = newst;
 	err = create_teimanager(dev);
 	if (err) {
@@ -398,19 +489,8 @@ create_stack(struct mISDNdevice *dev)
 	if (*debug & DEBUG_CORE_FUNC)
 		printk(KERN_DEBUG "%s: st(%s)\n", __func__,
 		       dev_name(&newst->dev->dev));
-	newst->notify = &done;
-	newst->thread = kthread_run(mISDNStackd, (void *)newst, "mISDN_%s",
-				    dev_name(&newst->dev->dev));
-	if (IS_ERR(newst->thread)) {
-		err = PTR_ERR(newst->thread);
-		printk(KERN_ERR
-		       "mISDN:cannot create kernel thread for %s (%d)\n",
-		       dev_name(&newst->dev->dev), err);
-		delete_teimanager(dev->teimgr);
-		kfree(newst);
-	} else
-		wait_for_completion(&done);
-	return err;
+	/* the thread is started on demand */
+	return 0;
 }
 
 int
@@ -431,6 +511,9 @@ connect_layer1(struct mISDNdevice *dev, struct mISDNchannel *ch,
 	case ISDN_P_NT_E1:
 	case ISDN_P_TE_S0:
 	case ISDN_P_TE_E1:
+		err = stack_start(dev->D.st);
+		if (err)
+			return err;
 		ch->recv = mISDN_queue_message;
 		ch->peer = &dev->D.st->own;
 		ch->st = dev->D.st;
@@ -530,6 +613,9 @@ create_l2entity(struct mISDNdevice *dev, struct mISDNchannel *ch,
 			rq.protocol = ISDN_P_NT_E1;
 		/* fall through */
 	case ISDN_P_LAPD_TE:
+		err = stack_start(dev->D.st);
+		if (err)
+			break;
 		ch->recv = mISDN_queue_message;
 		ch->peer = &dev->D.st->own;
 		ch->st = dev->D.st;
@@ -619,6 +705,7 @@ void
 delete_stack(struct mISDNdevice *dev)
 {
 	struct mISDNstack	*st = dev->D.st;
+	struct task_struct	*thread;
 	DECLARE_COMPLETION_ONSTACK(done);
 
 	if (*debug & DEBUG_CORE_FUNC)
@@ -626,18 +713,25 @@ delete_stack(struct mISDNdevice *dev)
 		       dev_name(&st->dev->dev));
 	if (dev->teimgr)
 		delete_teimanager(dev->teimgr);
-	if (st->thread) {
+	/* no new thread after this, a running one can't go idle anymore */
+	spin_lock_irq(&st->tlock);
+	test_and_set_bit(mISDN_STACK_ABORT, &st->status);
+	thread = st->thread;
+	if (thread) {
 		if (st->notify) {
 			printk(KERN_WARNING "%s: notifier in use\n",
 			       __func__);
 			complete(st->notify);
 		}
 		st->notify = &done;
-		test_and_set_bit(mISDN_STACK_ABORT, &st->status);
 		test_and_set_bit(mISDN_STACK_WAKEUP, &st->status);
 		wake_up_interruptible(&st->workq);
-		wait_for_completion(&done);
 	}
+	spin_unlock_irq(&st->tlock);
+	if (thread)
+		wait_for_completion(&done);
+	cancel_work_sync(&st->start_work);
+	skb_queue_purge(&st->msgq);
 	if (!list_empty(&st->layer2))
 		printk(KERN_WARNING "%s: layer2 list not empty\n",
 		       __func__);
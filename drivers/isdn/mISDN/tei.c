@@ -811,6 +811,7 @@ create_new_tei(struct manager *mgr, int tei, int sapi)
 	}
 	l2->tm->mgr = mgr;
 	l2->tm->l2 = l2;
+	l2->Tack = min(mgr->ack_delay, l2->T200 / 4);
 	l2->tm->tei_m.debug = *debug & DEBUG_L2_TEIFSM;
 	l2->tm->tei_m.userdata = l2->tm;
 	l2->tm->tei_m.printdebug = tei_debug;
@@ -1054,6 +1055,7 @@ create_teimgr(struct manager *mgr, struct channel_req *crq)
 	}
 	l2->tm->mgr = mgr;
 	l2->tm->l2 = l2;
+	l2->Tack = min(mgr->ack_delay, l2->T200 / 4);
 	l2->tm->tei_m.debug = *debug & DEBUG_L2_TEIFSM;
 	l2->tm->tei_m.userdata = l2->tm;
 	l2->tm->tei_m.printdebug = tei_debug;
@@ -1170,8 +1172,9 @@ free_teimanager(struct manager *mgr)
 static int
 ctrl_teimanager(struct manager *mgr, void *arg)
 {
-	/* currently we only have one option */
 	unsigned int *val = (unsigned int *)arg;
+	struct layer2 *l2;
+	u_long flags;
 
 	switch (val[0]) {
 	case IMCLEAR_L2:
@@ -1186,6 +1189,18 @@ ctrl_teimanager(struct manager *mgr, void *arg)
 		else
 			test_and_clear_bit(OPTION_L1_HOLD, &mgr->options);
 		break;
+	case IML2ACK:
+		/* for all current and future layer2 of this manager */
+		if ((int)val[1] >= 0)
+			mgr->ack_delay = val[1];
+		read_lock_irqsave(&mgr->lock, flags);
+		list_for_each_entry(l2, &mgr->layer2, list) {
+			val[1] = mgr->ack_delay;
+			l2_ack_ctrl(l2, val);
+		}
+		read_unlock_irqrestore(&mgr->lock, flags);
+		val[1] = mgr->ack_delay;
+		break;
 	default:
 		return -EINVAL;
 	}
@@ -1254,6 +1269,31 @@ delete_teimanager(struct mISDNchannel *ch)
 	kfree(mgr);
 }
 
+/*
+ * fill up to max entries of st with the layer2 instances of dev,
+ * returns the number of instances
+ */
+int
+get_l2_stats(struct mISDNdevice *dev, struct mISDN_l2stats *st, u_int max)
+{
+	struct manager	*mgr;
+	struct layer2	*l2;
+	u_long		flags;
+	int		cnt = 0;
+
+	if (!dev->teimgr)
+		return 0;
+	mgr = container_of(dev->teimgr, struct manager, ch);
+	read_lock_irqsave(&mgr->lock, flags);
+	list_for_each_entry(l2, &mgr->layer2, list) {
+		if (cnt < max)
+			l2_get_stats(l2, &st[cnt]);
+		cnt++;
+	}
+	read_unlock_irqrestore(&mgr->lock, flags);
+	return cnt;
+}
+
 static int
 mgr_ctrl(struct mISDNchannel *ch, u_int cmd, void *arg)
 {
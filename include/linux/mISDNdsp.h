@@ -14,12 +14,16 @@ struct mISDN_dsp_element {
 	void	(*free)(void *p);
 	void	(*process_tx)(void *p, unsigned char *data, int len);
 	void	(*process_rx)(void *p, unsigned char *data, int len,
-			unsigned int txlen);
+			unsigned int txlen, int fpu);
 	int	num_args;
 	struct mISDN_dsp_element_arg
 		*args;
+	u_int	flags;
 };
 
+/* process_rx() may use the FPU, if 'fpu' is set it is claimed already */
+#define MISDN_DSP_ELEM_FPU	0x01
+
 extern int  mISDN_dsp_element_register(struct mISDN_dsp_element *elem);
 extern void mISDN_dsp_element_unregister(struct mISDN_dsp_element *elem);
 
@@ -12,6 +12,7 @@
 #define MISDNHW_H
 #include <linux/mISDNif.h>
 #include <linux/timer.h>
+#include <linux/u64_stats_sync.h>
 
 /*
  * HW DEBUG 0xHHHHGGGG
@@ -66,6 +67,8 @@
 #define FLG_TX_EMPTY		27
 /* stop sending received data upstream */
 #define FLG_RX_OFF		28
+/* receive queue is delivered, by the work or by busy polling */
+#define FLG_RX_DRAIN		29
 /* workq events */
 #define FLG_RECVQUEUE		30
 #define	FLG_PHCHANGE		31
@@ -137,6 +140,24 @@ extern int	l1_event(struct layer1 *, u_int);
 
 #define MISDN_BCH_FILL_SIZE	4
 
+/*
+ * B-channel statistics, updated with the HW lock held (like all other
+ * bchannel fields in the IRQ path) and read without locks, see
+ * IMGETBCHSTATS
+ */
+struct bchannel_stats {
+	struct u64_stats_sync	syncp;
+	u64_stats_t		rx_frames;
+	u64_stats_t		rx_bytes;
+	u64_stats_t		tx_frames;
+	u64_stats_t		tx_bytes;
+	u64_stats_t		rx_overrun;
+	u64_stats_t		tx_underrun;
+	u64_stats_t		crc_err;
+	u64_stats_t		frame_err;
+	u64_stats_t		queue_drop;
+};
+
 struct bchannel {
 	struct mISDNchannel	ch;
 	int			nr;
@@ -163,12 +184,36 @@ struct bchannel {
 	int			tx_idx;
 	int			debug;
 	/* statistics */
-	int			err_crc;
-	int			err_tx;
-	int			err_rx;
+	struct bchannel_stats	stats;
 	int			dropcnt;
 };
 
+#define bch_stats_add(bch, field, val)				\
+	do {							\
+		u64_stats_update_begin(&(bch)->stats.syncp);	\
+		u64_stats_add(&(bch)->stats.field, val);	\
+		u64_stats_update_end(&(bch)->stats.syncp);	\
+	} while (0)
+#define bch_stats_inc(bch, field)	bch_stats_add(bch, field, 1)
+
+/*
+ * stamp transparent B-channel data with the sample clock, call it before
+ * the data is added to the skb; only the first data of a frame counts
+ * 'age' is the number of samples since the first of them arrived, taken
+ * from the card, e.g. the fill level of a FIFO that moves once per 8 kHz
+ * frame. Frames without stamp are placed one after the other by the DSP.
+ */
+static inline void
+mISDN_stamp_rx(struct sk_buff *skb, u_int age)
+{
+	struct mISDNstamp *st = mISDN_STAMP_P(skb);
+
+	if (skb->len)
+		return;
+	st->first = mISDN_clock_get() - age;
+	st->valid = 1;
+}
+
 extern int	mISDN_initdchannel(struct dchannel *, int, void *);
 extern int	mISDN_initbchannel(struct bchannel *, unsigned short,
 				   unsigned short);
@@ -176,6 +221,7 @@ extern int	mISDN_freedchannel(struct dchannel *);
 extern void	mISDN_clear_bchannel(struct bchannel *);
 extern void	mISDN_freebchannel(struct bchannel *);
 extern int	mISDN_ctrl_bchannel(struct bchannel *, struct mISDN_ctrl_req *);
+extern int	bchannel_rx_drain(struct bchannel *);
 extern void	queue_ch_frame(struct mISDNchannel *, u_int,
 			int, struct sk_buff *);
 extern int	dchannel_senddata(struct dchannel *, struct sk_buff *);
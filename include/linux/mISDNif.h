@@ -117,6 +117,7 @@
 /* intern layer 2 */
 #define DL_TIMER200_IND		0x7004
 #define DL_TIMER203_IND		0x7304
+#define DL_TIMERACK_IND		0x7404
 #define DL_INTERN_MSG		0x7804
 
 /* DL_INFORMATION_IND types */
@@ -153,6 +154,18 @@
 #define DSP_BF_ACCEPT		0x2416
 #define DSP_BF_REJECT		0x2417
 #define DSP_PIPELINE_CFG	0x2418
+#define DSP_CMX_FRAME		0x2419
+#define DSP_LATENCY_MEASURE	0x241a
+#define DSP_LATENCY_RESULT	0x241b
+#define DSP_CONF_RECORD		0x241c
+#define DSP_RECORD_DATA		0x241d
+/*
+ * DSP_CONF_RECORD flags, the conference mix is indicated once per frame as
+ * PH_CONTROL_IND: DSP_RECORD_DATA, number of side channels, mix samples,
+ * then one frame of received samples per member in member order
+ */
+#define DSP_RECORD_MIX		0x0001
+#define DSP_RECORD_MEMBERS	0x0002
 #define HFC_VOL_CHANGE_TX	0x2601
 #define HFC_VOL_CHANGE_RX	0x2602
 #define HFC_SPL_LOOP_ON		0x2603
@@ -308,6 +321,86 @@ struct mISDN_devrename {
 	char			name[MISDN_MAX_IDLEN]; /* new name */
 };
 
+/* IMGETDEVLIST: count entries in, number of registered devices out */
+#define MISDN_MAX_DEVICES	64
+
+struct mISDN_devlist {
+	u_int			count;
+	struct mISDN_devinfo	info[];
+};
+
+/* IMGETBCHSTATS: device id and count entries in, channels of device out */
+struct mISDN_bchstats {
+	__u32			channel;
+	__u32			reserved;
+	__u64			rx_frames;
+	__u64			rx_bytes;
+	__u64			tx_frames;
+	__u64			tx_bytes;
+	__u64			rx_overrun;	/* FIFO or receive buffer */
+	__u64			tx_underrun;
+	__u64			crc_err;
+	__u64			frame_err;	/* framing, abort, length */
+	__u64			queue_drop;	/* receive queue overflow */
+};
+
+struct mISDN_bchstatslist {
+	u_int			id;
+	u_int			count;
+	struct mISDN_bchstats	st[];
+};
+
+/* MISDN_CMD_GET_L2STATS: one entry per layer2 instance of a device */
+struct mISDN_l2stats {
+	__s32			sapi;
+	__s32			tei;
+	__u32			tx_iframes;
+	__u32			rx_iframes;
+	__u32			retrans;	/* I-frames sent again */
+	__u32			rej_tx;
+	__u32			rej_rx;
+	__u32			rnr_rx;		/* peer became busy */
+	__u32			t200;		/* T200 expiries */
+	__u32			mdl_error;	/* MDL-ERROR indications */
+	__u32			established;
+	__u32			sframes;
+	__u32			piggyback;
+	__u32			reserved;
+};
+
+/* MISDN_CMD_GET_DSPSTATS: tick counters of the dsp module */
+struct mISDN_dsptick {
+	__u64			ticks;
+	__u64			skipped;	/* while no dsp needed them */
+	__u32			running;
+	__u32			reserved;
+};
+
+/* MISDN_CMD_GET_DSPSTATS: one entry per dsp instance */
+struct mISDN_dspstats {
+	char			name[64];
+	__u64			rx_samples;
+	__u64			rx_idle_samples;
+	__u32			latency_count;
+	__u32			latency_lost;
+	__s32			latency_last;	/* samples */
+	__s32			latency_min;
+	__s32			latency_max;
+	__s32			latency_cmx;
+};
+
+/*
+ * IML2ACK: delay of acknowledgements for received I-frames in ms, bounded
+ * to T200 / 4, 0 acknowledges at once, -1 keeps the current value
+ * sframes and piggyback return the supervisory frames sent and the
+ * acknowledgements carried by I-frames, summed over the layer2 instances
+ */
+struct mISDN_l2ack {
+	int			delay;
+	u_int			sframes;
+	u_int			piggyback;
+};
+
 /* MPH_INFORMATION_REQ payload */
 struct ph_info_ch {
 	__u32 protocol;
@@ -337,6 +430,9 @@ struct ph_info {
 #define IMCLEAR_L2	_IOR('I', 70, int)
 #define IMSETDEVNAME	_IOR('I', 71, struct mISDN_devrename)
 #define IMHOLD_L1	_IOR('I', 72, int)
+#define IMGETDEVLIST	_IOR('I', 73, struct mISDN_devlist)
+#define IMGETBCHSTATS	_IOR('I', 74, struct mISDN_bchstatslist)
+#define IML2ACK		_IOR('I', 75, struct mISDN_l2ack)
 
 static inline int
 test_channelmap(u_int nr, u_char *map)
@@ -373,6 +469,12 @@ clear_channelmap(u_int nr, u_char *map)
 #define MISDN_CTRL_FILL_EMPTY		0x0200
 #define MISDN_CTRL_GETPEER		0x0400
 #define MISDN_CTRL_L1_TIMER3		0x0800
+/* MISDN_CTRL_GAIN: request.p1 is the TX and request.p2 the RX gain in steps
+ * of 6 dB (range -8..8, like the DSP volume). The hardware applies it to the
+ * audio it switches without the host (PCM bridge, conference). Values the
+ * hardware cannot do are rejected with -EINVAL.
+ */
+#define MISDN_CTRL_GAIN			0x1000
 #define MISDN_CTRL_HW_FEATURES_OP	0x2000
 #define MISDN_CTRL_HW_FEATURES		0x2001
 #define MISDN_CTRL_HFC_OP		0x4000
@@ -386,6 +488,8 @@ clear_channelmap(u_int nr, u_char *map)
 #define MISDN_CTRL_HFC_ECHOCAN_OFF 	0x4008
 #define MISDN_CTRL_HFC_WD_INIT		0x4009
 #define MISDN_CTRL_HFC_WD_RESET		0x400A
+#define MISDN_CTRL_HFC_DTMF_ON		0x400B
+#define MISDN_CTRL_HFC_DTMF_OFF		0x400C
 
 /* special RX buffer value for MISDN_CTRL_RX_BUFFER request.p1 is the minimum
  * buffer size request.p2 the maximum. Using  MISDN_CTRL_RX_SIZE_IGNORE will
@@ -395,6 +499,17 @@ clear_channelmap(u_int nr, u_char *map)
 
 /* socket options */
 #define MISDN_TIME_STAMP		0x0001
+#define MISDN_BUSY_POLL			0x0002	/* int, usec to spin */
+#define MISDN_BUSY_POLL_STATS		0x0003	/* struct mISDN_pollstats */
+
+/*
+ * busy poll statistics of a B-channel socket: reads that found data by
+ * polling the channel and reads that had to sleep or return empty
+ */
+struct mISDN_pollstats {
+	__u64	hits;
+	__u64	sleeps;
+};
 
 struct mISDN_ctrl_req {
 	int		op;
@@ -407,6 +522,61 @@ struct mISDN_ctrl_req {
 #define MISDN_OPT_ALL		1
 #define MISDN_OPT_TEIMGR	2
 
+/*
+ * generic netlink family "mISDN"
+ * MISDN_CMD_GET_DEVICE, MISDN_CMD_GET_BCHSTATS and MISDN_CMD_GET_L2STATS
+ * are dumps, one message per device. MISDN_CMD_GET_DSPSTATS dumps one
+ * message with the tick counters, then one per dsp instance, if the dsp
+ * module is loaded. MISDN_CMD_EVENT messages are sent to the "events"
+ * group.
+ */
+#define MISDN_GENL_NAME		"mISDN"
+#define MISDN_GENL_VERSION	1
+#define MISDN_GENL_MCGRP_EVENTS	"events"
+
+enum {
+	MISDN_CMD_UNSPEC,
+	MISDN_CMD_GET_DEVICE,
+	MISDN_CMD_GET_BCHSTATS,
+	MISDN_CMD_EVENT,
+	MISDN_CMD_GET_L2STATS,
+	MISDN_CMD_GET_DSPSTATS,
+	__MISDN_CMD_MAX,
+};
+#define MISDN_CMD_MAX		(__MISDN_CMD_MAX - 1)
+
+enum {
+	MISDN_ATTR_UNSPEC,
+	MISDN_ATTR_DEV_ID,		/* u32 */
+	MISDN_ATTR_DEV_NAME,		/* string */
+	MISDN_ATTR_DPROTOCOLS,		/* u32 */
+	MISDN_ATTR_BPROTOCOLS,		/* u32 */
+	MISDN_ATTR_PROTOCOL,		/* u32 */
+	MISDN_ATTR_NRBCHAN,		/* u32 */
+	MISDN_ATTR_CHANNELMAP,		/* binary, MISDN_CHMAP_SIZE */
+	MISDN_ATTR_BCHSTATS,		/* struct mISDN_bchstats, repeated */
+	MISDN_ATTR_EVENT,		/* u32, MISDN_EVENT_* */
+	MISDN_ATTR_CHANNEL,		/* u32 */
+	MISDN_ATTR_SAPI,		/* u32 */
+	MISDN_ATTR_TEI,			/* u32 */
+	MISDN_ATTR_VALUE,		/* u32, event specific */
+	MISDN_ATTR_L2STATS,		/* struct mISDN_l2stats, repeated */
+	MISDN_ATTR_DSPTICK,		/* struct mISDN_dsptick */
+	MISDN_ATTR_DSPSTATS,		/* struct mISDN_dspstats */
+	__MISDN_ATTR_MAX,
+};
+#define MISDN_ATTR_MAX		(__MISDN_ATTR_MAX - 1)
+
+/* MISDN_ATTR_EVENT */
+#define MISDN_EVENT_L1_ACTIVATE		1
+#define MISDN_EVENT_L1_DEACTIVATE	2
+#define MISDN_EVENT_L2_ESTABLISH	3	/* SAPI, TEI */
+#define MISDN_EVENT_L2_RELEASE		4	/* SAPI, TEI */
+#define MISDN_EVENT_TEI_ASSIGN		5	/* SAPI, TEI */
+#define MISDN_EVENT_TEI_REMOVE		6	/* SAPI, TEI */
+#define MISDN_EVENT_FIFO_ERROR		7	/* channel, dropped frames */
+#define MISDN_EVENT_DSP_OVERRUN		8	/* samples since last tick */
+
 #ifdef __KERNEL__
 #include <linux/list.h>
 #include <linux/skbuff.h>
@@ -436,6 +606,18 @@ struct mISDN_ctrl_req {
 #define mISDN_HEAD_PRIM(s)	(((struct mISDNhead *)&s->cb[0])->prim)
 #define mISDN_HEAD_ID(s)	(((struct mISDNhead *)&s->cb[0])->id)
 
+/*
+ * sample clock stamp of received B-channel data, stored behind the head
+ * in skb->cb, a zeroed cb means no stamp
+ */
+struct mISDNstamp {
+	u16	first;	/* mISDN_clock_get() of the first sample */
+	u16	valid;
+};
+
+#define mISDN_STAMP_P(s)	((struct mISDNstamp *) \
+				 &s->cb[sizeof(struct mISDNhead)])
+
 /* socket states */
 #define MISDN_OPEN	1
 #define MISDN_BOUND	2
@@ -486,6 +668,8 @@ struct mISDN_sock {
 	struct mISDNchannel	ch;
 	u_int			cmask;
 	struct mISDNdevice	*dev;
+	u_int			busy_poll; /* usec */
+	struct mISDN_pollstats	pollstats;
 };
 
 
@@ -514,6 +698,8 @@ struct mISDNstack {
 	struct mISDNchannel	own;
 	struct mutex		lmutex; /* protect lists */
 	struct mISDN_sock_list	l1sock;
+	spinlock_t		tlock; /* thread start and idle exit */
+	struct work_struct	start_work;
 #ifdef MISDN_MSG_STATS
 	u_int			msg_cnt;
 	u_int			sleep_cnt;
@@ -598,6 +784,18 @@ extern void	set_channel_address(struct mISDNchannel *, u_int, u_int);
 extern void	mISDN_clock_update(struct mISDNclock *, int, ktime_t *);
 extern unsigned short mISDN_clock_get(void);
 extern const char *mISDNDevName4ch(struct mISDNchannel *);
+extern void	mISDN_nl_event(struct mISDNdevice *, u_int, int, int,
+			       u_int);
+
+/* statistics of the dsp module for MISDN_CMD_GET_DSPSTATS */
+struct mISDN_nl_dsp_ops {
+	void	(*tick)(struct mISDN_dsptick *);
+	/* fill the index'th dsp, returns -ENOENT past the last one */
+	int	(*stats)(u_int, struct mISDN_dspstats *);
+};
+
+extern void	mISDN_nl_register_dsp(const struct mISDN_nl_dsp_ops *);
+extern void	mISDN_nl_unregister_dsp(void);
 
 #endif /* __KERNEL__ */
 #endif /* mISDNIF_H */